@@ -0,0 +1,129 @@
+#include <bts/api/api_call_stats.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+namespace bts { namespace api {
+
+namespace detail
+{
+    /* Methods register the first time they are called, only reading the counters takes the lock */
+    struct call_stats_registry
+    {
+        std::mutex                               mutex;
+        std::vector<const method_call_stats*>    methods;
+    };
+
+    call_stats_registry& get_registry()
+    {
+        static call_stats_registry registry;
+        return registry;
+    }
+
+    void write_seconds( std::ostream& out, uint64_t microseconds )
+    {
+        out << std::fixed << std::setprecision( 6 ) << double( microseconds ) / 1000000;
+    }
+}
+
+method_call_stats::method_call_stats( const char* method_name )
+    : _method_name( method_name ), _calls( 0 ), _errors( 0 ), _total_microseconds( 0 )
+{
+    for( auto& bucket : _latency_buckets )
+        bucket.store( 0, std::memory_order_relaxed );
+
+    detail::call_stats_registry& registry = detail::get_registry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+    registry.methods.push_back( this );
+}
+
+void method_call_stats::record( uint64_t elapsed_microseconds, bool failed )
+{
+    uint32_t bucket = 0;
+    while( bucket < bucket_count - 1 && (elapsed_microseconds >> bucket) != 0 )
+        ++bucket;
+
+    _calls.fetch_add( 1, std::memory_order_relaxed );
+    if( failed )
+        _errors.fetch_add( 1, std::memory_order_relaxed );
+    _total_microseconds.fetch_add( elapsed_microseconds, std::memory_order_relaxed );
+    _latency_buckets[ bucket ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+method_call_summary method_call_stats::summary()const
+{
+    method_call_summary result;
+    result.method = _method_name;
+    result.calls = _calls.load( std::memory_order_relaxed );
+    result.errors = _errors.load( std::memory_order_relaxed );
+    result.total_microseconds = _total_microseconds.load( std::memory_order_relaxed );
+    result.latency_buckets.reserve( bucket_count );
+    for( const auto& bucket : _latency_buckets )
+        result.latency_buckets.push_back( bucket.load( std::memory_order_relaxed ) );
+    return result;
+}
+
+method_call_timer::~method_call_timer()
+{
+    const auto elapsed = std::chrono::steady_clock::now() - _start;
+    _stats.record( std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count(), !_succeeded );
+}
+
+std::vector<method_call_summary> get_call_statistics()
+{
+    std::vector<method_call_summary> result;
+    {
+        detail::call_stats_registry& registry = detail::get_registry();
+        std::lock_guard<std::mutex> lock( registry.mutex );
+        result.reserve( registry.methods.size() );
+        for( const method_call_stats* stats : registry.methods )
+            result.push_back( stats->summary() );
+    }
+    std::sort( result.begin(), result.end(),
+               []( const method_call_summary& a, const method_call_summary& b ) { return a.method < b.method; } );
+    return result;
+}
+
+std::string export_call_statistics()
+{
+    const std::vector<method_call_summary> summaries = get_call_statistics();
+    std::ostringstream out;
+
+    out << "# HELP bts_api_calls_total Calls of each api method\n"
+           "# TYPE bts_api_calls_total counter\n";
+    for( const auto& summary : summaries )
+        out << "bts_api_calls_total{method=\"" << summary.method << "\"} " << summary.calls << "\n";
+
+    out << "# HELP bts_api_errors_total Calls of each api method that threw\n"
+           "# TYPE bts_api_errors_total counter\n";
+    for( const auto& summary : summaries )
+        out << "bts_api_errors_total{method=\"" << summary.method << "\"} " << summary.errors << "\n";
+
+    out << "# HELP bts_api_call_duration_seconds Time spent in each api method\n"
+           "# TYPE bts_api_call_duration_seconds histogram\n";
+    for( const auto& summary : summaries )
+    {
+        // counted from the buckets, the counters are read one at a time while calls keep coming in
+        uint64_t cumulative = 0;
+        for( uint32_t i = 0; i + 1 < summary.latency_buckets.size(); ++i )
+        {
+            cumulative += summary.latency_buckets[ i ];
+            out << "bts_api_call_duration_seconds_bucket{method=\"" << summary.method << "\",le=\"";
+            detail::write_seconds( out, uint64_t( 1 ) << i );
+            out << "\"} " << cumulative << "\n";
+        }
+        if( !summary.latency_buckets.empty() )
+            cumulative += summary.latency_buckets.back();
+        out << "bts_api_call_duration_seconds_bucket{method=\"" << summary.method << "\",le=\"+Inf\"} " << cumulative << "\n";
+        out << "bts_api_call_duration_seconds_sum{method=\"" << summary.method << "\"} ";
+        detail::write_seconds( out, summary.total_microseconds );
+        out << "\n";
+        out << "bts_api_call_duration_seconds_count{method=\"" << summary.method << "\"} " << cumulative << "\n";
+    }
+
+    return out.str();
+}
+
+} } // end namespace bts::api
@@ -157,6 +157,7 @@ struct method_description
   bool is_const;
   bts::api::method_prerequisites prerequisites; // actually, a bitmask of method_prerequisites
   std::vector<std::string> aliases;
+  bool cached;
 };
 typedef std::list<method_description> method_description_list;
 
@@ -406,6 +407,9 @@ void api_generator::load_method_descriptions(const fc::variants& method_descript
       method.is_const = json_method_description.contains("is_const") && 
                                json_method_description["is_const"].as_bool();
 
+      method.cached = json_method_description.contains("cached") &&
+                      json_method_description["cached"].as_bool();
+
       FC_ASSERT(json_method_description.contains("prerequisites"), "method entry missing \"prerequisites\"");
       method.prerequisites = load_prerequisites(json_method_description["prerequisites"]);
 
@@ -907,7 +911,8 @@ void api_generator::generate_rpc_server_files(const fc::path& rpc_server_output_
         server_cpp_file << "\"" << alias << "\"";
       }
     }
-    server_cpp_file << "}};\n";
+    server_cpp_file << "},\n";
+    server_cpp_file << "      /* cached */ " << (method.cached ? "true" : "false") << "};\n";
       
     server_cpp_file << "    store_method_metadata(" << method.name << "_method_metadata);\n";
     server_cpp_file << "  }\n\n";
@@ -939,7 +944,7 @@ void api_generator::create_global_api_entry_log_for_method(
   cpp_file << "  bts::api::global_api_logger* glog = bts::api::global_api_logger::get_instance();\n"
               "  uint64_t call_id = 0;\n"
               "  fc::variants args;\n"
-              "  if( glog != NULL )\n"
+              "  if( glog != NULL && glog->has_active_loggers() )\n"
               "  {\n";
   
   for( const parameter_description& param : method.parameters )
@@ -1007,6 +1012,7 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
   interceptor_header_file << "} } // end namespace bts::rpc_stubs\n";
 
   interceptor_cpp_file << "#define DEFAULT_LOGGER \"rpc\"\n";
+  interceptor_cpp_file << "#include <bts/api/api_call_stats.hpp>\n";
 #if BTS_GLOBAL_API_LOG
   interceptor_cpp_file << "#include <bts/api/global_api_logger.hpp>\n";
   interceptor_cpp_file << "#include <bts/api/conversion_functions.hpp>\n";
@@ -1019,6 +1025,8 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
     interceptor_cpp_file << generate_signature_for_method(method, interceptor_classname, false) << "\n";
     interceptor_cpp_file << "{\n";
     interceptor_cpp_file << "  " << create_logging_statement_for_method(method) << "\n";
+    interceptor_cpp_file << "  static bts::api::method_call_stats call_stats(\"" << method.name << "\");\n";
+    interceptor_cpp_file << "  bts::api::method_call_timer call_timer(call_stats);\n";
 #if BTS_GLOBAL_API_LOG
     create_global_api_entry_log_for_method( interceptor_cpp_file, interceptor_classname, method );
     interceptor_cpp_file << "\n";
@@ -1033,14 +1041,11 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
     interceptor_cpp_file << "  {\n";
     interceptor_cpp_file << "    ";
     bool is_void = !!std::dynamic_pointer_cast<void_type_mapping>(method.return_type);
-#if BTS_GLOBAL_API_LOG
     if( !is_void )
       interceptor_cpp_file << method.return_type->get_cpp_return_type() << " result = ";
+#if BTS_GLOBAL_API_LOG
     else
       interceptor_cpp_file << "std::nullptr_t result = nullptr;\n    ";
-#else
-    if( !is_void )
-      interceptor_cpp_file << "return ";
 #endif
     std::list<std::string> args;
     for (const parameter_description& param : method.parameters)
@@ -1048,11 +1053,12 @@ void api_generator::generate_client_files(const fc::path& client_output_dir, con
     interceptor_cpp_file << "get_impl()->" << method.name << "(" << boost::join(args, ", ") << ");\n";
 #if BTS_GLOBAL_API_LOG
     create_global_api_exit_log_for_method( interceptor_cpp_file, interceptor_classname, method );
+#endif
+    interceptor_cpp_file << "    call_timer.succeeded();\n";
     if( !is_void )
-      interceptor_cpp_file << "\n    return result;\n";
+      interceptor_cpp_file << "    return result;\n";
     else
-      interceptor_cpp_file << "\n    return;\n";
-#endif
+      interceptor_cpp_file << "    return;\n";
     interceptor_cpp_file << "  }\n";
     interceptor_cpp_file << "  FC_RETHROW_EXCEPTIONS(warn, \"\")\n";
     interceptor_cpp_file << "}\n\n";
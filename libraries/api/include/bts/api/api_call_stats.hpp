@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bts { namespace api {
+
+/** the counters of one api method at the time they were read */
+struct method_call_summary
+{
+    std::string             method;
+    uint64_t                calls = 0;
+    uint64_t                errors = 0;
+    uint64_t                total_microseconds = 0;
+    /**
+     *  latency_buckets[i] counts the calls that took at least 2^(i-1) and less than 2^i microseconds,
+     *  the last bucket also counts every longer call
+     */
+    std::vector<uint64_t>   latency_buckets;
+};
+
+/**
+ *  Call and error counts and a log2 latency histogram for one api method. The generated
+ *  common_api_client keeps one of these per method in a function local static and only
+ *  touches relaxed atomics on each call, so the counters are always on.
+ */
+class method_call_stats
+{
+public:
+    static const uint32_t bucket_count = 32;
+
+    explicit method_call_stats( const char* method_name );
+
+    void                record( uint64_t elapsed_microseconds, bool failed );
+    method_call_summary summary()const;
+
+private:
+    const char*                                         _method_name;
+    std::atomic<uint64_t>                               _calls;
+    std::atomic<uint64_t>                               _errors;
+    std::atomic<uint64_t>                               _total_microseconds;
+    std::array<std::atomic<uint64_t>, bucket_count>     _latency_buckets;
+};
+
+/** times one call into method_call_stats, a call that ends without succeeded() counts as an error */
+class method_call_timer
+{
+public:
+    explicit method_call_timer( method_call_stats& stats )
+        : _stats( stats ), _start( std::chrono::steady_clock::now() ) {}
+    ~method_call_timer();
+
+    void succeeded() { _succeeded = true; }
+
+private:
+    method_call_stats&                      _stats;
+    std::chrono::steady_clock::time_point   _start;
+    bool                                    _succeeded = false;
+};
+
+/** the counters of every method called at least once, sorted by method name */
+std::vector<method_call_summary> get_call_statistics();
+
+/** the same counters in the Prometheus text exposition format */
+std::string export_call_statistics();
+
+} } // end namespace bts::api
+
+FC_REFLECT( bts::api::method_call_summary, (method)(calls)(errors)(total_microseconds)(latency_buckets) )
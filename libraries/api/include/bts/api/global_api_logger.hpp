@@ -37,6 +37,9 @@ public:
     virtual void log_call_finished( uint64_t call_id, const bts::api::common_api* target, const fc::string& name, const fc::variants& args, const fc::variant& result ) = 0;
     virtual bool obscure_passwords( ) const = 0;
 
+    /** false while no api_logger is connected, callers skip converting the arguments to variants */
+    bool has_active_loggers( ) const { return !active_loggers.empty(); }
+
     static global_api_logger* get_instance();
     
     static global_api_logger* the_instance;
@@ -0,0 +1,180 @@
+#include <bts/blockchain/block_filter.hpp>
+#include <bts/blockchain/chain_interface.hpp>
+#include <bts/blockchain/account_operations.hpp>
+#include <bts/blockchain/balance_operations.hpp>
+#include <bts/blockchain/market_operations.hpp>
+#include <bts/blockchain/market_operations_v1.hpp>
+
+namespace bts { namespace blockchain {
+
+   namespace
+   {
+      /* Addresses are already hashes, so the bit positions are derived from their words directly */
+      template<typename Function>
+      void for_each_bit( const address& addr, size_t num_bits, Function&& f )
+      {
+         const uint32_t h1 = addr.addr._hash[ 0 ];
+         const uint32_t h2 = addr.addr._hash[ 1 ] | 1;
+         for( uint32_t i = 0; i < block_filter::hash_count; ++i )
+            f( ( uint64_t( h1 ) + uint64_t( i ) * h2 ) % num_bits );
+      }
+
+      /**
+       *  The addresses of a balance's condition, or false if it cannot be filtered by address. A titan memo
+       *  only matters when the balance is created, since the recipient can only find it by decrypting it.
+       */
+      bool condition_addresses( const withdraw_condition& condition, bool is_deposit, vector<address>& addresses )
+      {
+         switch( withdraw_condition_types( condition.type ) )
+         {
+            case withdraw_signature_type:
+            {
+               const auto cond = condition.as<withdraw_with_signature>();
+               addresses.push_back( cond.owner );
+               return !is_deposit || !cond.memo.valid();
+            }
+            case withdraw_vesting_type:
+               addresses.push_back( condition.as<withdraw_vesting>().owner );
+               return true;
+            case withdraw_multisig_type:
+            {
+               const auto cond = condition.as<withdraw_with_multisig>();
+               addresses.insert( addresses.end(), cond.owners.begin(), cond.owners.end() );
+               return true;
+            }
+            case withdraw_escrow_type:
+            {
+               const auto cond = condition.as<withdraw_with_escrow>();
+               addresses.push_back( cond.sender );
+               addresses.push_back( cond.receiver );
+               addresses.push_back( cond.escrow );
+               return !is_deposit || !cond.memo.valid();
+            }
+            default:
+               return false;
+         }
+      }
+
+      /** the addresses an operation involves, or false if it cannot be filtered by address */
+      bool operation_addresses( const operation& op, const chain_interface& chain, vector<address>& addresses )
+      {
+         switch( operation_type_enum( op.type ) )
+         {
+            case withdraw_op_type:
+            {
+               const obalance_record balance = chain.get_balance_record( op.as<withdraw_operation>().balance_id );
+               if( !balance.valid() ) return false;
+               return condition_addresses( balance->condition, false, addresses );
+            }
+            case deposit_op_type:
+               return condition_addresses( op.as<deposit_operation>().condition, true, addresses );
+            case bid_op_type:
+               addresses.push_back( op.as<bid_operation>().bid_index.owner );
+               return true;
+            case ask_op_type:
+               addresses.push_back( op.as<ask_operation>().ask_index.owner );
+               return true;
+            case relative_bid_op_type:
+               addresses.push_back( op.as<relative_bid_operation>().bid_index.owner );
+               return true;
+            case relative_ask_op_type:
+               addresses.push_back( op.as<relative_ask_operation>().ask_index.owner );
+               return true;
+            case short_op_type:
+               addresses.push_back( op.as<short_operation_v1>().short_index.owner );
+               return true;
+            case short_op_v2_type:
+               addresses.push_back( op.as<short_operation>().short_index.owner );
+               return true;
+            case cover_op_type:
+               addresses.push_back( op.as<cover_operation>().cover_index.owner );
+               return true;
+            case add_collateral_op_type:
+               addresses.push_back( op.as<add_collateral_operation>().cover_index.owner );
+               return true;
+            case register_account_op_type:
+            {
+               const auto register_op = op.as<register_account_operation>();
+               addresses.push_back( address( register_op.owner_key ) );
+               addresses.push_back( address( register_op.active_key ) );
+               return true;
+            }
+            case update_account_op_type:
+            {
+               const oaccount_record account = chain.get_account_record( op.as<update_account_operation>().account_id );
+               if( !account.valid() ) return false;
+               addresses.push_back( account->owner_address() );
+               addresses.push_back( account->active_address() );
+               return true;
+            }
+            default:
+               return false;
+         }
+      }
+   }
+
+   bool transaction_addresses( const signed_transaction& trx, const chain_interface& chain, vector<address>& addresses )
+   {
+      bool complete = true;
+      for( const operation& op : trx.operations )
+         complete &= operation_addresses( op, chain, addresses );
+      return complete;
+   }
+
+   block_filter block_filter::build( const full_block& block, const vector<market_transaction>& market_transactions,
+                                     const chain_interface& chain )
+   { try {
+      block_filter filter;
+
+      vector<address> addresses;
+      for( const signed_transaction& transaction : block.user_transactions )
+      {
+         if( !transaction_addresses( transaction, chain, addresses ) )
+         {
+            filter.match_all = true;
+            return filter;
+         }
+      }
+
+      for( const market_transaction& market_trx : market_transactions )
+      {
+         addresses.push_back( market_trx.bid_owner );
+         addresses.push_back( market_trx.ask_owner );
+      }
+
+      if( addresses.empty() )
+         return filter;
+
+      filter.bits.resize( ( addresses.size() * bits_per_address + 7 ) / 8 );
+      for( const address& addr : addresses )
+         filter.insert( addr );
+      return filter;
+   } FC_CAPTURE_AND_RETHROW( (block.block_num) ) }
+
+   void block_filter::insert( const address& addr )
+   {
+      FC_ASSERT( !bits.empty() );
+      for_each_bit( addr, bits.size() * 8, [&]( size_t bit ) { bits[ bit / 8 ] |= char( 1 << ( bit % 8 ) ); } );
+   }
+
+   bool block_filter::may_contain( const address& addr )const
+   {
+      if( match_all ) return true;
+      if( bits.empty() ) return false;
+      bool found = true;
+      for_each_bit( addr, bits.size() * 8, [&]( size_t bit ) { found &= ( bits[ bit / 8 ] & char( 1 << ( bit % 8 ) ) ) != 0; } );
+      return found;
+   }
+
+   bool block_filter::may_involve( const unordered_set<address>& addresses )const
+   {
+      if( match_all ) return true;
+      for( const address& addr : addresses )
+      {
+         if( may_contain( addr ) )
+            return true;
+      }
+      return false;
+   }
+
+} } // bts::blockchain
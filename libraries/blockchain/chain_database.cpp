@@ -15,8 +15,12 @@
 #include <fc/thread/non_preemptable_scope_check.hpp>
 #include <fc/thread/unique_lock.hpp>
 
+#include <algorithm>
+#include <condition_variable>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include <bts/blockchain/fork_blocks.hpp>
 
@@ -24,25 +28,61 @@ namespace bts { namespace blockchain {
 
    namespace detail
    {
+      /**
+       *  Evaluates a pending transaction on the dependency_tracking_state it owns, so that both take a
+       *  single allocation. The expiration and hardfork checks that precede the operations are repeated
+       *  by rebase_pending_evaluation(), but anything an evaluator does with the time or the head block
+       *  number is recorded as a dependency.
+       */
+      class pending_trx_evaluation_state : public transaction_evaluation_state
+      {
+         public:
+            /* the base class only stores the pointer, so it may point at the member not yet constructed */
+            pending_trx_evaluation_state( const chain_interface_ptr& prev_state, const digest_type& chain_id )
+            :transaction_evaluation_state( &_tracking_state, chain_id ),_tracking_state( prev_state ){}
+
+            virtual void evaluate_operation( const operation& op )override
+            {
+               _tracking_state.track_chain_time();
+               transaction_evaluation_state::evaluate_operation( op );
+            }
+
+            dependency_tracking_state& tracking_state() { return _tracking_state; }
+
+         private:
+            dependency_tracking_state _tracking_state;
+      };
+
+      /**
+       *  Rebuilds _pending_trx_state on top of the current head. Transactions are replayed in the
+       *  order they were first applied, and one whose recorded reads still hold is rebased instead
+       *  of evaluated again, which skips signature checks and every evaluator. Anything else, and
+       *  any transaction that was never evaluated in this session, is evaluated from scratch.
+       *
+       *  generate_block() evaluates every transaction again, so a transaction kept here by mistake
+       *  can only cost a slot in the queue, never an invalid block.
+       */
       void chain_database_impl::revalidate_pending()
       {
             _pending_fee_index.clear();
+            _pending_state_stale = false;
 
             vector<digest_type> trx_to_discard;
 
             _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
+            vector<pending_trx_evaluation> previous_evaluations;
+            previous_evaluations.swap( _pending_evaluations );
+
+            unordered_set<digest_type> considered;
             unsigned num_pending_transaction_considered = 0;
-            auto itr = _pending_transaction_db.begin();
-            while( itr.valid() )
+            unsigned num_pending_transaction_rebased = 0;
+
+            const auto revalidate = [&]( const digest_type& trx_id, const signed_transaction& trx )
             {
-                signed_transaction trx = itr.value();
-                digest_type trx_id = itr.key();
-                assert(trx_id == trx.digest(_chain_id));
                 try
                 {
                   transaction_evaluation_state_ptr eval_state = self->evaluate_transaction( trx, _relay_fee );
-                  share_type fees = eval_state->get_fees();
-                  _pending_fee_index[ fee_index( fees, trx.id() ) ] = eval_state;
+                  add_pending_transaction( eval_state );
                   wlog("revalidated pending transaction id ${id} ${i}", ("id", trx_id)("i",trx.id()));
                 }
                 catch ( const fc::canceled_exception& )
@@ -56,18 +96,150 @@ namespace bts { namespace blockchain {
                         ("id",trx_id)("e",e.to_detail_string()) );
                 }
                 ++num_pending_transaction_considered;
+            };
+
+            for( auto& evaluation : previous_evaluations )
+            {
+                if( !considered.insert( evaluation.trx_digest ).second || !_pending_transaction_db.fetch_optional( evaluation.trx_digest ).valid() )
+                   continue;
+
+                bool rebased = false;
+                try
+                {
+                   rebased = rebase_pending_evaluation( evaluation );
+                }
+                catch ( const fc::canceled_exception& )
+                {
+                   throw;
+                }
+                catch ( const fc::exception& e )
+                {
+                   trx_to_discard.push_back( evaluation.trx_digest );
+                   wlog( "discarding pending transaction: ${id} ${e}",
+                         ("id",evaluation.trx_digest)("e",e.to_detail_string()) );
+                   ++num_pending_transaction_considered;
+                   continue;
+                }
+
+                if( rebased )
+                {
+                   add_pending_transaction( evaluation.eval_state );
+                   _pending_evaluations.push_back( std::move( evaluation ) );
+                   ++num_pending_transaction_rebased;
+                   ++num_pending_transaction_considered;
+                   continue;
+                }
+
+                revalidate( evaluation.trx_digest, evaluation.eval_state->trx );
+            }
+            previous_evaluations.clear();
+
+            auto itr = _pending_transaction_db.begin();
+            while( itr.valid() )
+            {
+                digest_type trx_id = itr.key();
+                if( considered.insert( trx_id ).second )
+                {
+                   signed_transaction trx = itr.value();
+                   assert(trx_id == trx.digest(_chain_id));
+                   revalidate( trx_id, trx );
+                }
                 ++itr;
             }
 
             for( const auto& item : trx_to_discard )
                 _pending_transaction_db.remove( item );
-            wlog("revalidate_pending complete, there are now ${pending_count} evaluated transactions, ${num_pending_transaction_considered} raw transactions",
+            wlog("revalidate_pending complete, there are now ${pending_count} evaluated transactions, ${num_pending_transaction_considered} raw transactions, ${num_pending_transaction_rebased} rebased",
                  ("pending_count", _pending_fee_index.size())
-                 ("num_pending_transaction_considered", num_pending_transaction_considered));
+                 ("num_pending_transaction_considered", num_pending_transaction_considered)
+                 ("num_pending_transaction_rebased", num_pending_transaction_rebased));
+
+            // every pass that evicts drops transactions from _pending_transaction_db, so this ends
+            if( _pending_state_stale )
+               revalidate_pending();
+      }
+
+      /**
+       *  Replays a pending transaction's changes on top of _pending_trx_state if none of the records
+       *  it read have changed since it was evaluated.
+       */
+      bool chain_database_impl::rebase_pending_evaluation( pending_trx_evaluation& evaluation )
+      { try {
+         const signed_transaction& trx = evaluation.eval_state->trx;
+         if( self->now() >= trx.expiration )
+            return false;
+         if( self->now() + BTS_BLOCKCHAIN_MAX_TRANSACTION_EXPIRATION_SEC < trx.expiration )
+            return false;
+
+         if( evaluation.eval_state->get_fees() + evaluation.eval_state->alt_fees_paid.amount < _relay_fee )
+            return false;
+
+         // evaluators branch on the head block number around hardforks, so never rebase across one
+         static const uint32_t fork_block_nums[] = {
+            BTS_V0_4_0_FORK_BLOCK_NUM, BTS_V0_4_9_FORK_BLOCK_NUM, BTS_V0_4_9_FORK_2_BLOCK_NUM, BTS_V0_4_10_FORK_BLOCK_NUM,
+            BTS_V0_4_12_FORK_BLOCK_NUM, BTS_V0_4_13_FORK_BLOCK_NUM, BTS_V0_4_15_FORK_BLOCK_NUM, BTS_V0_4_16_FORK_BLOCK_NUM,
+            BTS_V0_4_17_FORK_BLOCK_NUM, BTS_V0_4_18_FORK_BLOCK_NUM, BTS_V0_4_19_FORK_BLOCK_NUM, BTS_V0_4_21_FORK_BLOCK_NUM,
+            BTS_V0_4_23_FORK_BLOCK_NUM, BTS_V0_4_24_FORK_BLOCK_NUM, BTS_V0_4_26_FORK_BLOCK_NUM, BTS_V0_4_28_FORK_BLOCK_NUM,
+            BTS_V0_4_29_FORK_BLOCK_NUM
+         };
+         const uint32_t head_block_num = self->get_head_block_num();
+         const uint32_t low = std::min( evaluation.head_block_num, head_block_num );
+         const uint32_t high = std::max( evaluation.head_block_num, head_block_num );
+         for( const uint32_t fork_block_num : fork_block_nums )
+         {
+            if( low < fork_block_num && fork_block_num <= high )
+               return false;
+         }
+
+         dependency_tracking_state& changes = *evaluation.changes;
+         changes.set_prev_state( _pending_trx_state );
+         if( !changes.can_rebase() )
+            return false;
+
+         _pending_fee_index.check_admission( evaluation.eval_state->get_fees(), fc::raw::pack_size( trx ),
+                                             evaluation.eval_state->signed_keys );
+
+         changes.rebase_totals();
+         changes.apply_changes();
+         evaluation.head_block_num = head_block_num;
+         return true;
+      } FC_CAPTURE_AND_RETHROW( (evaluation.trx_digest) ) }
+
+      /**
+       *  Indexes an evaluated transaction by fee per byte. Transactions evicted to make room are
+       *  dropped from the pending database, but their changes are still in _pending_trx_state, so
+       *  _pending_state_stale is set and the caller must revalidate_pending() before evaluating
+       *  anything else on top of it.
+       */
+      void chain_database_impl::add_pending_transaction( const transaction_evaluation_state_ptr& eval_state )
+      {
+         const auto evicted = _pending_fee_index.insert( eval_state, eval_state->get_fees(), fc::raw::pack_size( eval_state->trx ) );
+         if( evicted.empty() )
+            return;
+
+         unordered_set<digest_type> evicted_digests;
+         for( const auto& item : evicted )
+         {
+            wlog( "evicting pending transaction ${id} to make room for ${new_id}",
+                  ("id",item->trx.id())("new_id",eval_state->trx.id()) );
+            const digest_type trx_digest = item->trx.digest( _chain_id );
+            _pending_transaction_db.remove( trx_digest );
+            evicted_digests.insert( trx_digest );
+         }
+
+         _pending_state_stale = true;
+
+         // an evicted transaction can never be rebased, so stop holding on to its changes
+         _pending_evaluations.erase( std::remove_if( _pending_evaluations.begin(), _pending_evaluations.end(),
+                                                     [&]( const pending_trx_evaluation& evaluation ) {
+                                                        return evicted_digests.count( evaluation.trx_digest ) != 0;
+                                                     } ),
+                                     _pending_evaluations.end() );
       }
 
       void chain_database_impl::open_database( const fc::path& data_dir )
       { try {
+          _data_dir = data_dir;
           bool rebuild_index = false;
 
           if( !fc::exists(data_dir / "index" ) )
@@ -96,7 +268,14 @@ namespace bts { namespace blockchain {
           {
              FC_CAPTURE_AND_THROW( new_database_version, (database_version)(BTS_BLOCKCHAIN_DATABASE_VERSION) );
           }
-          _market_transactions_db.open( data_dir / "index/market_transactions_db" );
+          _write_journal.open( data_dir / "index/write_journal" );
+
+          /* The state cache budget is shared by the databases below that load entries on demand */
+          const size_t num_state_cached_dbs = 7;
+          const size_t state_db_cache_size = _state_cache_size == 0 ? 0
+                                             : std::max<size_t>( _state_cache_size / num_state_cached_dbs, 1 );
+
+          _market_transactions_db.open( data_dir / "index/market_transactions_db", true, 0, true, false, state_db_cache_size );
           _fork_number_db.open( data_dir / "index/fork_number_db" );
           _fork_db.open( data_dir / "index/fork_db" );
           _slate_db.open( data_dir / "index/slate_db" );
@@ -104,6 +283,7 @@ namespace bts { namespace blockchain {
           _undo_state_db.open( data_dir / "index/undo_state_db" );
 
           _block_id_to_block_record_db.open( data_dir / "index/block_id_to_block_record_db" );
+          _block_id_to_block_filter_db.open( data_dir / "index/block_id_to_block_filter_db" );
           _block_num_to_id_db.open( data_dir / "raw_chain/block_num_to_id_db" );
           _block_id_to_block_data_db.open( data_dir / "raw_chain/block_id_to_block_data_db" );
           _id_to_transaction_record_db.open( data_dir / "index/id_to_transaction_record_db" );
@@ -111,15 +291,17 @@ namespace bts { namespace blockchain {
           _pending_transaction_db.open( data_dir / "index/pending_transaction_db" );
 
           _asset_db.open( data_dir / "index/asset_db" );
-          _balance_db.open( data_dir / "index/balance_db" );
+          _balance_db.open( data_dir / "index/balance_db", true, 0, true, false, state_db_cache_size );
+          _owner_to_balance_index.open( data_dir / "index/owner_to_balance_db" );
+          _asset_supply_db.open( data_dir / "index/asset_supply_db" );
           _address_to_trx_index.open( data_dir / "index/address_to_trx_db" );
           _auth_db.open( data_dir / "index/auth_db" );
           _asset_proposal_db.open( data_dir / "index/asset_proposal_db" );
-          _burn_db.open( data_dir / "index/burn_db" );
-          _account_db.open( data_dir / "index/account_db" );
-          _address_to_account_db.open( data_dir / "index/address_to_account_db" );
+          _burn_db.open( data_dir / "index/burn_db", true, 0, true, false, state_db_cache_size );
+          _account_db.open( data_dir / "index/account_db", true, 0, true, false, state_db_cache_size );
+          _address_to_account_db.open( data_dir / "index/address_to_account_db", true, 0, true, false, state_db_cache_size );
 
-          _account_index_db.open( data_dir / "index/account_index_db" );
+          _account_index_db.open( data_dir / "index/account_index_db", true, 0, true, false, state_db_cache_size );
           _symbol_index_db.open( data_dir / "index/symbol_index_db" );
           _delegate_vote_index_db.open( data_dir / "index/delegate_vote_index_db" );
 
@@ -132,9 +314,6 @@ namespace bts { namespace blockchain {
           _short_db.open( data_dir / "index/short_db" );
           _collateral_db.open( data_dir / "index/collateral_db" );
 
-          for( auto itr = _collateral_db.begin(); itr.valid(); ++itr )
-             _collateral_expiration_index.insert( expiration_index{itr.key().order_price.quote_asset_id, itr.value().expiration, itr.key()} );
-
           _feed_db.open( data_dir / "index/feed_db" );
 
           _object_db.open( data_dir / "index/object_db" );
@@ -142,21 +321,383 @@ namespace bts { namespace blockchain {
           _reverse_edge_index.open( data_dir / "index/reverse_edge_index" );
 
           _market_status_db.open( data_dir / "index/market_status_db" );
-          _market_history_db.open( data_dir / "index/market_history_db" );
+          _market_history_db.open( data_dir / "index/market_history_db", true, 0, true, false, state_db_cache_size );
+
+          /* Attaching replays an interrupted commit, so nothing may be read from the index before this */
+          attach_write_journal();
+
+          for( auto itr = _bid_db.begin(); itr.valid(); ++itr )
+             _bid_book.store( itr.key(), itr.value() );
+          for( auto itr = _ask_db.begin(); itr.valid(); ++itr )
+             _ask_book.store( itr.key(), itr.value() );
+          for( auto itr = _relative_bid_db.begin(); itr.valid(); ++itr )
+             _relative_bid_book.store( itr.key(), itr.value() );
+          for( auto itr = _relative_ask_db.begin(); itr.valid(); ++itr )
+             _relative_ask_book.store( itr.key(), itr.value() );
+          for( auto itr = _short_db.begin(); itr.valid(); ++itr )
+             _short_book.store( itr.key(), itr.value() );
+
+          for( auto itr = _collateral_db.begin(); itr.valid(); ++itr )
+          {
+             _collateral_expiration_index.insert( expiration_index{itr.key().order_price.quote_asset_id, itr.value().expiration, itr.key()} );
+             _collateral_book.store( itr.key(), itr.value() );
+          }
 
           _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
 
           _revalidatable_future_blocks_db.open( data_dir / "index/future_blocks_db" );
           clear_invalidation_of_future_blocks();
 
+          // load the unexpired transactions in chain order, so each block is only read once
+          typedef std::pair<transaction_id_type, stored_transaction_record> recent_transaction;
+          vector<recent_transaction> recent_transactions;
           for( auto itr = _id_to_transaction_record_db.begin(); itr.valid(); ++itr )
           {
              const auto val = itr.value();
-             if( val.trx.expiration > self->now() )
-                _unique_transactions[val.trx.expiration].insert( val.trx.digest(_chain_id) );
+             if( val.expiration > self->now() )
+                recent_transactions.emplace_back( itr.key(), val );
+          }
+          std::sort( recent_transactions.begin(), recent_transactions.end(),
+                     []( const recent_transaction& a, const recent_transaction& b ) {
+                        return a.second.chain_location.block_num < b.second.chain_location.block_num;
+                     } );
+          for( const auto& item : recent_transactions )
+          {
+             const transaction_record record = load_transaction_record( item.second );
+             _unique_transactions[record.trx.expiration].insert( record.trx.digest(_chain_id) );
+             _recent_transaction_ids.insert( item.first );
+             _recent_transaction_expirations[record.trx.expiration].push_back( item.first );
           }
       } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+      void chain_database_impl::attach_write_journal()
+      { try {
+          _write_journal.attach( "property_db", _property_db );
+          _write_journal.attach( "market_transactions_db", _market_transactions_db );
+          _write_journal.attach( "fork_number_db", _fork_number_db );
+          _write_journal.attach( "fork_db", _fork_db );
+          _write_journal.attach( "slate_db", _slate_db );
+
+          _write_journal.attach( "undo_state_db", _undo_state_db );
+
+          _write_journal.attach( "block_id_to_block_record_db", _block_id_to_block_record_db );
+          _write_journal.attach( "block_id_to_block_filter_db", _block_id_to_block_filter_db );
+          _write_journal.attach( "id_to_transaction_record_db", _id_to_transaction_record_db );
+
+          _write_journal.attach( "asset_db", _asset_db );
+          _write_journal.attach( "balance_db", _balance_db );
+          _write_journal.attach( "owner_to_balance_db", _owner_to_balance_index );
+          _write_journal.attach( "asset_supply_db", _asset_supply_db );
+          _write_journal.attach( "address_to_trx_db", _address_to_trx_index );
+          _write_journal.attach( "auth_db", _auth_db );
+          _write_journal.attach( "asset_proposal_db", _asset_proposal_db );
+          _write_journal.attach( "burn_db", _burn_db );
+          _write_journal.attach( "account_db", _account_db );
+          _write_journal.attach( "address_to_account_db", _address_to_account_db );
+
+          _write_journal.attach( "account_index_db", _account_index_db );
+          _write_journal.attach( "symbol_index_db", _symbol_index_db );
+          _write_journal.attach( "delegate_vote_index_db", _delegate_vote_index_db );
+
+          _write_journal.attach( "slot_record_db", _slot_record_db );
+
+          _write_journal.attach( "ask_db", _ask_db );
+          _write_journal.attach( "bid_db", _bid_db );
+          _write_journal.attach( "relative_ask_db", _relative_ask_db );
+          _write_journal.attach( "relative_bid_db", _relative_bid_db );
+          _write_journal.attach( "short_db", _short_db );
+          _write_journal.attach( "collateral_db", _collateral_db );
+
+          _write_journal.attach( "feed_db", _feed_db );
+
+          _write_journal.attach( "object_db", _object_db );
+          _write_journal.attach( "edge_index", _edge_index );
+          _write_journal.attach( "reverse_edge_index", _reverse_edge_index );
+
+          _write_journal.attach( "market_status_db", _market_status_db );
+          _write_journal.attach( "market_history_db", _market_history_db );
+
+          /* The head block is read back from block_num_to_id_db, so it is written after everything else.
+           * It lives in raw_chain, outside the journal's directory: if an interrupted commit is lost
+           * because the index is wiped, it still names a block the index is then rebuilt up to. */
+          _write_journal.attach( "block_num_to_id_db", _block_num_to_id_db );
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /**
+       *  Holds back every write to the index until commit_block_writes(). Returns false if writes are
+       *  already held back by an outer call or are not journaled right now.
+       */
+      bool chain_database_impl::begin_block_writes()
+      { try {
+          if( !_journal_block_writes || _write_journal.is_deferring() )
+              return false;
+          _write_journal.begin();
+          return true;
+      } FC_CAPTURE_AND_RETHROW() }
+
+      void chain_database_impl::commit_block_writes()
+      { try {
+          if( _write_journal.is_deferring() )
+              _write_journal.commit();
+      } FC_CAPTURE_AND_RETHROW() }
+
+      void chain_database_impl::adjust_supply_totals( const asset_id_type asset_id, const share_type supply_delta,
+                                                      const share_type debt_delta )
+      { try {
+          if( supply_delta == 0 && debt_delta == 0 )
+              return;
+
+          asset_supply_totals totals;
+          const auto prev_totals = _asset_supply_db.fetch_optional( asset_id );
+          if( prev_totals.valid() )
+              totals = *prev_totals;
+
+          totals.supply += supply_delta;
+          totals.debt += debt_delta;
+          _asset_supply_db.store( asset_id, totals );
+      } FC_CAPTURE_AND_RETHROW( (asset_id)(supply_delta)(debt_delta) ) }
+
+      map<uint32_t, fc::path> chain_database_impl::list_index_snapshots()const
+      {
+          map<uint32_t, fc::path> snapshots;
+          const fc::path snapshots_dir = _data_dir / "index_snapshots";
+          if( !fc::is_directory( snapshots_dir ) )
+              return snapshots;
+
+          fc::directory_iterator end_itr;
+          for( fc::directory_iterator itr( snapshots_dir ); itr != end_itr; ++itr )
+          {
+              /* Snapshots are only complete once their description has been written */
+              const fc::path info_file = *itr / "snapshot.json";
+              if( !fc::is_directory( *itr ) || !fc::exists( info_file ) )
+                  continue;
+
+              try
+              {
+                  const auto info = fc::json::from_file( info_file ).as<index_snapshot_info>();
+                  snapshots[ info.block_num ] = *itr;
+              }
+              catch( const fc::exception& e )
+              {
+                  wlog( "ignoring unreadable index snapshot ${p}: ${e}", ("p",*itr)("e",e.to_detail_string()) );
+              }
+          }
+          return snapshots;
+      }
+
+      /**
+       *  Starts a snapshot of the index at the current head block. Every index database is pinned with a
+       *  LevelDB snapshot right away, which is cheap, and the copies are then made on a background thread
+       *  into a temporary directory, described with snapshot.json and renamed into place, so an
+       *  interrupted snapshot is never mistaken for a complete one. Must be called between blocks, when
+       *  no writes are held back by the write journal.
+       */
+      void chain_database_impl::start_index_snapshot()
+      { try {
+          if( _index_snapshot_done.valid() && !_index_snapshot_done.ready() )
+          {
+              wlog( "skipping index snapshot at block ${n}, the previous one is still being written", ("n",_head_block_header.block_num) );
+              return;
+          }
+          FC_ASSERT( !_write_journal.is_deferring() );
+
+          const fc::path snapshots_dir = _data_dir / "index_snapshots";
+          const fc::path tmp_dir = snapshots_dir / "tmp";
+          if( fc::exists( tmp_dir ) )
+              fc::remove_all( tmp_dir );
+          fc::create_directories( tmp_dir );
+
+          vector<std::function<void()>> copy_tasks;
+          copy_tasks.push_back( _property_db.prepare_export_to_snapshot( tmp_dir / "property_db" ) );
+          copy_tasks.push_back( _market_transactions_db.prepare_export_to_snapshot( tmp_dir / "market_transactions_db" ) );
+          copy_tasks.push_back( _fork_number_db.prepare_export_to_snapshot( tmp_dir / "fork_number_db" ) );
+          copy_tasks.push_back( _fork_db.prepare_export_to_snapshot( tmp_dir / "fork_db" ) );
+          copy_tasks.push_back( _slate_db.prepare_export_to_snapshot( tmp_dir / "slate_db" ) );
+
+          copy_tasks.push_back( _undo_state_db.prepare_export_to_snapshot( tmp_dir / "undo_state_db" ) );
+
+          copy_tasks.push_back( _block_id_to_block_record_db.prepare_export_to_snapshot( tmp_dir / "block_id_to_block_record_db" ) );
+          copy_tasks.push_back( _block_id_to_block_filter_db.prepare_export_to_snapshot( tmp_dir / "block_id_to_block_filter_db" ) );
+          copy_tasks.push_back( _id_to_transaction_record_db.prepare_export_to_snapshot( tmp_dir / "id_to_transaction_record_db" ) );
+
+          copy_tasks.push_back( _pending_transaction_db.prepare_export_to_snapshot( tmp_dir / "pending_transaction_db" ) );
+
+          copy_tasks.push_back( _asset_db.prepare_export_to_snapshot( tmp_dir / "asset_db" ) );
+          copy_tasks.push_back( _balance_db.prepare_export_to_snapshot( tmp_dir / "balance_db" ) );
+          copy_tasks.push_back( _owner_to_balance_index.prepare_export_to_snapshot( tmp_dir / "owner_to_balance_db" ) );
+          copy_tasks.push_back( _asset_supply_db.prepare_export_to_snapshot( tmp_dir / "asset_supply_db" ) );
+          copy_tasks.push_back( _address_to_trx_index.prepare_export_to_snapshot( tmp_dir / "address_to_trx_db" ) );
+          copy_tasks.push_back( _auth_db.prepare_export_to_snapshot( tmp_dir / "auth_db" ) );
+          copy_tasks.push_back( _asset_proposal_db.prepare_export_to_snapshot( tmp_dir / "asset_proposal_db" ) );
+          copy_tasks.push_back( _burn_db.prepare_export_to_snapshot( tmp_dir / "burn_db" ) );
+          copy_tasks.push_back( _account_db.prepare_export_to_snapshot( tmp_dir / "account_db" ) );
+          copy_tasks.push_back( _address_to_account_db.prepare_export_to_snapshot( tmp_dir / "address_to_account_db" ) );
+
+          copy_tasks.push_back( _account_index_db.prepare_export_to_snapshot( tmp_dir / "account_index_db" ) );
+          copy_tasks.push_back( _symbol_index_db.prepare_export_to_snapshot( tmp_dir / "symbol_index_db" ) );
+          copy_tasks.push_back( _delegate_vote_index_db.prepare_export_to_snapshot( tmp_dir / "delegate_vote_index_db" ) );
+
+          copy_tasks.push_back( _slot_record_db.prepare_export_to_snapshot( tmp_dir / "slot_record_db" ) );
+
+          copy_tasks.push_back( _ask_db.prepare_export_to_snapshot( tmp_dir / "ask_db" ) );
+          copy_tasks.push_back( _bid_db.prepare_export_to_snapshot( tmp_dir / "bid_db" ) );
+          copy_tasks.push_back( _relative_ask_db.prepare_export_to_snapshot( tmp_dir / "relative_ask_db" ) );
+          copy_tasks.push_back( _relative_bid_db.prepare_export_to_snapshot( tmp_dir / "relative_bid_db" ) );
+          copy_tasks.push_back( _short_db.prepare_export_to_snapshot( tmp_dir / "short_db" ) );
+          copy_tasks.push_back( _collateral_db.prepare_export_to_snapshot( tmp_dir / "collateral_db" ) );
+
+          copy_tasks.push_back( _feed_db.prepare_export_to_snapshot( tmp_dir / "feed_db" ) );
+
+          copy_tasks.push_back( _object_db.prepare_export_to_snapshot( tmp_dir / "object_db" ) );
+          copy_tasks.push_back( _edge_index.prepare_export_to_snapshot( tmp_dir / "edge_index" ) );
+          copy_tasks.push_back( _reverse_edge_index.prepare_export_to_snapshot( tmp_dir / "reverse_edge_index" ) );
+
+          copy_tasks.push_back( _market_status_db.prepare_export_to_snapshot( tmp_dir / "market_status_db" ) );
+          copy_tasks.push_back( _market_history_db.prepare_export_to_snapshot( tmp_dir / "market_history_db" ) );
+
+          copy_tasks.push_back( _revalidatable_future_blocks_db.prepare_export_to_snapshot( tmp_dir / "future_blocks_db" ) );
+
+          index_snapshot_info info;
+          info.block_num = _head_block_header.block_num;
+          info.block_id = _head_block_id;
+          info.database_version = BTS_BLOCKCHAIN_DATABASE_VERSION;
+          info.timestamp = _head_block_header.timestamp;
+
+          if( !_index_snapshot_thread )
+              _index_snapshot_thread.reset( new fc::thread( "index_snapshot" ) );
+          _index_snapshot_done = _index_snapshot_thread->async( [this, copy_tasks, info, snapshots_dir, tmp_dir]()
+          {
+              try
+              {
+                  const auto start_time = time_point::now();
+                  for( const auto& copy : copy_tasks )
+                      copy();
+                  fc::json::save_to_file( info, tmp_dir / "snapshot.json" );
+
+                  const fc::path snapshot_dir = snapshots_dir / std::to_string( info.block_num );
+                  if( fc::exists( snapshot_dir ) )
+                      fc::remove_all( snapshot_dir );
+                  fc::rename( tmp_dir, snapshot_dir );
+
+                  /* Drop snapshots from beyond this one (left over from a fork we switched away from) and the oldest ones */
+                  auto snapshots = list_index_snapshots();
+                  for( auto itr = snapshots.upper_bound( info.block_num ); itr != snapshots.end(); )
+                  {
+                      fc::remove_all( itr->second );
+                      itr = snapshots.erase( itr );
+                  }
+                  while( snapshots.size() > BTS_BLOCKCHAIN_MAX_INDEX_SNAPSHOTS )
+                  {
+                      fc::remove_all( snapshots.begin()->second );
+                      snapshots.erase( snapshots.begin() );
+                  }
+
+                  ilog( "wrote index snapshot at block ${n} in ${t} ms",
+                        ("n",info.block_num)("t",(time_point::now() - start_time).count() / 1000) );
+              }
+              catch( const fc::exception& e )
+              {
+                  wlog( "failed to write index snapshot: ${e}", ("e",e.to_detail_string()) );
+              }
+          }, "write_index_snapshot" );
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /** waits for the index snapshot being written in the background, if any */
+      void chain_database_impl::wait_for_index_snapshot()
+      {
+          if( _index_snapshot_done.valid() )
+          {
+              _index_snapshot_done.wait();
+              _index_snapshot_done = fc::future<void>();
+          }
+      }
+
+      /**
+       *  Replaces the index with the newest snapshot that is still on our chain and replays the blocks
+       *  after it from the raw chain. Returns false if no snapshot could be used, in which case the
+       *  caller must fall back to a full reindex.
+       */
+      bool chain_database_impl::restore_index_snapshot( const fc::path& data_dir )
+      {
+          const auto snapshots = list_index_snapshots();
+          for( auto snapshot_itr = snapshots.rbegin(); snapshot_itr != snapshots.rend(); ++snapshot_itr )
+          {
+              const fc::path& snapshot_dir = snapshot_itr->second;
+              map<uint32_t, block_id_type> replay_ids;
+              try
+              {
+                  const auto info = fc::json::from_file( snapshot_dir / "snapshot.json" ).as<index_snapshot_info>();
+                  if( info.database_version != BTS_BLOCKCHAIN_DATABASE_VERSION )
+                      continue;
+
+                  const auto snapshot_block_id = _block_num_to_id_db.fetch_optional( info.block_num );
+                  if( !snapshot_block_id.valid() || *snapshot_block_id != info.block_id )
+                      continue;
+
+                  std::cout << "Restoring database index from snapshot at block " << info.block_num << "...\n" << std::flush;
+
+                  self->close();
+                  _collateral_expiration_index.clear();
+                  _unique_transactions.clear();
+                  _recent_transaction_ids.clear();
+                  _recent_transaction_expirations.clear();
+
+                  fc::remove_all( data_dir / "index" );
+                  fc::create_directories( data_dir / "index" );
+                  fc::directory_iterator end_itr;
+                  for( fc::directory_iterator db_itr( snapshot_dir ); db_itr != end_itr; ++db_itr )
+                  {
+                      if( !fc::is_directory( *db_itr ) )
+                          continue;
+                      const fc::path db_dir = data_dir / "index" / db_itr->filename();
+                      fc::create_directories( db_dir );
+                      for( fc::directory_iterator file_itr( *db_itr ); file_itr != end_itr; ++file_itr )
+                          fc::copy( *file_itr, db_dir / file_itr->filename() );
+                  }
+
+                  open_database( data_dir );
+
+                  /* The blocks after the snapshot are re-added to block_num_to_id_db as they are pushed */
+                  for( auto itr = _block_num_to_id_db.lower_bound( info.block_num + 1 ); itr.valid(); ++itr )
+                      replay_ids.emplace_hint( replay_ids.end(), itr.key(), itr.value() );
+                  for( const auto& item : replay_ids )
+                      _block_num_to_id_db.remove( item.first );
+
+                  _head_block_header = self->get_block_digest( info.block_id );
+                  _head_block_id = info.block_id;
+                  _chain_id = self->get_property( bts::blockchain::chain_id ).as<digest_type>();
+
+                  const auto start_time = blockchain::now();
+                  for( const auto& item : replay_ids )
+                      self->push_block( _block_id_to_block_data_db.fetch( item.second ) );
+
+                  if( !replay_ids.empty() )
+                      FC_ASSERT( _head_block_id == replay_ids.rbegin()->second, "replay did not reach the previous head block" );
+
+                  std::cout << "Replayed " << replay_ids.size() << " blocks in "
+                            << (blockchain::now() - start_time).to_seconds() << " seconds.\n" << std::flush;
+                  return true;
+              }
+              catch( const fc::exception& e )
+              {
+                  elog( "unable to restore index snapshot ${p}: ${e}", ("p",snapshot_dir)("e",e.to_detail_string()) );
+              }
+
+              /* Put back whatever we took out so that a full reindex still sees the whole chain */
+              try
+              {
+                  for( const auto& item : replay_ids )
+                      _block_num_to_id_db.store( item.first, item.second );
+              }
+              catch( const fc::exception& e )
+              {
+                  elog( "unable to restore block numbers after failed replay: ${e}", ("e",e.to_detail_string()) );
+              }
+              return false;
+          }
+          return false;
+      }
+
       void chain_database_impl::clear_invalidation_of_future_blocks()
       {
         for (auto block_id_itr = _revalidatable_future_blocks_db.begin(); block_id_itr.valid(); ++block_id_itr)
@@ -508,7 +1049,8 @@ namespace bts { namespace blockchain {
                                                                                       const full_block& block_data )
       { try {
           //we should never try to store a block we've already seen (verify not in any of our databases)
-          assert(!_block_id_to_block_data_db.fetch_optional(block_id));
+          //the raw block data is the exception: it is already present when replaying after restoring an index snapshot
+          assert(!_block_id_to_block_data_db.fetch_optional(block_id) || !_fork_db.fetch_optional(block_id));
           #ifndef NDEBUG
           {
             //check block id is not in fork_data, or if it is, make sure it's just a placeholder for block we are waiting for
@@ -700,11 +1242,162 @@ namespace bts { namespace blockchain {
          }
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
+      void chain_database_impl::start_worker_threads()
+      {
+         if( !_worker_threads.empty() )
+            return;
+
+         const uint32_t num_threads = std::max( 1u, std::thread::hardware_concurrency() );
+         _worker_threads.reserve( num_threads );
+         for( uint32_t i = 0; i < num_threads; ++i )
+            _worker_threads.push_back( std::unique_ptr<fc::thread>( new fc::thread( "chain_worker_" + std::to_string( i ) ) ) );
+      }
+
+      /**
+       *  Runs task( 0 ) through task( num_tasks - 1 ) on the worker threads and waits for all of them.
+       *  The wait blocks this thread rather than yielding the current task, so it is safe inside the
+       *  non-preemptable part of push_block as long as the worker threads were already started.
+       */
+      void chain_database_impl::run_on_worker_threads( size_t num_tasks, const std::function<void( size_t )>& task )
+      {
+         start_worker_threads();
+         const size_t num_threads = std::min( _worker_threads.size(), num_tasks );
+
+         std::mutex mutex;
+         std::condition_variable finished;
+         size_t remaining = num_threads;
+         std::exception_ptr error;
+
+         for( size_t t = 0; t < num_threads; ++t )
+         {
+            _worker_threads[ t ]->async( [&,t]()
+            {
+               std::exception_ptr task_error;
+               try
+               {
+                  for( size_t i = t; i < num_tasks; i += num_threads )
+                     task( i );
+               }
+               catch( ... )
+               {
+                  task_error = std::current_exception();
+               }
+
+               std::lock_guard<std::mutex> lock( mutex );
+               if( task_error && !error )
+                  error = task_error;
+               if( --remaining == 0 )
+                  finished.notify_one();
+            }, "chain_worker_task" );
+         }
+
+         std::unique_lock<std::mutex> lock( mutex );
+         finished.wait( lock, [&]() { return remaining == 0; } );
+         if( error )
+            std::rethrow_exception( error );
+      }
+
+      /**
+       *  Computes everything about a block that does not depend on chain state. This is safe
+       *  to call from any thread. Signers that fail to recover are left unset so that
+       *  extend_chain() recovers them itself and reports the original error.
+       */
+      prepared_block chain_database_impl::prepare_block( const full_block& block_data )const
+      {
+         prepared_block prepared;
+         prepared.id = block_data.id();
+
+         if( CHECKPOINT_BLOCKS.empty() || (--CHECKPOINT_BLOCKS.end())->first <= block_data.block_num )
+         {
+            try
+            {
+               prepared.signee = block_data.signee( false );
+            }
+            catch( ... )
+            {
+            }
+         }
+
+         if( !_skip_signature_verification )
+         {
+            prepared.trx_signees.resize( block_data.user_transactions.size() );
+            for( size_t i = 0; i < block_data.user_transactions.size(); ++i )
+            {
+               try
+               {
+                  prepared.trx_signees[ i ] = block_data.user_transactions[ i ].get_signed_addresses( _chain_id, false );
+               }
+               catch( ... )
+               {
+               }
+            }
+         }
+
+         return prepared;
+      }
+
+      /**
+       *  Recovering the signing keys of every transaction is the most expensive part of
+       *  evaluating a block and does not depend on chain state, so it is done here on a
+       *  pool of worker threads before the block is applied. Any transaction whose
+       *  signatures fail to recover is left for apply_transactions() to evaluate serially
+       *  so that the original error is reported.
+       */
+      void chain_database_impl::recover_transaction_signees( const block_id_type& block_id, const full_block& block_data )
+      { try {
+         if( _prepared_blocks.find( block_id ) != _prepared_blocks.end() )
+            return; // already prepared, e.g. by the reindex pipeline
+
+         _prepared_blocks.clear();
+         if( _skip_signature_verification || block_data.user_transactions.empty() )
+            return;
+
+         start_worker_threads();
+
+         const signed_transactions& transactions = block_data.user_transactions;
+         const size_t num_threads = std::min( _worker_threads.size(), transactions.size() );
+         vector<optional<unordered_set<address>>> signees( transactions.size() );
+
+         vector<fc::future<void>> recovery_progress;
+         recovery_progress.reserve( num_threads );
+         for( size_t t = 0; t < num_threads; ++t )
+         {
+            recovery_progress.push_back( _worker_threads[ t ]->async( [&,t]()
+            {
+               for( size_t i = t; i < transactions.size(); i += num_threads )
+               {
+                  try
+                  {
+                     signees[ i ] = transactions[ i ].get_signed_addresses( _chain_id, false );
+                  }
+                  catch( ... )
+                  {
+                  }
+               }
+            }, "recover_transaction_signees" ) );
+         }
+         for( auto& progress : recovery_progress )
+            progress.wait();
+
+         prepared_block& prepared = _prepared_blocks[ block_id ];
+         prepared.id = block_id;
+         prepared.trx_signees = std::move( signees );
+      } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
       void chain_database_impl::apply_transactions( const full_block& block,
                                                     const pending_chain_state_ptr& pending_state )
       {
          //ilog( "apply transactions from block: ${block_num}  ${trxs}", ("block_num",block.block_num)("trxs",user_transactions) );
          ilog( "Applying transactions from block: ${n}", ("n",block.block_num) );
+
+         vector<optional<unordered_set<address>>> recovered_signees;
+         const auto prepared_itr = _prepared_blocks.find( block.id() );
+         if( prepared_itr != _prepared_blocks.end() )
+         {
+            recovered_signees = std::move( prepared_itr->second.trx_signees );
+            _prepared_blocks.erase( prepared_itr );
+         }
+
          uint32_t trx_num = 0;
          try
          {
@@ -714,6 +1407,8 @@ namespace bts { namespace blockchain {
                //ilog( "applying   ${trx}", ("trx",trx) );
                transaction_evaluation_state_ptr trx_eval_state =
                       std::make_shared<transaction_evaluation_state>(pending_state.get(), _chain_id);
+               if( trx_num < recovered_signees.size() && recovered_signees[ trx_num ].valid() )
+                  trx_eval_state->set_signed_keys( std::move( *recovered_signees[ trx_num ] ) );
                trx_eval_state->evaluate( trx, _skip_signature_verification, false );
                //ilog( "evaluation: ${e}", ("e",*trx_eval_state) );
                // TODO:  capture the evaluation state with a callback for wallets...
@@ -956,18 +1651,49 @@ namespace bts { namespace blockchain {
         if( pending_state->get_head_block_num() < BTS_V0_4_29_FORK_BLOCK_NUM )
            return execute_markets_v1( timestamp, pending_state );
 
+        execute_markets_in_parallel( timestamp, pending_state );
+      } FC_CAPTURE_AND_RETHROW() }
+
+      void chain_database_impl::execute_markets_in_parallel( const fc::time_point_sec& timestamp, const pending_chain_state_ptr& pending_state )
+      { try {
         vector<market_transaction> market_transactions;
 
         const auto dirty_markets = self->get_dirty_markets();
         for( const auto& market_pair : dirty_markets )
-        {
            FC_ASSERT( market_pair.first > market_pair.second );
-           market_engine engine( pending_state, *this );
-           if( engine.execute( market_pair.first, market_pair.second, timestamp ) )
+
+        // Every market is matched against its own child state on the worker threads, then the results
+        // are applied in sorted market order exactly as if the markets had been executed one by one
+        const vector<std::pair<asset_id_type, asset_id_type>> markets( dirty_markets.begin(), dirty_markets.end() );
+        vector<std::unique_ptr<market_engine>> engines;
+        engines.reserve( markets.size() );
+        for( size_t i = 0; i < markets.size(); ++i )
+           engines.emplace_back( new market_engine( pending_state, *this ) );
+
+        vector<char> succeeded( markets.size(), false );
+        const auto evaluate_market = [&]( size_t i )
+        {
+           succeeded[ i ] = engines[ i ]->evaluate( markets[ i ].first, markets[ i ].second, timestamp );
+        };
+        if( markets.size() > 1 )
+           run_on_worker_threads( markets.size(), evaluate_market );
+        else if( !markets.empty() )
+           evaluate_market( 0 );
+
+        market_merge_state merge_state;
+        for( size_t i = 0; i < markets.size(); ++i )
+        {
+           if( !engines[ i ]->rebase( merge_state ) )
            {
-              if( _track_stats )
-                 market_transactions.insert( market_transactions.end(), engine._market_transactions.begin(), engine._market_transactions.end() );
+              wlog( "re-evaluating market ${quote} / ${base} after conflicting with another market",
+                    ("quote",markets[ i ].first)("base",markets[ i ].second) );
+              engines[ i ].reset( new market_engine( pending_state, *this ) );
+              evaluate_market( i );
            }
+           engines[ i ]->apply( &merge_state );
+
+           if( succeeded[ i ] && _track_stats )
+              market_transactions.insert( market_transactions.end(), engines[ i ]->_market_transactions.begin(), engines[ i ]->_market_transactions.end() );
         }
         if( _track_stats )
            pending_state->set_market_transactions( std::move( market_transactions ) );
@@ -984,18 +1710,35 @@ namespace bts { namespace blockchain {
          {
             public_key_type block_signee;
             if( CHECKPOINT_BLOCKS.size() > 0 && (--CHECKPOINT_BLOCKS.end())->first > block_data.block_num )
+            {
                //Skip signature validation
                block_signee = self->get_slot_signee( block_data.timestamp, self->get_active_delegates() ).signing_key();
+            }
             else
+            {
                /* We need the block_signee's key in several places and computing it is expensive, so compute it here and pass it down */
-               block_signee = block_data.signee( false );
+               const auto prepared_itr = _prepared_blocks.find( block_id );
+               if( prepared_itr != _prepared_blocks.end() && prepared_itr->second.signee.valid() )
+                  block_signee = *prepared_itr->second.signee;
+               else
+                  block_signee = block_data.signee( false );
+            }
 
             auto checkpoint_itr = CHECKPOINT_BLOCKS.find(block_data.block_num);
             if( checkpoint_itr != CHECKPOINT_BLOCKS.end() && checkpoint_itr->second != block_id )
               FC_CAPTURE_AND_THROW( failed_checkpoint_verification, (block_id)(checkpoint_itr->second) );
 
             /* Note: Secret is validated later in update_delegate_production_info() */
+            fc::time_point stage_start = fc::time_point::now();
+            const auto end_stage = [&]( fc::microseconds block_stage_timings::* stage )
+            {
+               const fc::time_point stage_end = fc::time_point::now();
+               _block_stage_timings.*stage += stage_end - stage_start;
+               stage_start = stage_end;
+            };
+
             verify_header( block_data, block_signee );
+            end_stage( &block_stage_timings::verify_header );
 
             summary.block_data = block_data;
 
@@ -1007,30 +1750,47 @@ namespace bts { namespace blockchain {
              *  before applying transactions because it depends upon the current active delegate order.
              **/
             update_delegate_production_info( block_data, pending_state, block_signee );
+            stage_start = fc::time_point::now();
 
             // apply any deterministic operations such as market operations before we perturb indexes
             //apply_deterministic_updates(pending_state);
 
             pay_delegate( pending_state, block_signee, block_id );
+            end_stage( &block_stage_timings::pay_delegate );
 
             if( block_data.block_num < BTS_V0_4_9_FORK_BLOCK_NUM )
+            {
                 apply_transactions( block_data, pending_state );
+                end_stage( &block_stage_timings::apply_transactions );
+            }
 
             execute_markets( block_data.timestamp, pending_state );
+            end_stage( &block_stage_timings::execute_markets );
 
             if( block_data.block_num >= BTS_V0_4_9_FORK_BLOCK_NUM )
+            {
                 apply_transactions( block_data, pending_state );
+                end_stage( &block_stage_timings::apply_transactions );
+            }
 
             update_active_delegate_list( block_data, pending_state );
 
             update_random_seed( block_data.previous_secret, pending_state );
 
+            stage_start = fc::time_point::now();
             save_undo_state( block_id, pending_state );
+            end_stage( &block_stage_timings::save_undo_state );
 
             // TODO: verify that apply changes can be called any number of
             // times without changing the database other than the first
             // attempt.
             pending_state->apply_changes();
+            end_stage( &block_stage_timings::apply_changes );
+
+            _block_id_to_block_filter_db.store( block_id, block_filter::build( block_data, pending_state->market_transactions, *self ) );
+            if( _track_stats )
+               index_address_transactions( block_data, false );
+            ++_block_stage_timings.blocks;
 
             mark_included( block_id, true );
 
@@ -1109,12 +1869,23 @@ namespace bts { namespace blockchain {
             throw;
          }
 
+         /* Taken once push_block has committed, the index is not copied while the chain is not preemptable */
+         if( _index_snapshot_interval != 0 && block_data.block_num % _index_snapshot_interval == 0 )
+            _index_snapshot_due = true;
+
          // purge the expired known transactions database, they cannot no longer fork us
          auto itr = _unique_transactions.begin();
          while( itr != _unique_transactions.end() && itr->first < self->now() )
          {
             itr = _unique_transactions.erase(itr);
          }
+         auto id_itr = _recent_transaction_expirations.begin();
+         while( id_itr != _recent_transaction_expirations.end() && id_itr->first < self->now() )
+         {
+            for( const auto& trx_id : id_itr->second )
+               _recent_transaction_ids.erase( trx_id );
+            id_itr = _recent_transaction_expirations.erase(id_itr);
+         }
 
          //Schedule the observer notifications for later; the chain is in a
          //non-premptable state right now, and observers may yield.
@@ -1178,6 +1949,10 @@ namespace bts { namespace blockchain {
 
          auto previous_block_id = _head_block_header.previous;
 
+         // the addresses are found from the state the block left behind, so remove them before undoing it
+         if( _track_stats )
+            index_address_transactions( self->get_block( _head_block_id ), true );
+
          bts::blockchain::pending_chain_state_ptr undo_state = std::make_shared<bts::blockchain::pending_chain_state>(_undo_state_db.fetch( _head_block_id ));
          undo_state->set_prev_state( self->shared_from_this() );
          undo_state->apply_changes();
@@ -1191,6 +1966,123 @@ namespace bts { namespace blockchain {
             fc::async([o,undo_state]{ o->state_changed( undo_state ); }, "call_state_changed_observer");
       } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
+      void chain_database_impl::index_address_transactions( const full_block& block, bool remove )
+      { try {
+         vector<address> addresses;
+         for( uint32_t trx_num = 0; trx_num < block.user_transactions.size(); ++trx_num )
+         {
+            const signed_transaction& trx = block.user_transactions[ trx_num ];
+            addresses.clear();
+            transaction_addresses( trx, *self, addresses );
+
+            address_transaction_key key;
+            key.block_num = block.block_num;
+            key.trx_num = trx_num;
+            for( const address& addr : addresses )
+            {
+               key.owner = addr;
+               if( remove )
+                  _address_to_trx_index.remove( key );
+               else
+                  _address_to_trx_index.store( key, trx.id() );
+            }
+         }
+      } FC_CAPTURE_AND_RETHROW( (block.block_num)(remove) ) }
+
+      transaction_record chain_database_impl::load_transaction_record( const stored_transaction_record& record )const
+      { try {
+         const block_id_type block_id = _block_num_to_id_db.fetch( record.chain_location.block_num );
+         if( !_last_loaded_block.valid() || _last_loaded_block_id != block_id )
+         {
+            _last_loaded_block = self->get_block( block_id );
+            _last_loaded_block_id = block_id;
+         }
+         return load_transaction_record( record, *_last_loaded_block );
+      } FC_CAPTURE_AND_RETHROW( (record) ) }
+
+      transaction_record chain_database_impl::load_transaction_record( const stored_transaction_record& record,
+                                                                       const full_block& block )const
+      { try {
+         FC_ASSERT( block.block_num == record.chain_location.block_num );
+         FC_ASSERT( record.chain_location.trx_num < block.user_transactions.size() );
+
+         transaction_record result;
+         result.chain_location = record.chain_location;
+         result.trx = block.user_transactions[ record.chain_location.trx_num ];
+         result.deposits = record.deposits;
+         result.withdraws = record.withdraws;
+         result.yield = record.yield;
+         result.deltas = record.deltas;
+         result.required_fees = record.required_fees;
+         result.alt_fees_paid = record.alt_fees_paid;
+         result.balance = record.balance;
+         return result;
+      } FC_CAPTURE_AND_RETHROW( (record) ) }
+
+      /** start of the week (Monday) or month containing the day starting at day_start */
+      static fc::time_point_sec market_history_period_start( market_history_key::time_granularity_enum granularity,
+                                                             const fc::time_point_sec& day_start )
+      {
+         const int64_t days = day_start.sec_since_epoch() / (60*60*24);
+         if( granularity == market_history_key::each_week )
+            return day_start - uint32_t( (days + 3) % 7 ) * (60*60*24); // 1970-01-01 was a Thursday
+
+         // day of the month, see http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+         const int64_t z = days + 719468;
+         const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+         const int64_t day_of_era = z - era * 146097;
+         const int64_t year_of_era = (day_of_era - day_of_era/1460 + day_of_era/36524 - day_of_era/146096) / 365;
+         const int64_t day_of_year = day_of_era - (365*year_of_era + year_of_era/4 - year_of_era/100);
+         const int64_t month_index = (5*day_of_year + 2) / 153;
+         const int64_t day_of_month = day_of_year - (153*month_index + 2)/5 + 1;
+         return day_start - uint32_t( day_of_month - 1 ) * (60*60*24);
+      }
+
+      /**
+       *  The rollup is recomputed from scratch rather than adjusted so that it stays correct when a
+       *  day record is overwritten by the next block or restored by popping a block.
+       */
+      void chain_database_impl::update_market_history_rollup( const market_history_key& day_key,
+                                                              market_history_key::time_granularity_enum granularity )
+      { try {
+         const fc::time_point_sec period_start = market_history_period_start( granularity, day_key.timestamp );
+
+         omarket_history_record rollup;
+         auto itr = _market_history_db.lower_bound( market_history_key( day_key.quote_id, day_key.base_id,
+                                                                        market_history_key::each_day, period_start ) );
+         for( ; itr.valid(); ++itr )
+         {
+            const market_history_key key = itr.key();
+            if( key.quote_id != day_key.quote_id || key.base_id != day_key.base_id
+                || key.granularity != market_history_key::each_day
+                || market_history_period_start( granularity, key.timestamp ) != period_start )
+               break;
+
+            const market_history_record day = itr.value();
+            if( !rollup.valid() )
+            {
+               rollup = day;
+               continue;
+            }
+            rollup->highest_bid = std::max( rollup->highest_bid, day.highest_bid );
+            rollup->lowest_ask = std::min( rollup->lowest_ask, day.lowest_ask );
+            rollup->closing_price = day.closing_price;
+            rollup->volume += day.volume;
+         }
+
+         const market_history_key rollup_key( day_key.quote_id, day_key.base_id, granularity, period_start );
+         if( rollup.valid() )
+            _market_history_db.store( rollup_key, *rollup );
+         else
+            _market_history_db.remove( rollup_key );
+      } FC_CAPTURE_AND_RETHROW( (day_key)(granularity) ) }
+
+      /** converts a price ratio to a double without formatting it as a string first */
+      static double market_history_price( const price& p, double scale )
+      {
+         return (double( p.ratio.high_bits() ) * 18446744073709551616.0 + double( p.ratio.low_bits() )) * scale;
+      }
+
    } // namespace detail
 
    chain_database::chain_database()
@@ -1199,6 +2091,8 @@ namespace bts { namespace blockchain {
       my->self = this;
       my->_skip_signature_verification = true;
       my->_relay_fee = BTS_BLOCKCHAIN_DEFAULT_RELAY_FEE;
+      my->_pending_fee_index.set_limits( BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS, BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTION_BYTES,
+                                         BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_SIGNER );
    }
 
    chain_database::~chain_database()
@@ -1268,6 +2162,13 @@ namespace bts { namespace blockchain {
             must_rebuild_index = true;
           }
 
+          // An interrupted reindex leaves id_to_data_orig behind and has to run to completion instead
+          if( must_rebuild_index && last_block_num != uint32_t(-1)
+              && !fc::is_directory( data_dir / "raw_chain/id_to_data_orig" ) )
+          {
+             must_rebuild_index = !my->restore_index_snapshot( data_dir );
+          }
+
           if( must_rebuild_index || last_block_num == uint32_t(-1) )
           {
              close();
@@ -1314,6 +2215,11 @@ namespace bts { namespace blockchain {
 
              // For the duration of reindexing, we allow certain databases to postpone flushing until we finish
              set_db_cache_write_through( false );
+             my->_journal_block_writes = false;
+
+             // Only snapshot the final state rather than every interval along the way
+             const uint32_t index_snapshot_interval = my->_index_snapshot_interval;
+             my->_index_snapshot_interval = 0;
 
              my->initialize_genesis( genesis_file );
 
@@ -1364,24 +2270,93 @@ namespace bts { namespace blockchain {
                  }
              };
 
-             if (num_to_id.empty())
+             // Reindexing is pipelined: a reader thread streams and deserializes the next batch of
+             // blocks and the worker pool recovers their signers while the chain thread applies the
+             // current batch, so the chain thread only has to apply state.
+             struct reindex_batch
              {
-                 for( auto block_itr = id_to_data_orig.begin(); block_itr.valid(); ++block_itr )
-                     insert_block(block_itr.value());
-             }
-             else
+                 vector<full_block>             blocks;
+                 vector<detail::prepared_block> prepared;
+             };
+             typedef std::shared_ptr<reindex_batch> reindex_batch_ptr;
+             static const size_t reindex_batch_size = 200;
+
+             auto block_itr = id_to_data_orig.begin();
+             auto num_id_itr = num_to_id.begin();
+             const auto read_batch = [&]() -> reindex_batch_ptr
              {
-                 for (const auto& num_id : num_to_id)
+                 reindex_batch_ptr batch = std::make_shared<reindex_batch>();
+                 batch->blocks.reserve( reindex_batch_size );
+                 if( num_to_id.empty() )
                  {
-                     auto oblock = id_to_data_orig.fetch_optional(num_id.second);
-                     if (oblock)
-                         insert_block(*oblock);
+                     for( ; block_itr.valid() && batch->blocks.size() < reindex_batch_size; ++block_itr )
+                         batch->blocks.push_back( block_itr.value() );
                  }
+                 else
+                 {
+                     for( ; num_id_itr != num_to_id.end() && batch->blocks.size() < reindex_batch_size; ++num_id_itr )
+                     {
+                         auto oblock = id_to_data_orig.fetch_optional( num_id_itr->second );
+                         if( oblock )
+                             batch->blocks.push_back( std::move( *oblock ) );
+                     }
+                 }
+
+                 const size_t num_blocks = batch->blocks.size();
+                 const size_t num_threads = std::min( my->_worker_threads.size(), num_blocks );
+                 batch->prepared.resize( num_blocks );
+                 vector<fc::future<void>> prepare_progress;
+                 prepare_progress.reserve( num_threads );
+                 for( size_t t = 0; t < num_threads; ++t )
+                 {
+                     prepare_progress.push_back( my->_worker_threads[ t ]->async( [&,t]()
+                     {
+                         for( size_t i = t; i < num_blocks; i += num_threads )
+                             batch->prepared[ i ] = my->prepare_block( batch->blocks[ i ] );
+                     }, "prepare_block" ) );
+                 }
+                 for( auto& progress : prepare_progress )
+                     progress.wait();
+
+                 return batch;
+             };
+
+             my->start_worker_threads();
+             fc::thread reader_thread( "reindex_reader" );
+             fc::future<reindex_batch_ptr> next_batch = reader_thread.async( read_batch, "reindex_read_batch" );
+             while( true )
+             {
+                 const reindex_batch_ptr batch = next_batch.wait();
+                 if( batch->blocks.empty() )
+                     break;
+                 next_batch = reader_thread.async( read_batch, "reindex_read_batch" );
+
+                 for( size_t i = 0; i < batch->blocks.size(); ++i )
+                 {
+                     my->_prepared_blocks[ batch->prepared[ i ].id ] = std::move( batch->prepared[ i ] );
+                     insert_block( batch->blocks[ i ] );
+                 }
+             }
+             my->_prepared_blocks.clear();
+
+             // Re-enable flushing on all cached databases we disabled it on above
+             set_db_cache_write_through( true );
+             my->_journal_block_writes = true;
+
+             my->_index_snapshot_interval = index_snapshot_interval;
+             if( my->_index_snapshot_interval != 0 && my->_head_block_header.block_num != 0 )
+             {
+                try
+                {
+                   my->start_index_snapshot();
+                   my->wait_for_index_snapshot();
+                }
+                catch( const fc::exception& e )
+                {
+                   wlog( "failed to write index snapshot: ${e}", ("e",e.to_detail_string()) );
+                }
              }
 
-             // Re-enable flushing on all cached databases we disabled it on above
-             set_db_cache_write_through( true );
-
              id_to_data_orig.close();
              fc::remove_all( data_dir / "raw_chain/id_to_data_orig" );
              auto final_chain_size = fc::directory_size( data_dir / "raw_chain/block_id_to_block_data_db" );
@@ -1405,18 +2380,18 @@ namespace bts { namespace blockchain {
              {
                 auto trx = pending_itr.value();
                 wlog( " loading pending transaction ${trx}", ("trx",trx) );
-                auto trx_id = trx.id();
                 auto id = trx.digest(my->_chain_id);
                 auto eval_state = evaluate_transaction( trx, my->_relay_fee );
-                share_type fees = eval_state->get_fees();
-                my->_pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
                 my->_pending_transaction_db.store( id, trx );
+                my->add_pending_transaction( eval_state );
              }
              catch ( const fc::exception& e )
              {
                 wlog( "error processing pending transaction: ${e}", ("e",e.to_detail_string() ) );
              }
           }
+          if( my->_pending_state_stale )
+             my->revalidate_pending();
       }
       catch (...)
       {
@@ -1435,6 +2410,12 @@ namespace bts { namespace blockchain {
 
    void chain_database::close()
    { try {
+      /* The snapshot being written reads from the databases closed below */
+      my->wait_for_index_snapshot();
+      my->_index_snapshot_due = false;
+      my->_write_journal.close();
+      my->_journal_block_writes = true;
+
       my->_fork_number_db.close();
       my->_fork_db.close();
       my->_slate_db.close();
@@ -1444,13 +2425,19 @@ namespace bts { namespace blockchain {
 
       my->_block_num_to_id_db.close();
       my->_block_id_to_block_record_db.close();
+      my->_block_id_to_block_filter_db.close();
       my->_block_id_to_block_data_db.close();
       my->_id_to_transaction_record_db.close();
+      my->_last_loaded_block.reset();
 
       my->_pending_transaction_db.close();
+      my->_pending_evaluations.clear();
+      my->_pending_state_stale = false;
 
       my->_asset_db.close();
       my->_balance_db.close();
+      my->_owner_to_balance_index.close();
+      my->_asset_supply_db.close();
       my->_address_to_trx_index.close();
       my->_burn_db.close();
       my->_account_db.close();
@@ -1470,6 +2457,13 @@ namespace bts { namespace blockchain {
       my->_collateral_db.close();
       my->_feed_db.close();
 
+      my->_ask_book.clear();
+      my->_bid_book.clear();
+      my->_relative_ask_book.clear();
+      my->_relative_bid_book.clear();
+      my->_short_book.clear();
+      my->_collateral_book.clear();
+
       my->_market_history_db.close();
       my->_market_status_db.close();
       my->_market_transactions_db.close();
@@ -1542,8 +2536,11 @@ namespace bts { namespace blockchain {
       if( !my->_pending_trx_state )
          my->_pending_trx_state = std::make_shared<pending_chain_state>( shared_from_this() );
 
-      pending_chain_state_ptr          pend_state = std::make_shared<pending_chain_state>(my->_pending_trx_state);
-      transaction_evaluation_state_ptr trx_eval_state = std::make_shared<transaction_evaluation_state>(pend_state.get(), my->_chain_id);
+      // a transaction that is expired or already known is turned away before any overlay is built for it
+      transaction_evaluation_state::check_expiration_and_uniqueness( *my->_pending_trx_state, trx, my->_chain_id );
+
+      const auto trx_eval_state = std::make_shared<detail::pending_trx_evaluation_state>( my->_pending_trx_state, my->_chain_id );
+      dependency_tracking_state_ptr pend_state( trx_eval_state, &trx_eval_state->tracking_state() );
 
       trx_eval_state->evaluate( trx, false, false );
       auto fees = trx_eval_state->get_fees() + trx_eval_state->alt_fees_paid.amount;
@@ -1552,12 +2549,36 @@ namespace bts { namespace blockchain {
           wlog("Transaction ${id} needed relay fee ${required_fees} but only had ${fees}", ("id", trx.id())("required_fees",required_fees)("fees",fees));
           FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(required_fees) );
       }
+      my->_pending_fee_index.check_admission( trx_eval_state->get_fees(), fc::raw::pack_size( trx ), trx_eval_state->signed_keys );
       // apply changes from this transaction to _pending_trx_state
       pend_state->apply_changes();
 
+      detail::pending_trx_evaluation evaluation;
+      evaluation.trx_digest = trx.digest( my->_chain_id );
+      evaluation.head_block_num = get_head_block_num();
+      evaluation.eval_state = trx_eval_state;
+      evaluation.changes = std::move( pend_state );
+      my->_pending_evaluations.push_back( std::move( evaluation ) );
+
       return trx_eval_state;
    } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+   void chain_database::execute_markets( const time_point_sec& timestamp, const pending_chain_state_ptr& pending_state, bool parallel )
+   { try {
+      if( parallel )
+         return my->execute_markets_in_parallel( timestamp, pending_state );
+
+      vector<market_transaction> market_transactions;
+      for( const auto& market_pair : get_dirty_markets() )
+      {
+         detail::market_engine engine( pending_state, *my );
+         if( engine.execute( market_pair.first, market_pair.second, timestamp ) )
+            market_transactions.insert( market_transactions.end(), engine._market_transactions.begin(), engine._market_transactions.end() );
+      }
+      if( my->_track_stats )
+         pending_state->set_market_transactions( std::move( market_transactions ) );
+   } FC_CAPTURE_AND_RETHROW( (timestamp)(parallel) ) }
+
    optional<fc::exception> chain_database::get_transaction_error( const signed_transaction& transaction, const share_type& min_fee )
    { try {
        try
@@ -1611,15 +2632,18 @@ namespace bts { namespace blockchain {
 
    vector<transaction_record> chain_database::get_transactions_for_block( const block_id_type& block_id )const
    {
+      FC_ASSERT( my->_track_stats );
       auto block_record = my->_block_id_to_block_record_db.fetch(block_id);
       vector<transaction_record> result;
       result.reserve( block_record.user_transaction_ids.size() );
 
+      // read the block once rather than once per transaction
+      const full_block block = get_block( block_id );
       for( const auto& trx_id : block_record.user_transaction_ids )
       {
-         auto otrx_record = get_transaction( trx_id );
-         if( !otrx_record ) FC_CAPTURE_AND_THROW( unknown_transaction, (trx_id) );
-         result.emplace_back( *otrx_record );
+         auto stored_record = my->_id_to_transaction_record_db.fetch_optional( trx_id );
+         if( !stored_record ) FC_CAPTURE_AND_THROW( unknown_transaction, (trx_id) );
+         result.emplace_back( my->load_transaction_record( *stored_record, block ) );
       }
       return result;
    }
@@ -1646,6 +2670,21 @@ namespace bts { namespace blockchain {
       return get_block( block_id );
    } FC_RETHROW_EXCEPTIONS( warn, "", ("block_num",block_num) ) }
 
+   std::vector<char> chain_database::get_packed_block( uint32_t block_num )const
+   { try {
+      const auto block_id = my->_block_num_to_id_db.fetch( block_num );
+      auto packed_block = my->_block_id_to_block_data_db.fetch_packed( block_id );
+      FC_ASSERT( packed_block.valid(), "missing data for block ${id}", ("id",block_id) );
+      return std::move( *packed_block );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+   oblock_filter chain_database::get_block_filter( uint32_t block_num )const
+   { try {
+      const auto block_id = my->_block_num_to_id_db.fetch_optional( block_num );
+      if( !block_id.valid() ) return oblock_filter();
+      return my->_block_id_to_block_filter_db.fetch_optional( *block_id );
+   } FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
    signed_block_header chain_database::get_head_block()const
    {
       return my->_head_block_header;
@@ -1674,6 +2713,14 @@ namespace bts { namespace blockchain {
                            ("head_block_num", head_block_num)("undo_history", BTS_BLOCKCHAIN_MAX_UNDO_HISTORY));
       }
 
+      auto block_id = block_data.id();
+
+      // Signature recovery runs on worker threads, so it has to happen before we
+      // enter the non-preemptable section below. Starting the threads yields too, and
+      // market execution needs them inside that section.
+      my->start_worker_threads();
+      my->recover_transaction_signees( block_id, block_data );
+
       // only allow a single fiber attempt to push blocks at any given time,
       // this method is not re-entrant.
       fc::unique_lock<fc::mutex> lock( my->_push_block_mutex );
@@ -1685,75 +2732,103 @@ namespace bts { namespace blockchain {
       // see partially-applied blocks
       ASSERT_TASK_NOT_PREEMPTED();
 
-      auto processing_start_time = time_point::now();
-      auto block_id = block_data.id();
-      //auto current_head_id = my->_head_block_id;
-
-      std::pair<block_id_type, block_fork_data> longest_fork = my->store_and_index( block_id, block_data );
-      assert(get_block_fork_data(block_id) && "can't get fork data for a block we just successfully pushed");
-
-      /*
-      store_and_index has returned the potential chain with the longest_fork (highest block number other than possible the current head block number)
-      if (longest_fork is linked and not known to be invalid and is higher than the current head block number)
-        highest_unchecked_block_number = longest_fork blocknumber;
-        do
-          foreach next_fork_to_try in all blocks at same block number
-              if (next_fork_try is linked and not known to be invalid)
-                try
-                  switch_to_fork(next_fork_to_try) //this throws if block in fork is invalid, then we'll try another fork
-                  return
-                catch block from future and add to database for potential revalidation on startup or if we get from another peer later
-                catch any other invalid block and do nothing
-          --highest_unchecked_block_number
-        while(highest_unchecked_block_number > 0)
-      */
-      if (longest_fork.second.can_link())
-      {
-        full_block longest_fork_block = my->_block_id_to_block_data_db.fetch(longest_fork.first);
-        uint32_t highest_unchecked_block_number = longest_fork_block.block_num;
-        if (highest_unchecked_block_number > head_block_num)
-        {
+      const auto store_and_switch = [&]() -> block_fork_data
+      {
+         auto processing_start_time = time_point::now();
+         //auto current_head_id = my->_head_block_id;
+
+         std::pair<block_id_type, block_fork_data> longest_fork = my->store_and_index( block_id, block_data );
+         assert(get_block_fork_data(block_id) && "can't get fork data for a block we just successfully pushed");
+
+         /*
+         store_and_index has returned the potential chain with the longest_fork (highest block number other than possible the current head block number)
+         if (longest_fork is linked and not known to be invalid and is higher than the current head block number)
+           highest_unchecked_block_number = longest_fork blocknumber;
+           do
+             foreach next_fork_to_try in all blocks at same block number
+                 if (next_fork_try is linked and not known to be invalid)
+                   try
+                     switch_to_fork(next_fork_to_try) //this throws if block in fork is invalid, then we'll try another fork
+                     return
+                   catch block from future and add to database for potential revalidation on startup or if we get from another peer later
+                   catch any other invalid block and do nothing
+             --highest_unchecked_block_number
+           while(highest_unchecked_block_number > 0)
+         */
+         if (longest_fork.second.can_link())
+         {
+           full_block longest_fork_block = my->_block_id_to_block_data_db.fetch(longest_fork.first);
+           uint32_t highest_unchecked_block_number = longest_fork_block.block_num;
+           if (highest_unchecked_block_number > head_block_num)
+           {
 
-          do
-          {
-            optional<vector<block_id_type>> parallel_blocks = my->_fork_number_db.fetch_optional(highest_unchecked_block_number);
-            if (parallel_blocks)
-              //for all blocks at same block number
-              for (const block_id_type& next_fork_to_try_id : *parallel_blocks)
-              {
-                block_fork_data next_fork_to_try = my->_fork_db.fetch(next_fork_to_try_id);
-                if (next_fork_to_try.can_link())
-                  try
-                  {
-                    my->switch_to_fork(next_fork_to_try_id); //verify this works if next_fork_to_try is current head block
-                    /* Store processing time */
-                    auto record = get_block_record( block_id );
-                    FC_ASSERT( record.valid() );
-                    record->processing_time = time_point::now() - processing_start_time;
-                    my->_block_id_to_block_record_db.store( block_id, *record );
-                    return *get_block_fork_data(block_id);
-                  }
-                  catch (const time_in_future& e)
-                  {
-                    // Blocks from the future can become valid later, so keep a list of these blocks that we can iterate over
-                    // whenever we think our clock time has changed from it's standard flow
-                    my->_revalidatable_future_blocks_db.store(block_id, 0);
-                    wlog("fork rejected because it has block with time in future, storing block id for revalidation later");
-                  }
-                  catch (const fc::exception& e) //swallow any invalidation exceptions except for time_in_future invalidations
-                  {
-                    wlog("fork permanently rejected as it has permanently invalid block");
-                  }
-              }
-            --highest_unchecked_block_number;
-          } while(highest_unchecked_block_number > 0); // while condition should only fail if we've never received a valid block yet
-        } //end if fork is longer than current chain (including possibly by extending chain)
+             do
+             {
+               optional<vector<block_id_type>> parallel_blocks = my->_fork_number_db.fetch_optional(highest_unchecked_block_number);
+               if (parallel_blocks)
+                 //for all blocks at same block number
+                 for (const block_id_type& next_fork_to_try_id : *parallel_blocks)
+                 {
+                   block_fork_data next_fork_to_try = my->_fork_db.fetch(next_fork_to_try_id);
+                   if (next_fork_to_try.can_link())
+                     try
+                     {
+                       my->switch_to_fork(next_fork_to_try_id); //verify this works if next_fork_to_try is current head block
+                       /* Store processing time */
+                       auto record = get_block_record( block_id );
+                       FC_ASSERT( record.valid() );
+                       record->processing_time = time_point::now() - processing_start_time;
+                       my->_block_id_to_block_record_db.store( block_id, *record );
+                       return *get_block_fork_data(block_id);
+                     }
+                     catch (const time_in_future& e)
+                     {
+                       // Blocks from the future can become valid later, so keep a list of these blocks that we can iterate over
+                       // whenever we think our clock time has changed from it's standard flow
+                       my->_revalidatable_future_blocks_db.store(block_id, 0);
+                       wlog("fork rejected because it has block with time in future, storing block id for revalidation later");
+                     }
+                     catch (const fc::exception& e) //swallow any invalidation exceptions except for time_in_future invalidations
+                     {
+                       wlog("fork permanently rejected as it has permanently invalid block");
+                     }
+                 }
+               --highest_unchecked_block_number;
+             } while(highest_unchecked_block_number > 0); // while condition should only fail if we've never received a valid block yet
+           } //end if fork is longer than current chain (including possibly by extending chain)
+         }
+         else
+         {
+            elog( "unable to link longest fork ${f}", ("f", longest_fork) );
+         }
+         return *get_block_fork_data(block_id);
+      };
+
+      // Everything pushing the block writes to the index is committed at once, so a crash part way through is never observed
+      const bool journaled = my->begin_block_writes();
+      try
+      {
+         const block_fork_data fork_data = store_and_switch();
+         if( journaled ) my->commit_block_writes();
+         if( my->_index_snapshot_due && !my->_write_journal.is_deferring() )
+         {
+            my->_index_snapshot_due = false;
+            try
+            {
+               my->start_index_snapshot();
+            }
+            catch( const fc::exception& e )
+            {
+               wlog( "failed to start index snapshot: ${e}", ("e",e.to_detail_string()) );
+            }
+         }
+         return fork_data;
       }
-      else
+      catch( ... )
       {
-         elog( "unable to link longest fork ${f}", ("f", longest_fork) );
+         if( journaled ) my->commit_block_writes();
+         throw;
       }
-      return *get_block_fork_data(block_id);
    } FC_CAPTURE_AND_RETHROW( (block_data) )  }
 
   std::vector<block_id_type> chain_database::get_fork_history( const block_id_type& id )
@@ -1858,6 +2933,24 @@ namespace bts { namespace blockchain {
           my->_balance_db.store( r.id(), r );
        }
 #endif
+       const obalance_record prev_record = my->_balance_db.fetch_optional( r.id() );
+       if( !prev_record.valid() )
+       {
+           /* The owners are part of the withdraw condition, which the balance id is derived from, so they never change */
+           set<address> owners;
+           try
+           {
+               owners = r.owners();
+           }
+           catch( const fc::exception& )
+           {
+               // conditions like escrow have no true owner and can only be found by their id
+           }
+           for( const address& owner : owners )
+               my->_owner_to_balance_index.store( std::make_pair( owner, r.id() ), 0 /*dummy value*/ );
+       }
+       my->adjust_supply_totals( r.asset_id(), r.balance - (prev_record.valid() ? prev_record->balance : 0) );
+
        /* Currently we keep all balance records forever so we know the owner and asset ID on wallet rescan */
        my->_balance_db.store( r.id(), r );
 
@@ -1969,6 +3062,14 @@ namespace bts { namespace blockchain {
        if( !prev_account_record.valid() && record_to_store.is_null() )
            return;
 
+       /* Delegate pay balances count towards the base asset supply */
+       const auto pay_balance = []( const oaccount_record& record ) -> share_type
+       {
+           if( !record.valid() || record->is_null() || !record->delegate_info.valid() ) return 0;
+           return record->delegate_info->pay_balance;
+       };
+       my->adjust_supply_totals( asset_id_type( 0 ), pay_balance( record_to_store ) - pay_balance( prev_account_record ) );
+
        if( prev_account_record.valid() && record_to_store.is_null() )
            return remove_record( *prev_account_record );
 
@@ -2113,12 +3214,15 @@ namespace bts { namespace blockchain {
    otransaction_record chain_database::get_transaction( const transaction_id_type& trx_id, bool exact )const
    { try {
       FC_ASSERT( my->_track_stats );
-      auto trx_rec = my->_id_to_transaction_record_db.fetch_optional( trx_id );
-      if( trx_rec || exact )
+      auto stored_rec = my->_id_to_transaction_record_db.fetch_optional( trx_id );
+      if( stored_rec || exact )
       {
+         if( !stored_rec )
+            return otransaction_record();
+
+         transaction_record trx_rec = my->load_transaction_record( *stored_rec );
          //ilog( "trx_rec: ${id} => ${t}", ("id",trx_id)("t",trx_rec) );
-         if( trx_rec )
-            FC_ASSERT( trx_rec->trx.id() == trx_id,"", ("trx_rec->id",trx_rec->trx.id()) );
+         FC_ASSERT( trx_rec.trx.id() == trx_id,"", ("trx_rec.id",trx_rec.trx.id()) );
          return trx_rec;
       }
 
@@ -2131,7 +3235,7 @@ namespace bts { namespace blockchain {
          if( memcmp( (char*)&id, (const char*)&trx_id, 4 ) != 0 )
             return otransaction_record();
 
-         return itr.value();
+         return my->load_transaction_record( itr.value() );
       }
       return otransaction_record();
    } FC_CAPTURE_AND_RETHROW( (trx_id)(exact) ) }
@@ -2143,6 +3247,8 @@ namespace bts { namespace blockchain {
       {
         if( my->_track_stats )
            my->_id_to_transaction_record_db.remove( record_id );
+        // the id is left in _recent_transaction_expirations, erasing it again when it expires is harmless
+        my->_recent_transaction_ids.erase( record_id );
         // NOTE: this does not work because record_to_store.trx is NULL, for now we check for
         // false positives by actually trying to fetch the transaction by record_id.
         // my->_unique_transactions[record_to_store.trx.expiration].erase( record_to_store.trx.digest(my->_chain_id) );
@@ -2162,9 +3268,11 @@ namespace bts { namespace blockchain {
                  elog( "_unique_transactions database out of sync, reported false positive!" );
               }
            }
+           if( my->_recent_transaction_ids.insert( record_id ).second )
+              my->_recent_transaction_expirations[record_to_store.trx.expiration].push_back( record_id );
         }
         if( my->_track_stats )
-           my->_id_to_transaction_record_db.store( record_id, record_to_store );
+           my->_id_to_transaction_record_db.store( record_id, stored_transaction_record( record_to_store ) );
       }
    } FC_CAPTURE_AND_RETHROW( (record_id)(record_to_store) ) }
 
@@ -2219,13 +3327,16 @@ namespace bts { namespace blockchain {
       }
 
       transaction_evaluation_state_ptr eval_state = evaluate_transaction( trx, relay_fee );
-      share_type fees = eval_state->get_fees();
 
       //if( fees < my->_relay_fee )
       //   FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(my->_relay_fee) );
 
-      my->_pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
       my->_pending_transaction_db.store( id, trx );
+      my->add_pending_transaction( eval_state );
+
+      // drop the changes of anything evicted so that a replacement spending the same balance is accepted
+      if( my->_pending_state_stale )
+         my->revalidate_pending();
 
       return eval_state;
    } FC_RETHROW_EXCEPTIONS( warn, "", ("trx",trx) ) }
@@ -2234,7 +3345,8 @@ namespace bts { namespace blockchain {
    std::vector<transaction_evaluation_state_ptr> chain_database::get_pending_transactions()const
    {
       std::vector<transaction_evaluation_state_ptr> trxs;
-      for( const auto& item : my->_pending_fee_index )
+      trxs.reserve( my->_pending_fee_index.size() );
+      for( const auto& item : my->_pending_fee_index.index() )
       {
           trxs.push_back( item.second );
       }
@@ -2389,24 +3501,48 @@ namespace bts { namespace blockchain {
    map<balance_id_type, balance_record> chain_database::get_balances_for_address( const address& addr )const
    { try {
         map<balance_id_type, balance_record> ret;
-        const auto scan_balance = [ &addr, &ret ]( const balance_record& record )
+        for( auto itr = my->_owner_to_balance_index.lower_bound( std::make_pair( addr, balance_id_type() ) ); itr.valid(); ++itr )
         {
-            if( record.is_owner( addr ) || addr == record.id() )
-                ret[record.id()] = record;
-        };
-        scan_balances( scan_balance );
+            const pair<address, balance_id_type> key = itr.key();
+            if( key.first != addr ) break;
+
+            const obalance_record record = get_balance_record( key.second );
+            if( record.valid() )
+                ret[ key.second ] = *record;
+        }
+
+        const obalance_record record = get_balance_record( addr );
+        if( record.valid() )
+            ret[ addr ] = *record;
+
         return ret;
    } FC_CAPTURE_AND_RETHROW( (addr) ) }
 
    map<balance_id_type, balance_record> chain_database::get_balances_for_key( const public_key_type& key )const
    { try {
-        map<balance_id_type, balance_record> ret;
-        const auto scan_balance = [ &key, &ret ]( const balance_record& record )
+        /* The same addresses balance_record::is_owner() accepts for a key */
+        const set<address> addrs
         {
-            if( record.is_owner( key ) )
-                ret[record.id()] = record;
+            address( key ),
+            address( pts_address( key, false, 56 ) ),
+            address( pts_address( key, true, 56 ) ),
+            address( pts_address( key, false, 0 ) ),
+            address( pts_address( key, true, 0 ) )
         };
-        scan_balances( scan_balance );
+
+        map<balance_id_type, balance_record> ret;
+        for( const address& addr : addrs )
+        {
+            for( auto itr = my->_owner_to_balance_index.lower_bound( std::make_pair( addr, balance_id_type() ) ); itr.valid(); ++itr )
+            {
+                const pair<address, balance_id_type> index_key = itr.key();
+                if( index_key.first != addr ) break;
+
+                const obalance_record record = get_balance_record( index_key.second );
+                if( record.valid() )
+                    ret[ index_key.second ] = *record;
+            }
+        }
         return ret;
    } FC_CAPTURE_AND_RETHROW( (key) ) }
 
@@ -2709,45 +3845,103 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_bid_record( const market_index_key& key, const order_record& order )
    {
+      const auto prev_order = my->_bid_db.fetch_optional( key );
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      if( key.order_price.quote_asset_id != asset_id_type( 0 ) )
+         my->adjust_supply_totals( key.order_price.quote_asset_id, order.balance - prev_balance );
+
       if( order.is_null() )
+      {
          my->_bid_db.remove( key );
+         my->_bid_book.remove( key );
+      }
       else
+      {
          my->_bid_db.store( key, order );
+         my->_bid_book.store( key, order );
+      }
    }
    void chain_database::store_relative_bid_record( const market_index_key& key, const order_record& order )
    {
+      const auto prev_order = my->_relative_bid_db.fetch_optional( key );
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      if( key.order_price.quote_asset_id != asset_id_type( 0 ) )
+         my->adjust_supply_totals( key.order_price.quote_asset_id, order.balance - prev_balance );
+
       if( order.is_null() )
+      {
          my->_relative_bid_db.remove( key );
+         my->_relative_bid_book.remove( key );
+      }
       else
+      {
          my->_relative_bid_db.store( key, order );
+         my->_relative_bid_book.store( key, order );
+      }
    }
 
    void chain_database::store_ask_record( const market_index_key& key, const order_record& order )
    {
+      const auto prev_order = my->_ask_db.fetch_optional( key );
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      my->adjust_supply_totals( key.order_price.base_asset_id, order.balance - prev_balance );
+
       if( order.is_null() )
+      {
          my->_ask_db.remove( key );
+         my->_ask_book.remove( key );
+      }
       else
+      {
          my->_ask_db.store( key, order );
+         my->_ask_book.store( key, order );
+      }
    }
 
    void chain_database::store_relative_ask_record( const market_index_key& key, const order_record& order )
    {
+      const auto prev_order = my->_relative_ask_db.fetch_optional( key );
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      my->adjust_supply_totals( key.order_price.base_asset_id, order.balance - prev_balance );
+
       if( order.is_null() )
+      {
          my->_relative_ask_db.remove( key );
+         my->_relative_ask_book.remove( key );
+      }
       else
+      {
          my->_relative_ask_db.store( key, order );
+         my->_relative_ask_book.store( key, order );
+      }
    }
 
    void chain_database::store_short_record( const market_index_key& key, const order_record& order )
    {
+      const auto prev_order = my->_short_db.fetch_optional( key );
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      my->adjust_supply_totals( asset_id_type( 0 ), order.balance - prev_balance );
+
       if( order.is_null() )
+      {
          my->_short_db.remove( key );
+         my->_short_book.remove( key );
+      }
       else
+      {
          my->_short_db.store( key, order );
+         my->_short_book.store( key, order );
+      }
    }
 
    void chain_database::store_collateral_record( const market_index_key& key, const collateral_record& collateral )
    {
+      const auto prev_collateral = my->_collateral_db.fetch_optional( key );
+      const share_type prev_collateral_balance = prev_collateral.valid() ? prev_collateral->collateral_balance : 0;
+      const share_type prev_payoff_balance = prev_collateral.valid() ? prev_collateral->payoff_balance : 0;
+      my->adjust_supply_totals( asset_id_type( 0 ), collateral.collateral_balance - prev_collateral_balance );
+      my->adjust_supply_totals( key.order_price.quote_asset_id, 0, collateral.payoff_balance - prev_payoff_balance );
+
       if( collateral.is_null() )
       {
          auto old_record = my->_collateral_db.fetch_optional(key);
@@ -2756,6 +3950,7 @@ namespace bts { namespace blockchain {
             my->_collateral_expiration_index.erase( {key.order_price.quote_asset_id,  old_record->expiration, key } );
          }
          my->_collateral_db.remove( key );
+         my->_collateral_book.remove( key );
       }
       else
       {
@@ -2766,6 +3961,7 @@ namespace bts { namespace blockchain {
             my->_collateral_expiration_index.insert( {key.order_price.quote_asset_id, collateral.expiration, key } );
          }
          my->_collateral_db.store( key, collateral );
+         my->_collateral_book.store( key, collateral );
       }
    }
 
@@ -3265,6 +4461,12 @@ namespace bts { namespace blockchain {
        my->_market_history_db.remove( key );
      else
        my->_market_history_db.store( key, record );
+
+     if( key.granularity == market_history_key::each_day )
+     {
+       my->update_market_history_rollup( key, market_history_key::each_week );
+       my->update_market_history_rollup( key, market_history_key::each_month );
+     }
    }
 
    omarket_history_record chain_database::get_market_history_record(const market_history_key& key) const
@@ -3304,34 +4506,92 @@ namespace bts { namespace blockchain {
                                                                    const fc::microseconds& duration,
                                                                    market_history_key::time_granularity_enum granularity)
    {
-      time_point_sec end_time = start_time + duration;
-      auto record_itr = my->_market_history_db.lower_bound( market_history_key(quote_id, base_id, granularity, start_time) );
+      const market_history_series series = get_market_price_series( quote_id, base_id, start_time, duration, 0, granularity );
       market_history_points history;
-      auto base = get_asset_record(base_id);
-      auto quote = get_asset_record(quote_id);
-
-      FC_ASSERT( base && quote );
-
-      while( record_itr.valid()
-             && record_itr.key().quote_id == quote_id
-             && record_itr.key().base_id == base_id
-             && record_itr.key().granularity == granularity
-             && record_itr.key().timestamp <= end_time )
+      history.reserve( series.timestamps.size() );
+      for( size_t i = 0; i < series.timestamps.size(); ++i )
       {
         history.push_back( {
-                             record_itr.key().timestamp,
-                             fc::variant(string(record_itr.value().highest_bid.ratio * base->precision / quote->precision)).as_double() / (BTS_BLOCKCHAIN_MAX_SHARES*1000),
-                             fc::variant(string(record_itr.value().lowest_ask.ratio * base->precision / quote->precision)).as_double() / (BTS_BLOCKCHAIN_MAX_SHARES*1000),
-                             fc::variant(string(record_itr.value().opening_price.ratio * base->precision / quote->precision)).as_double() / (BTS_BLOCKCHAIN_MAX_SHARES*1000),
-                             fc::variant(string(record_itr.value().closing_price.ratio * base->precision / quote->precision)).as_double() / (BTS_BLOCKCHAIN_MAX_SHARES*1000),
-                             record_itr.value().volume
+                             fc::time_point_sec( series.timestamps[i] ),
+                             series.highest_bid[i],
+                             series.lowest_ask[i],
+                             series.opening_price[i],
+                             series.closing_price[i],
+                             series.volume[i]
                            } );
-        ++record_itr;
       }
-
       return history;
    }
 
+   market_history_key::time_granularity_enum chain_database::select_market_history_granularity( const fc::microseconds& duration,
+                                                                                                uint32_t max_points )
+   {
+      static const std::pair<market_history_key::time_granularity_enum, int64_t> intervals[] = {
+         { market_history_key::each_block, BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC },
+         { market_history_key::each_hour,  60*60 },
+         { market_history_key::each_day,   60*60*24 },
+         { market_history_key::each_week,  60*60*24*7 }
+      };
+
+      const int64_t seconds = std::max<int64_t>( duration.to_seconds(), 0 );
+      for( const auto& item : intervals )
+      {
+         if( seconds / item.second <= max_points )
+            return item.first;
+      }
+      return market_history_key::each_month;
+   }
+
+   market_history_series chain_database::get_market_price_series( const asset_id_type& quote_id,
+                                                                  const asset_id_type& base_id,
+                                                                  const fc::time_point& start_time,
+                                                                  const fc::microseconds& duration,
+                                                                  uint32_t max_points )
+   {
+      FC_ASSERT( max_points > 0 );
+      return get_market_price_series( quote_id, base_id, start_time, duration, max_points,
+                                      select_market_history_granularity( duration, max_points ) );
+   }
+
+   market_history_series chain_database::get_market_price_series( const asset_id_type& quote_id,
+                                                                  const asset_id_type& base_id,
+                                                                  const fc::time_point& start_time,
+                                                                  const fc::microseconds& duration,
+                                                                  uint32_t max_points,
+                                                                  market_history_key::time_granularity_enum granularity )
+   { try {
+      const auto base = get_asset_record( base_id );
+      const auto quote = get_asset_record( quote_id );
+      FC_ASSERT( base && quote );
+
+      // ratio * base precision / quote precision, in units of BTS_BLOCKCHAIN_MAX_SHARES*1000
+      const double scale = double( base->precision ) / double( quote->precision ) / double( BTS_BLOCKCHAIN_MAX_SHARES*1000 );
+
+      const time_point_sec end_time = start_time + duration;
+      market_history_series series;
+      series.granularity = granularity;
+
+      for( auto record_itr = my->_market_history_db.lower_bound( market_history_key( quote_id, base_id, granularity, start_time ) );
+           record_itr.valid(); ++record_itr )
+      {
+         const market_history_key key = record_itr.key();
+         if( key.quote_id != quote_id || key.base_id != base_id || key.granularity != granularity || key.timestamp > end_time )
+            break;
+         if( max_points > 0 && series.timestamps.size() >= max_points )
+            break;
+
+         const market_history_record record = record_itr.value();
+         series.timestamps.push_back( key.timestamp.sec_since_epoch() );
+         series.highest_bid.push_back( detail::market_history_price( record.highest_bid, scale ) );
+         series.lowest_ask.push_back( detail::market_history_price( record.lowest_ask, scale ) );
+         series.opening_price.push_back( detail::market_history_price( record.opening_price, scale ) );
+         series.closing_price.push_back( detail::market_history_price( record.closing_price, scale ) );
+         series.volume.push_back( record.volume );
+      }
+
+      return series;
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(start_time)(duration)(max_points)(granularity) ) }
+
    bool chain_database::is_known_transaction( const fc::time_point_sec& exp, const digest_type& id )const
    {
       auto itr = my->_unique_transactions.find(exp);
@@ -3341,16 +4601,41 @@ namespace bts { namespace blockchain {
       }
       return false;
    }
+   bool chain_database::is_recent_transaction( const transaction_id_type& trx_id )const
+   {
+      return my->_recent_transaction_ids.count( trx_id ) != 0;
+   }
+
    void chain_database::skip_signature_verification( bool state )
    {
       my->_skip_signature_verification = state;
    }
 
+   void chain_database::set_index_snapshot_interval( uint32_t blocks )
+   {
+      my->_index_snapshot_interval = blocks;
+   }
+
    void chain_database::set_relay_fee( share_type shares )
    {
       my->_relay_fee = shares;
    }
 
+   block_stage_timings chain_database::get_block_stage_timings()const
+   {
+      return my->_block_stage_timings;
+   }
+
+   void chain_database::reset_block_stage_timings()
+   {
+      my->_block_stage_timings = block_stage_timings();
+   }
+
+   void chain_database::set_pending_transaction_limits( uint32_t max_count, uint64_t max_bytes, uint32_t max_per_signer )
+   {
+      my->_pending_fee_index.set_limits( max_count, max_bytes, max_per_signer );
+   }
+
    share_type chain_database::get_relay_fee()
    {
       return my->_relay_fee;
@@ -3480,6 +4765,56 @@ namespace bts { namespace blockchain {
        const auto record = get_asset_record( asset_id );
        FC_ASSERT( record.valid() );
 
+       // Fees plus the balances, orders, collateral and delegate pay tracked as they are stored
+       asset total( record->collected_fees, asset_id );
+
+       const auto totals = my->_asset_supply_db.fetch_optional( asset_id );
+       if( totals.valid() )
+           total.amount += totals->supply;
+
+       return total;
+   }
+
+   asset chain_database::calculate_debt( const asset_id_type& asset_id, bool include_interest )const
+   {
+       const auto record = get_asset_record( asset_id );
+       FC_ASSERT( record.valid() && record->is_market_issued() );
+
+       asset total( 0, asset_id );
+
+       // Interest depends on the age of each position, so only the principle is kept as a running total
+       if( !include_interest )
+       {
+           const auto totals = my->_asset_supply_db.fetch_optional( asset_id );
+           if( totals.valid() )
+               total.amount += totals->debt;
+           return total;
+       }
+
+       for( auto itr = my->_collateral_db.begin(); itr.valid(); ++itr )
+       {
+           const market_index_key& market_index = itr.key();
+           if( market_index.order_price.quote_asset_id != asset_id ) continue;
+           FC_ASSERT( market_index.order_price.base_asset_id == asset_id_type( 0 ) );
+
+           const collateral_record& record = itr.value();
+           const asset principle( record.payoff_balance, asset_id );
+           total += principle;
+           if( !include_interest ) continue;
+
+           const time_point_sec position_start_time = record.expiration - BTS_BLOCKCHAIN_MAX_SHORT_PERIOD_SEC;
+           const uint32_t position_age = (now() - position_start_time).to_seconds();
+           total += detail::market_engine::get_interest_owed( principle, record.interest_rate, position_age );
+       }
+
+       return total;
+   }
+
+   asset chain_database::scan_supply( const asset_id_type& asset_id )const
+   {
+       const auto record = get_asset_record( asset_id );
+       FC_ASSERT( record.valid() );
+
        // Add fees
        asset total( record->collected_fees, asset_id );
 
@@ -3496,19 +4831,13 @@ namespace bts { namespace blockchain {
        {
            const market_index_key market_index = ask_itr.key();
            if( market_index.order_price.base_asset_id == total.asset_id )
-           {
-               const order_record ask = ask_itr.value();
-               total.amount += ask.balance;
-           }
+               total.amount += ask_itr.value().balance;
        }
        for( auto ask_itr = my->_relative_ask_db.begin(); ask_itr.valid(); ++ask_itr )
        {
            const market_index_key market_index = ask_itr.key();
            if( market_index.order_price.base_asset_id == total.asset_id )
-           {
-               const order_record ask = ask_itr.value();
-               total.amount += ask.balance;
-           }
+               total.amount += ask_itr.value().balance;
        }
 
        // If base asset
@@ -3516,17 +4845,11 @@ namespace bts { namespace blockchain {
        {
            // Add short balances
            for( auto short_itr = my->_short_db.begin(); short_itr.valid(); ++short_itr )
-           {
-               const order_record sh = short_itr.value();
-               total.amount += sh.balance;
-           }
+               total.amount += short_itr.value().balance;
 
            // Add collateral balances
            for( auto collateral_itr = my->_collateral_db.begin(); collateral_itr.valid(); ++collateral_itr )
-           {
-               const collateral_record collateral = collateral_itr.value();
-               total.amount += collateral.collateral_balance;
-           }
+               total.amount += collateral_itr.value().collateral_balance;
 
            // Add pay balances
            for( auto account_itr = my->_account_db.begin(); account_itr.valid(); ++account_itr )
@@ -3543,48 +4866,27 @@ namespace bts { namespace blockchain {
            {
                const market_index_key market_index = bid_itr.key();
                if( market_index.order_price.quote_asset_id == total.asset_id )
-               {
-                   const order_record bid = bid_itr.value();
-                   total.amount += bid.balance;
-               }
+                   total.amount += bid_itr.value().balance;
            }
            for( auto bid_itr = my->_relative_bid_db.begin(); bid_itr.valid(); ++bid_itr )
            {
                const market_index_key market_index = bid_itr.key();
                if( market_index.order_price.quote_asset_id == total.asset_id )
-               {
-                   const order_record bid = bid_itr.value();
-                   total.amount += bid.balance;
-               }
+                   total.amount += bid_itr.value().balance;
            }
        }
 
        return total;
    }
 
-   asset chain_database::calculate_debt( const asset_id_type& asset_id, bool include_interest )const
+   asset chain_database::scan_debt( const asset_id_type& asset_id )const
    {
-       const auto record = get_asset_record( asset_id );
-       FC_ASSERT( record.valid() && record->is_market_issued() );
-
        asset total( 0, asset_id );
-
        for( auto itr = my->_collateral_db.begin(); itr.valid(); ++itr )
        {
-           const market_index_key& market_index = itr.key();
-           if( market_index.order_price.quote_asset_id != asset_id ) continue;
-           FC_ASSERT( market_index.order_price.base_asset_id == asset_id_type( 0 ) );
-
-           const collateral_record& record = itr.value();
-           const asset principle( record.payoff_balance, asset_id );
-           total += principle;
-           if( !include_interest ) continue;
-
-           const time_point_sec position_start_time = record.expiration - BTS_BLOCKCHAIN_MAX_SHORT_PERIOD_SEC;
-           const uint32_t position_age = (now() - position_start_time).to_seconds();
-           total += detail::market_engine::get_interest_owed( principle, record.interest_rate, position_age );
+           if( itr.key().order_price.quote_asset_id == asset_id )
+               total.amount += itr.value().payoff_balance;
        }
-
        return total;
    }
 
@@ -3840,8 +5142,9 @@ namespace bts { namespace blockchain {
    {
      fc::mutable_variant_object stats;
 #define CHAIN_DB_DATABASES (_market_transactions_db)(_slate_db)(_fork_number_db)(_fork_db)(_property_db)(_undo_state_db) \
-                           (_block_num_to_id_db)(_block_id_to_block_record_db)(_block_id_to_block_data_db) \
+                           (_block_num_to_id_db)(_block_id_to_block_record_db)(_block_id_to_block_data_db)(_block_id_to_block_filter_db) \
                            (_id_to_transaction_record_db)(_pending_transaction_db)(_pending_fee_index)(_asset_db)(_balance_db) \
+                           (_owner_to_balance_index)(_asset_supply_db) \
                            (_burn_db)(_account_db)(_address_to_account_db)(_account_index_db)(_symbol_index_db)(_delegate_vote_index_db) \
                            (_slot_record_db)(_ask_db)(_bid_db)(_short_db)(_collateral_db)(_feed_db)(_object_db)(_edge_index)(_reverse_edge_index)(_market_status_db)(_market_history_db) \
                            (_recent_operations)
@@ -3878,32 +5181,79 @@ namespace bts { namespace blockchain {
    {
       return my->_asset_proposal_db.fetch_optional( std::make_pair(asset_id,proposal_id) );
    }
-   void     chain_database::index_transaction( const address& addr, const transaction_id_type& trx_id )
-   {
-      if( my->_track_stats )
-         my->_address_to_trx_index.store( std::make_pair(addr,trx_id), char(0) );
-   }
-   vector<transaction_record>  chain_database::fetch_address_transactions( const address& addr )
-   {
+   address_transaction_page chain_database::fetch_address_transactions( const address& addr,
+                                                                        const otransaction_location& start,
+                                                                        uint32_t limit,
+                                                                        bool newest_first )const
+   { try {
       FC_ASSERT( my->_track_stats );
-      vector<transaction_record> results;
-      auto itr = my->_address_to_trx_index.lower_bound( std::make_pair(addr, transaction_id_type()) );
+      FC_ASSERT( limit > 0 );
+
+      address_transaction_key start_key;
+      start_key.owner = addr;
+      if( start.valid() )
+      {
+         start_key.block_num = start->block_num;
+         start_key.trx_num = start->trx_num;
+      }
+      else if( newest_first )
+      {
+         start_key.block_num = uint32_t( -1 );
+         start_key.trx_num = uint32_t( -1 );
+      }
+
+      auto itr = my->_address_to_trx_index.lower_bound( start_key );
+      if( newest_first )
+      {
+         // step back to the last key at or before start_key
+         if( !itr.valid() )
+            itr = my->_address_to_trx_index.last();
+         else if( !(itr.key() == start_key) )
+            --itr;
+      }
+
+      address_transaction_page page;
       while( itr.valid() )
       {
-         auto key = itr.key();
-         if( key.first != addr )
+         const address_transaction_key key = itr.key();
+         if( key.owner != addr )
             break;
 
-         if( auto otrx = get_transaction( key.second ) )
-            results.push_back( *otrx );
+         if( page.transactions.size() >= limit )
+         {
+            page.next = transaction_location( key.block_num, key.trx_num );
+            break;
+         }
 
-         ++itr;
+         if( auto otrx = get_transaction( itr.value() ) )
+            page.transactions.push_back( std::move( *otrx ) );
+
+         if( newest_first ) --itr;
+         else ++itr;
       }
-      return results;
-   }
+      return page;
+   } FC_CAPTURE_AND_RETHROW( (addr)(start)(limit)(newest_first) ) }
+
+   uint32_t chain_database::count_address_transactions( const address& addr )const
+   { try {
+      FC_ASSERT( my->_track_stats );
+      address_transaction_key start_key;
+      start_key.owner = addr;
+
+      uint32_t count = 0;
+      for( auto itr = my->_address_to_trx_index.lower_bound( start_key ); itr.valid() && itr.key().owner == addr; ++itr )
+         ++count;
+      return count;
+   } FC_CAPTURE_AND_RETHROW( (addr) ) }
+
    void chain_database::track_chain_statistics( bool status )
    {
       my->_track_stats = status;
    }
 
+   void chain_database::set_state_cache_size( size_t bytes )
+   {
+      my->_state_cache_size = bytes;
+   }
+
 } } // bts::blockchain
@@ -0,0 +1,344 @@
+#include <bts/blockchain/dependency_tracking_state.hpp>
+#include <fc/io/raw_variant.hpp>
+
+namespace bts { namespace blockchain {
+
+   namespace detail
+   {
+      template<typename RecordType>
+      bool same_record( const fc::optional<RecordType>& a, const fc::optional<RecordType>& b )
+      {
+         if( a.valid() != b.valid() ) return false;
+         return !a.valid() || fc::raw::pack( *a ) == fc::raw::pack( *b );
+      }
+
+      /**
+       *  The base asset's fee and supply totals change in every block, but no transaction can be
+       *  invalidated by them, so they are excluded here and merged by rebase_totals() instead.
+       */
+      bool same_asset( const oasset_record& a, const oasset_record& b )
+      {
+         if( !a.valid() || !b.valid() || a->id != asset_id_type( 0 ) || b->id != asset_id_type( 0 ) )
+            return same_record( a, b );
+
+         asset_record totals_ignored = *a;
+         totals_ignored.collected_fees = b->collected_fees;
+         totals_ignored.current_share_supply = b->current_share_supply;
+         return fc::raw::pack( totals_ignored ) == fc::raw::pack( *b );
+      }
+
+      /** remembers the first value read for key unless it came from this state's own writes */
+      template<typename ReadMap, typename WriteMap, typename Key, typename Value>
+      void record_read( ReadMap& reads, const WriteMap& writes, const Key& key, const Value& value )
+      {
+         if( writes.find( key ) == writes.end() )
+            reads.insert( std::make_pair( key, value ) );
+      }
+   }
+
+   dependency_tracking_state::dependency_tracking_state( chain_interface_ptr prev_state )
+   :pending_chain_state( prev_state )
+   {
+   }
+
+   bool dependency_tracking_state::can_rebase()const
+   {
+      if( _untracked_reads ) return false;
+
+      const chain_interface_ptr prev_state = _prev_state.lock();
+      if( !prev_state ) return false;
+
+      if( _now_read.valid() && *_now_read != prev_state->now() ) return false;
+      if( _head_block_num_read.valid() && *_head_block_num_read != prev_state->get_head_block_num() ) return false;
+
+      // a written asset must have been read first, otherwise its totals cannot be merged
+      for( const auto& item : assets )
+         if( _asset_reads.find( item.first ) == _asset_reads.end() ) return false;
+
+      for( const auto& item : _asset_reads )
+         if( !detail::same_asset( item.second, prev_state->get_asset_record( item.first ) ) ) return false;
+      for( const auto& item : _asset_symbol_reads )
+         if( !detail::same_asset( item.second, prev_state->get_asset_record( item.first ) ) ) return false;
+      for( const auto& item : _balance_reads )
+         if( !detail::same_record( item.second, prev_state->get_balance_record( item.first ) ) ) return false;
+      for( const auto& item : _account_reads )
+         if( !detail::same_record( item.second, prev_state->get_account_record( item.first ) ) ) return false;
+      for( const auto& item : _account_address_reads )
+         if( !detail::same_record( item.second, prev_state->get_account_record( item.first ) ) ) return false;
+      for( const auto& item : _account_name_reads )
+         if( !detail::same_record( item.second, prev_state->get_account_record( item.first ) ) ) return false;
+      for( const auto& item : _slate_reads )
+         if( !detail::same_record( item.second, prev_state->get_delegate_slate( item.first ) ) ) return false;
+      for( const auto& item : _known_transaction_reads )
+         if( item.second.second != prev_state->is_known_transaction( item.second.first, item.first ) ) return false;
+      for( const auto& item : _market_status_reads )
+         if( !detail::same_record( item.second, prev_state->get_market_status( item.first.first, item.first.second ) ) ) return false;
+      for( const auto& item : _bid_reads )
+         if( !detail::same_record( item.second, prev_state->get_bid_record( item.first ) ) ) return false;
+      for( const auto& item : _ask_reads )
+         if( !detail::same_record( item.second, prev_state->get_ask_record( item.first ) ) ) return false;
+      for( const auto& item : _relative_bid_reads )
+         if( !detail::same_record( item.second, prev_state->get_relative_bid_record( item.first ) ) ) return false;
+      for( const auto& item : _relative_ask_reads )
+         if( !detail::same_record( item.second, prev_state->get_relative_ask_record( item.first ) ) ) return false;
+      for( const auto& item : _short_reads )
+         if( !detail::same_record( item.second, prev_state->get_short_record( item.first ) ) ) return false;
+      for( const auto& item : _collateral_reads )
+         if( !detail::same_record( item.second, prev_state->get_collateral_record( item.first ) ) ) return false;
+      for( const auto& item : _property_reads )
+         if( fc::raw::pack( item.second ) != fc::raw::pack( prev_state->get_property( item.first ) ) ) return false;
+
+      return true;
+   }
+
+   void dependency_tracking_state::rebase_totals()
+   {
+      const chain_interface_ptr prev_state = _prev_state.lock();
+      FC_ASSERT( prev_state );
+
+      for( auto& item : assets )
+      {
+         oasset_record& original = _asset_reads[ item.first ];
+         const oasset_record current = prev_state->get_asset_record( item.first );
+         if( !original.valid() || !current.valid() )
+            continue;
+
+         asset_record merged = *current;
+         merged.collected_fees += item.second.collected_fees - original->collected_fees;
+         merged.current_share_supply += item.second.current_share_supply - original->current_share_supply;
+         item.second = merged;
+         original = current;
+      }
+
+      for( auto& item : _asset_symbol_reads )
+      {
+         if( item.second.valid() && item.second->id == asset_id_type( 0 ) )
+            item.second = prev_state->get_asset_record( item.first );
+      }
+   }
+
+   fc::time_point_sec dependency_tracking_state::now()const
+   {
+      const fc::time_point_sec value = pending_chain_state::now();
+      if( _track_chain_time && !_now_read.valid() )
+         _now_read = value;
+      return value;
+   }
+
+   uint32_t dependency_tracking_state::get_head_block_num()const
+   {
+      const uint32_t value = pending_chain_state::get_head_block_num();
+      if( _track_chain_time && !_head_block_num_read.valid() )
+         _head_block_num_read = value;
+      return value;
+   }
+
+   fc::ripemd160 dependency_tracking_state::get_current_random_seed()const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_current_random_seed();
+   }
+
+   optional<object_id_type> dependency_tracking_state::get_authorization( asset_id_type asset_id, const address& owner )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_authorization( asset_id, owner );
+   }
+
+   ofeed_record dependency_tracking_state::get_feed( const feed_index& i )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_feed( i );
+   }
+
+   oprice dependency_tracking_state::get_median_delegate_price( const asset_id_type& quote_id, const asset_id_type& base_id )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_median_delegate_price( quote_id, base_id );
+   }
+
+   optional<proposal_record> dependency_tracking_state::fetch_asset_proposal( asset_id_type asset_id, proposal_id_type proposal_id )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::fetch_asset_proposal( asset_id, proposal_id );
+   }
+
+   oburn_record dependency_tracking_state::fetch_burn_record( const burn_record_key& key )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::fetch_burn_record( key );
+   }
+
+   oasset_record dependency_tracking_state::get_asset_record( const asset_id_type& id )const
+   {
+      const oasset_record record = pending_chain_state::get_asset_record( id );
+      detail::record_read( _asset_reads, assets, id, record );
+      return record;
+   }
+
+   oasset_record dependency_tracking_state::get_asset_record( const string& symbol )const
+   {
+      const oasset_record record = pending_chain_state::get_asset_record( symbol );
+      detail::record_read( _asset_symbol_reads, symbol_id_index, symbol, record );
+      return record;
+   }
+
+   obalance_record dependency_tracking_state::get_balance_record( const balance_id_type& id )const
+   {
+      const obalance_record record = pending_chain_state::get_balance_record( id );
+      detail::record_read( _balance_reads, balances, id, record );
+      return record;
+   }
+
+   oaccount_record dependency_tracking_state::get_account_record( const account_id_type& id )const
+   {
+      const oaccount_record record = pending_chain_state::get_account_record( id );
+      detail::record_read( _account_reads, accounts, id, record );
+      return record;
+   }
+
+   oaccount_record dependency_tracking_state::get_account_record( const address& owner )const
+   {
+      const oaccount_record record = pending_chain_state::get_account_record( owner );
+      detail::record_read( _account_address_reads, key_to_account, owner, record );
+      return record;
+   }
+
+   oaccount_record dependency_tracking_state::get_account_record( const string& name )const
+   {
+      const oaccount_record record = pending_chain_state::get_account_record( name );
+      detail::record_read( _account_name_reads, account_id_index, name, record );
+      return record;
+   }
+
+   odelegate_slate dependency_tracking_state::get_delegate_slate( slate_id_type id )const
+   {
+      const odelegate_slate slate = pending_chain_state::get_delegate_slate( id );
+      detail::record_read( _slate_reads, slates, id, slate );
+      return slate;
+   }
+
+   bool dependency_tracking_state::is_known_transaction( const fc::time_point_sec& exp, const digest_type& trx_id )const
+   {
+      const bool known = pending_chain_state::is_known_transaction( exp, trx_id );
+      detail::record_read( _known_transaction_reads, unique_transactions, trx_id, std::make_pair( exp, known ) );
+      return known;
+   }
+
+   otransaction_record dependency_tracking_state::get_transaction( const transaction_id_type& trx_id, bool exact )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_transaction( trx_id, exact );
+   }
+
+   omarket_status dependency_tracking_state::get_market_status( const asset_id_type& quote_id, const asset_id_type& base_id )
+   {
+      const omarket_status status = pending_chain_state::get_market_status( quote_id, base_id );
+      detail::record_read( _market_status_reads, market_statuses, std::make_pair( quote_id, base_id ), status );
+      return status;
+   }
+
+   omarket_order dependency_tracking_state::get_lowest_ask_record( const asset_id_type& quote_id, const asset_id_type& base_id )
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_lowest_ask_record( quote_id, base_id );
+   }
+
+   oorder_record dependency_tracking_state::get_bid_record( const market_index_key& key )const
+   {
+      const oorder_record record = pending_chain_state::get_bid_record( key );
+      detail::record_read( _bid_reads, bids, key, record );
+      return record;
+   }
+
+   oorder_record dependency_tracking_state::get_ask_record( const market_index_key& key )const
+   {
+      const oorder_record record = pending_chain_state::get_ask_record( key );
+      detail::record_read( _ask_reads, asks, key, record );
+      return record;
+   }
+
+   oorder_record dependency_tracking_state::get_relative_bid_record( const market_index_key& key )const
+   {
+      const oorder_record record = pending_chain_state::get_relative_bid_record( key );
+      detail::record_read( _relative_bid_reads, relative_bids, key, record );
+      return record;
+   }
+
+   oorder_record dependency_tracking_state::get_relative_ask_record( const market_index_key& key )const
+   {
+      const oorder_record record = pending_chain_state::get_relative_ask_record( key );
+      detail::record_read( _relative_ask_reads, relative_asks, key, record );
+      return record;
+   }
+
+   oorder_record dependency_tracking_state::get_short_record( const market_index_key& key )const
+   {
+      const oorder_record record = pending_chain_state::get_short_record( key );
+      detail::record_read( _short_reads, shorts, key, record );
+      return record;
+   }
+
+   ocollateral_record dependency_tracking_state::get_collateral_record( const market_index_key& key )const
+   {
+      const ocollateral_record record = pending_chain_state::get_collateral_record( key );
+      detail::record_read( _collateral_reads, collateral, key, record );
+      return record;
+   }
+
+   vector<operation> dependency_tracking_state::get_recent_operations( operation_type_enum t )
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_recent_operations( t );
+   }
+
+   oobject_record dependency_tracking_state::get_object_record( const object_id_type& id )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_object_record( id );
+   }
+
+   osite_record dependency_tracking_state::lookup_site( const string& site_name )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::lookup_site( site_name );
+   }
+
+   oobject_record dependency_tracking_state::get_edge( const object_id_type& from, const object_id_type& to, const string& name )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_edge( from, to, name );
+   }
+
+   map<string, object_record> dependency_tracking_state::get_edges( const object_id_type& from, const object_id_type& to )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_edges( from, to );
+   }
+
+   map<object_id_type, map<string, object_record>> dependency_tracking_state::get_edges( const object_id_type& from )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_edges( from );
+   }
+
+   variant dependency_tracking_state::get_property( chain_property_enum property_id )const
+   {
+      const variant value = pending_chain_state::get_property( property_id );
+      detail::record_read( _property_reads, properties, property_id, value );
+      return value;
+   }
+
+   oslot_record dependency_tracking_state::get_slot_record( const time_point_sec& start_time )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_slot_record( start_time );
+   }
+
+   omarket_history_record dependency_tracking_state::get_market_history_record( const market_history_key& key )const
+   {
+      _untracked_reads = true;
+      return pending_chain_state::get_market_history_record( key );
+   }
+
+} } // bts::blockchain
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <bts/blockchain/block.hpp>
+#include <bts/blockchain/market_records.hpp>
+
+namespace bts { namespace blockchain {
+
+   class chain_interface;
+
+   /**
+    *  A bloom filter over every address a block touches, built when the block is applied, so that
+    *  a wallet can tell from a few bytes whether a block could involve any of its keys.
+    *
+    *  The addresses are the owners of every balance withdrawn from or deposited to, of every order
+    *  placed, covered or matched in the market, and the owner keys of every account registered or
+    *  updated. Titan memos can only be recognized by decrypting them, and some operations have no
+    *  owning address at all, so blocks containing either are flagged and must always be scanned.
+    */
+   struct block_filter
+   {
+      /** bits per address inserted, which gives a false positive rate of about 1% */
+      static const uint32_t bits_per_address = 10;
+      static const uint8_t  hash_count       = 7;
+
+      static block_filter build( const full_block& block, const vector<market_transaction>& market_transactions,
+                                 const chain_interface& chain );
+
+      /** false only if none of the addresses can be involved in the block */
+      bool may_involve( const unordered_set<address>& addresses )const;
+      bool may_contain( const address& addr )const;
+
+      void insert( const address& addr );
+
+      /** set if the block has titan memos or operations that cannot be filtered by address */
+      bool               match_all = false;
+      vector<char>       bits;
+   };
+   typedef optional<block_filter> oblock_filter;
+
+   /**
+    *  Appends the addresses trx involves, as they are inserted into a block_filter. Returns false if some
+    *  of its operations have titan memos or no owning address, the addresses of the others are still appended.
+    */
+   bool transaction_addresses( const signed_transaction& trx, const chain_interface& chain, vector<address>& addresses );
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::block_filter, (match_all)(bits) )
@@ -30,6 +30,63 @@ namespace bts { namespace blockchain {
    };
    typedef optional<transaction_record> otransaction_record;
 
+   /**
+    *  What the chain database keeps on disk for each transaction_record. The transaction itself is
+    *  already stored with its block, so only its location and the results of evaluating it are kept
+    *  and the rest of the transaction_record is read back from the block when it is fetched.
+    */
+   struct stored_transaction_record
+   {
+      stored_transaction_record(){}
+      explicit stored_transaction_record( const transaction_record& record )
+      :chain_location(record.chain_location),
+       expiration(record.trx.expiration),
+       deposits(record.deposits),
+       withdraws(record.withdraws),
+       yield(record.yield),
+       deltas(record.deltas),
+       required_fees(record.required_fees),
+       alt_fees_paid(record.alt_fees_paid),
+       balance(record.balance){}
+
+      transaction_location                       chain_location;
+      /** kept so the unique transaction index can be rebuilt without reading every block */
+      time_point_sec                             expiration;
+
+      unordered_map<asset_id_type, asset>        deposits;
+      unordered_map<asset_id_type, asset>        withdraws;
+      unordered_map<asset_id_type, share_type>   yield;
+      map<uint32_t, asset>                       deltas;
+      asset                                      required_fees;
+      asset                                      alt_fees_paid;
+      map<asset_id_type, share_type>             balance;
+   };
+
+   /** orders the transactions of an address by their place in the chain */
+   struct address_transaction_key
+   {
+      address        owner;
+      uint32_t       block_num = 0;
+      uint32_t       trx_num = 0;
+
+      friend bool operator < ( const address_transaction_key& a, const address_transaction_key& b )
+      {
+         return std::tie( a.owner, a.block_num, a.trx_num ) < std::tie( b.owner, b.block_num, b.trx_num );
+      }
+      friend bool operator == ( const address_transaction_key& a, const address_transaction_key& b )
+      {
+         return std::tie( a.owner, a.block_num, a.trx_num ) == std::tie( b.owner, b.block_num, b.trx_num );
+      }
+   };
+
+   /** one page of the transactions of an address */
+   struct address_transaction_page
+   {
+      vector<transaction_record>   transactions;
+      /** where the next page starts, unset after the last page */
+      otransaction_location        next;
+   };
+
    struct slot_record
    {
       slot_record(){} // Null case
@@ -60,6 +117,26 @@ FC_REFLECT_DERIVED( bts::blockchain::transaction_record,
                     (bts::blockchain::transaction_evaluation_state),
                     (chain_location) )
 
+FC_REFLECT( bts::blockchain::stored_transaction_record,
+            (chain_location)
+            (expiration)
+            (deposits)
+            (withdraws)
+            (yield)
+            (deltas)
+            (required_fees)
+            (alt_fees_paid)
+            (balance) )
+
+FC_REFLECT( bts::blockchain::address_transaction_key,
+            (owner)
+            (block_num)
+            (trx_num) )
+
+FC_REFLECT( bts::blockchain::address_transaction_page,
+            (transactions)
+            (next) )
+
 FC_REFLECT( bts::blockchain::slot_record,
             (start_time)
             (block_producer_id)
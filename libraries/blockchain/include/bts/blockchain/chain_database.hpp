@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bts/blockchain/block_filter.hpp>
 #include <bts/blockchain/chain_interface.hpp>
 #include <bts/blockchain/pending_chain_state.hpp>
 
@@ -69,6 +70,18 @@ namespace bts { namespace blockchain {
    };
    typedef fc::optional<fork_record> ofork_record;
 
+   /** the time spent in each stage of applying blocks, summed over every block applied */
+   struct block_stage_timings
+   {
+       uint32_t         blocks = 0;
+       fc::microseconds verify_header;
+       fc::microseconds pay_delegate;
+       fc::microseconds execute_markets;
+       fc::microseconds apply_transactions;
+       fc::microseconds save_undo_state;
+       fc::microseconds apply_changes;
+   };
+
    class chain_observer
    {
       public:
@@ -105,6 +118,9 @@ namespace bts { namespace blockchain {
          void set_relay_fee( share_type shares );
          share_type get_relay_fee();
 
+         /** bounds the pending transaction queue, a limit of 0 disables it */
+         void set_pending_transaction_limits( uint32_t max_count, uint64_t max_bytes, uint32_t max_per_signer );
+
          void sanity_check()const;
 
          time_point_sec get_genesis_timestamp()const;
@@ -118,6 +134,14 @@ namespace bts { namespace blockchain {
           */
          void skip_signature_verification( bool state );
 
+         /**
+          *  Every this many blocks a copy of the index is saved under data_dir/index_snapshots, written
+          *  on a background thread so block processing does not wait for it. If the
+          *  index is lost or damaged, open() restores the newest snapshot and replays only the blocks
+          *  after it instead of reindexing from genesis. Set to 0 to disable snapshots.
+          */
+         void set_index_snapshot_interval( uint32_t blocks );
+
          /**
           * The state of the blockchain after applying all pending transactions.
           */
@@ -134,6 +158,11 @@ namespace bts { namespace blockchain {
          vector<transaction_evaluation_state_ptr> get_pending_transactions()const;
          virtual bool                             is_known_transaction( const fc::time_point_sec& exp,
                                                                         const digest_type& trx_id )const override;
+         /**
+          *  True if a transaction that has not expired yet was included in the chain, answered from
+          *  memory so it is cheap enough to filter every advertised inventory item with.
+          */
+         bool                                     is_recent_transaction( const transaction_id_type& trx_id )const;
 
          /** Produce a block for the given timeslot, the block is not signed because that is the
           *  role of the wallet.
@@ -145,6 +174,14 @@ namespace bts { namespace blockchain {
                                                      share_type min_transaction_fee = BTS_BLOCKCHAIN_DEFAULT_RELAY_FEE,
                                                      const fc::microseconds& max_block_production_time = fc::seconds( 3 ) );
 
+         /**
+          *  Matches the dirty markets on top of pending_state with the current market engine, either in
+          *  parallel as blocks from BTS_V0_4_29_FORK_BLOCK_NUM do, or one market after another. Only meant
+          *  for checking that both give the same result.
+          */
+         void                        execute_markets( const time_point_sec& timestamp, const pending_chain_state_ptr& pending_state,
+                                                      bool parallel );
+
          /**
           *  The chain ID is the hash of the initial_config loaded when the
           *  database was first created.
@@ -170,8 +207,15 @@ namespace bts { namespace blockchain {
 
          optional<time_point_sec>    get_next_producible_block_timestamp( const vector<account_id_type>& delegate_ids )const;
 
-         virtual void                index_transaction( const address& addr, const transaction_id_type& trx_id ) override;
-         vector<transaction_record>  fetch_address_transactions( const address& addr );
+         /**
+          *  Up to limit transactions involving addr in chain order, starting at start (inclusive) or at the
+          *  oldest transaction, or newest first starting at start or at the newest transaction.
+          */
+         address_transaction_page    fetch_address_transactions( const address& addr,
+                                                                 const otransaction_location& start = otransaction_location(),
+                                                                 uint32_t limit = 100,
+                                                                 bool newest_first = false )const;
+         uint32_t                    count_address_transactions( const address& addr )const;
 
          uint32_t                    get_block_num( const block_id_type& )const;
          signed_block_header         get_block_header( const block_id_type& )const;
@@ -180,6 +224,10 @@ namespace bts { namespace blockchain {
          digest_block                get_block_digest( uint32_t block_num )const;
          full_block                  get_block( const block_id_type& )const;
          full_block                  get_block( uint32_t block_num )const;
+         /** the block exactly as it is stored, which is its fc::raw serialization */
+         std::vector<char>           get_packed_block( uint32_t block_num )const;
+         /** the address filter built when the block was applied, if the block has been applied since filters were added */
+         oblock_filter               get_block_filter( uint32_t block_num )const;
          vector<transaction_record>  get_transactions_for_block( const block_id_type& )const;
          signed_block_header         get_head_block()const;
          virtual uint32_t            get_head_block_num()const override;
@@ -353,6 +401,22 @@ namespace bts { namespace blockchain {
                                                                       const fc::microseconds& duration,
                                                                       market_history_key::time_granularity_enum granularity );
 
+         /** the finest granularity that covers duration in no more than max_points points */
+         static market_history_key::time_granularity_enum select_market_history_granularity( const fc::microseconds& duration,
+                                                                                             uint32_t max_points );
+         /** at most max_points points of the given granularity, 0 for no limit */
+         market_history_series              get_market_price_series( const asset_id_type& quote_id,
+                                                                     const asset_id_type& base_id,
+                                                                     const fc::time_point& start_time,
+                                                                     const fc::microseconds& duration,
+                                                                     uint32_t max_points,
+                                                                     market_history_key::time_granularity_enum granularity );
+         market_history_series              get_market_price_series( const asset_id_type& quote_id,
+                                                                     const asset_id_type& base_id,
+                                                                     const fc::time_point& start_time,
+                                                                     const fc::microseconds& duration,
+                                                                     uint32_t max_points );
+
          virtual void                       set_market_transactions( vector<market_transaction> trxs )override;
          vector<market_transaction>         get_market_transactions( uint32_t block_num  )const;
 
@@ -369,6 +433,9 @@ namespace bts { namespace blockchain {
 
          asset                              calculate_supply( const asset_id_type& asset_id )const;
          asset                              calculate_debt( const asset_id_type& asset_id, bool include_interest = false )const;
+         /** calculate_supply() and calculate_debt() recomputed by walking every record, to check the running totals */
+         asset                              scan_supply( const asset_id_type& asset_id )const;
+         asset                              scan_debt( const asset_id_type& asset_id )const;
          asset                              unclaimed_genesis();
 
          void                               dump_state( const fc::path& path )const;
@@ -382,6 +449,16 @@ namespace bts { namespace blockchain {
 
          void track_chain_statistics( bool status = true );
 
+         /**
+          *  Limits how many bytes of the largest state databases (balances, accounts, burns and
+          *  market history) are kept in memory in total; entries beyond that are loaded from disk on
+          *  demand. 0 keeps them fully in memory. Must be called before open().
+          */
+         void set_state_cache_size( size_t bytes );
+
+         block_stage_timings get_block_stage_timings()const;
+         void                reset_block_stage_timings();
+
       private:
          unique_ptr<detail::chain_database_impl> my;
    };
@@ -391,4 +468,5 @@ namespace bts { namespace blockchain {
 } } // bts::blockchain
 
 FC_REFLECT( bts::blockchain::block_fork_data, (next_blocks)(is_linked)(is_valid)(invalid_reason)(is_included)(is_known) )
+FC_REFLECT( bts::blockchain::block_stage_timings, (blocks)(verify_header)(pay_delegate)(execute_markets)(apply_transactions)(save_undo_state)(apply_changes) )
 FC_REFLECT( bts::blockchain::fork_record, (block_id)(signing_delegate)(transaction_count)(latency)(size)(timestamp)(is_valid)(invalid_reason)(is_current_fork) )
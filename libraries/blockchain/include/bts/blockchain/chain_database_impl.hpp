@@ -1,8 +1,14 @@
 #pragma once
 
+#include <bts/blockchain/block_filter.hpp>
 #include <bts/blockchain/chain_database.hpp>
+#include <bts/blockchain/dependency_tracking_state.hpp>
+#include <bts/blockchain/order_book.hpp>
+#include <bts/blockchain/pending_transaction_pool.hpp>
 #include <bts/db/cached_level_map.hpp>
+#include <bts/db/write_journal.hpp>
 #include <fc/thread/mutex.hpp>
+#include <fc/thread/thread.hpp>
 
 namespace bts { namespace blockchain {
 
@@ -23,29 +29,62 @@ namespace bts { namespace blockchain {
       }
    };
 
-   struct fee_index
+   /**
+    *  Running totals for an asset, kept up to date as records are stored so that calculate_supply()
+    *  and calculate_debt() do not have to walk every balance, order and position.
+    */
+   struct asset_supply_totals
    {
-      fee_index( share_type fees = 0, transaction_id_type trx = transaction_id_type() )
-      :_fees(fees),_trx(trx){}
-      share_type          _fees;
-      transaction_id_type _trx;
-      friend bool operator == ( const fee_index& a, const fee_index& b )
-      {
-         return a._fees == b._fees && a._trx == b._trx;
-      }
-      friend bool operator < ( const fee_index& a, const fee_index& b )
-      {
-         if( a._fees == b._fees ) return a._trx < b._trx; /* Lowest id wins in ties */
-         return a._fees > b._fees; /* Reverse so that highest fee is placed first in sorted maps */
-      }
+      /** everything calculate_supply() counts except the collected fees on the asset record */
+      share_type supply = 0;
+      /** the payoff balance of every collateral position */
+      share_type debt = 0;
    };
 
    namespace detail
    {
+      /**
+       *  The parts of a block that can be derived without any chain state. These are
+       *  computed ahead of time on worker threads and consumed by extend_chain().
+       */
+      struct prepared_block
+      {
+         block_id_type                               id;
+         optional<public_key_type>                   signee;
+         vector<optional<unordered_set<address>>>    trx_signees;
+      };
+
+      /**
+       *  A pending transaction together with the changes it made and the records it read, which
+       *  lets revalidate_pending() replay it instead of evaluating it again.
+       */
+      struct pending_trx_evaluation
+      {
+         digest_type                                 trx_digest;
+         uint32_t                                    head_block_num = 0;
+         transaction_evaluation_state_ptr            eval_state;
+         dependency_tracking_state_ptr               changes;
+      };
+
+      /**
+       *  Describes a copy of the index databases taken right after block_num was applied.
+       *  It is written last, so a snapshot directory without one is incomplete.
+       */
+      struct index_snapshot_info
+      {
+         uint32_t                                    block_num = 0;
+         block_id_type                               block_id;
+         uint32_t                                    database_version = 0;
+         fc::time_point_sec                          timestamp;
+      };
+
       class chain_database_impl
       {
          public:
             void                                        open_database(const fc::path& data_dir );
+            void                                        attach_write_journal();
+            bool                                        begin_block_writes();
+            void                                        commit_block_writes();
             void                                        clear_invalidation_of_future_blocks();
 
             digest_type                                 initialize_genesis( const optional<path>& genesis_file, bool chain_id_only = false );
@@ -60,6 +99,12 @@ namespace bts { namespace blockchain {
             void                                        mark_as_unchecked( const block_id_type& id );
             void                                        mark_included( const block_id_type& id, bool state );
             void                                        verify_header( const full_block&, const public_key_type& block_signee );
+            void                                        start_worker_threads();
+            void                                        run_on_worker_threads( size_t num_tasks,
+                                                                               const std::function<void( size_t )>& task );
+            prepared_block                              prepare_block( const full_block& block )const;
+            void                                        recover_transaction_signees( const block_id_type& block_id,
+                                                                                     const full_block& block );
             void                                        apply_transactions( const full_block& block,
                                                                             const pending_chain_state_ptr& );
             void                                        pay_delegate( const pending_chain_state_ptr& pending_state,
@@ -80,6 +125,8 @@ namespace bts { namespace blockchain {
 
             void                                        execute_markets(const fc::time_point_sec& timestamp, const pending_chain_state_ptr& pending_state );
             void                                        execute_markets_v1(const fc::time_point_sec& timestamp, const pending_chain_state_ptr& pending_state );
+            void                                        execute_markets_in_parallel( const fc::time_point_sec& timestamp,
+                                                                                     const pending_chain_state_ptr& pending_state );
             void                                        update_random_seed( const secret_hash_type& new_secret,
                                                                             const pending_chain_state_ptr& pending_state );
             void                                        update_active_delegate_list(const full_block& block_data,
@@ -91,9 +138,37 @@ namespace bts { namespace blockchain {
 
             void                                        revalidate_pending();
 
+            /** adds the user transactions of the head block to _address_to_trx_index, or removes them when it is popped */
+            void                                        index_address_transactions( const full_block& block, bool remove );
+
+            /** rebuilds the transaction_record for a stored_transaction_record from the block it was included in */
+            transaction_record                          load_transaction_record( const stored_transaction_record& record )const;
+            transaction_record                          load_transaction_record( const stored_transaction_record& record,
+                                                                                 const full_block& block )const;
+
+            /** recomputes the week or month record containing day_key from the each_day records */
+            void                                        update_market_history_rollup( const market_history_key& day_key,
+                                                                                      market_history_key::time_granularity_enum granularity );
+
+            void                                        adjust_supply_totals( const asset_id_type asset_id, const share_type supply_delta,
+                                                                              const share_type debt_delta = 0 );
+
+            bool                                        rebase_pending_evaluation( pending_trx_evaluation& evaluation );
+            void                                        add_pending_transaction( const transaction_evaluation_state_ptr& eval_state );
+
+            map<uint32_t, fc::path>                     list_index_snapshots()const;
+            void                                        start_index_snapshot();
+            void                                        wait_for_index_snapshot();
+            bool                                        restore_index_snapshot( const fc::path& data_dir );
+
             fc::future<void> _revalidate_pending;
             fc::mutex        _push_block_mutex;
 
+            /** worker threads used to recover block and transaction signers off the chain thread */
+            vector<std::unique_ptr<fc::thread>>                                         _worker_threads;
+            /** blocks about to be pushed whose signers have already been recovered */
+            unordered_map<block_id_type, prepared_block>                                _prepared_blocks;
+
             /**
              *  Used to track the cumulative effect of all pending transactions that are known,
              *  new incomming transactions are evaluated relative to this state.
@@ -102,7 +177,26 @@ namespace bts { namespace blockchain {
              *  pending transactions remain.
              */
             pending_chain_state_ptr                                                     _pending_trx_state;
+            /** every transaction applied to _pending_trx_state, in the order it was applied */
+            vector<pending_trx_evaluation>                                              _pending_evaluations;
+            /** set when an evicted transaction's changes are still in _pending_trx_state */
+            bool                                                                        _pending_state_stale = false;
+
 
+            block_stage_timings                                                         _block_stage_timings;
+
+            fc::path                                                                    _data_dir;
+
+            /** commits everything push_block writes to the index at once, so a process that dies mid-block never leaves half of it behind */
+            bts::db::write_journal                                                      _write_journal;
+            /** off while reindexing, which flushes its cached writes every 1000 blocks instead */
+            bool                                                                        _journal_block_writes = true;
+            /** how many blocks apart index snapshots are taken, 0 disables them */
+            uint32_t                                                                    _index_snapshot_interval = BTS_BLOCKCHAIN_INDEX_SNAPSHOT_INTERVAL;
+            /** set by extend_chain, the snapshot is started once push_block has committed the block */
+            bool                                                                        _index_snapshot_due = false;
+            std::unique_ptr<fc::thread>                                                 _index_snapshot_thread;
+            fc::future<void>                                                            _index_snapshot_done;
 
             chain_database*                                                             self = nullptr;
             unordered_set<chain_observer*>                                              _observers;
@@ -126,20 +220,31 @@ namespace bts { namespace blockchain {
             bts::db::level_map<block_id_type,block_record>                              _block_id_to_block_record_db;
 
             bts::db::level_map<block_id_type,full_block>                                _block_id_to_block_data_db;
+            /** the address filter of every block applied, see block_filter */
+            bts::db::level_map<block_id_type,block_filter>                              _block_id_to_block_filter_db;
 
             map<fc::time_point_sec, unordered_set<digest_type> >                        _unique_transactions;
-            bts::db::level_map<transaction_id_type,transaction_record>                  _id_to_transaction_record_db;
+            /** ids of the unexpired transactions in _unique_transactions, so has_item never reads the disk */
+            unordered_set<transaction_id_type>                                          _recent_transaction_ids;
+            map<fc::time_point_sec, vector<transaction_id_type> >                       _recent_transaction_expirations;
+            bts::db::level_map<transaction_id_type,stored_transaction_record>           _id_to_transaction_record_db;
+            /** the block read by the last load_transaction_record, lookups tend to come in runs from the same block */
+            mutable block_id_type                                                       _last_loaded_block_id;
+            mutable fc::optional<full_block>                                            _last_loaded_block;
 
             signed_block_header                                                         _head_block_header;
             block_id_type                                                               _head_block_id;
 
             bts::db::level_map<digest_type, signed_transaction>                         _pending_transaction_db;
-            std::map<fee_index, transaction_evaluation_state_ptr>                          _pending_fee_index;
+            pending_transaction_pool                                                    _pending_fee_index;
 
             bts::db::cached_level_map<asset_id_type, asset_record>                      _asset_db;
             bts::db::cached_level_map<string, asset_id_type>                            _symbol_index_db;
 
             bts::db::cached_level_map<balance_id_type, balance_record>                  _balance_db;
+            /** every address that owns each balance, int is unused, this is a set */
+            bts::db::level_map<pair<address,balance_id_type>, int>                      _owner_to_balance_index;
+            bts::db::cached_level_map<asset_id_type, asset_supply_totals>               _asset_supply_db;
 
             bts::db::cached_level_map<account_id_type, account_record>                  _account_db;
             bts::db::cached_level_map<string, account_id_type>                          _account_index_db;
@@ -160,6 +265,14 @@ namespace bts { namespace blockchain {
             set< expiration_index >                                                     _collateral_expiration_index; 
             bts::db::cached_level_map<feed_index, feed_record>                          _feed_db;
 
+            /** flat copies of the order databases above, kept in sync by the store_*_record methods for market_engine */
+            order_book<order_record>                                                    _bid_book;
+            order_book<order_record>                                                    _ask_book;
+            order_book<order_record>                                                    _relative_bid_book;
+            order_book<order_record>                                                    _relative_ask_book;
+            order_book<order_record>                                                    _short_book;
+            order_book<collateral_record>                                               _collateral_book;
+
 
             bts::db::level_map<object_id_type, object_record>                           _object_db;
             bts::db::level_map<edge_index_key, object_id_type/*edge id*/>               _edge_index;
@@ -171,7 +284,7 @@ namespace bts { namespace blockchain {
              *  This index is to facilitate light weight clients and is intended mostly for
              *  block explorers and other APIs serving data.
              */
-            bts::db::level_map< pair<address,transaction_id_type>, int>                 _address_to_trx_index;
+            bts::db::level_map< address_transaction_key, transaction_id_type>          _address_to_trx_index;
 
             bts::db::level_map<pair<asset_id_type,address>, object_id_type>             _auth_db;
             bts::db::level_map<pair<asset_id_type,proposal_id_type>, proposal_record>   _asset_proposal_db;
@@ -182,10 +295,13 @@ namespace bts { namespace blockchain {
             std::map<operation_type_enum, std::deque<operation>>                        _recent_operations;
 
             bool _track_stats = true;
+            /** memory limit for the lazily loaded state databases, 0 keeps them fully in memory */
+            size_t _state_cache_size = 0;
       };
   } // end namespace bts::blockchain::detail
 } } // end namespace bts::blockchain
 
 FC_REFLECT_TYPENAME( std::vector<bts::blockchain::block_id_type> )
 FC_REFLECT( bts::blockchain::vote_del, (votes)(delegate_id) )
-FC_REFLECT( bts::blockchain::fee_index, (_fees)(_trx) )
+FC_REFLECT( bts::blockchain::asset_supply_totals, (supply)(debt) )
+FC_REFLECT( bts::blockchain::detail::index_snapshot_info, (block_num)(block_id)(database_version)(timestamp) )
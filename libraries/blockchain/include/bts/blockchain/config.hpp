@@ -11,7 +11,7 @@
  *  @brief Defines global constants that determine blockchain behavior
  */
 #define BTS_BLOCKCHAIN_VERSION                              109
-#define BTS_BLOCKCHAIN_DATABASE_VERSION                     174
+#define BTS_BLOCKCHAIN_DATABASE_VERSION                     179
 
 /**
  *  The address prepended to string representation of
@@ -116,10 +116,24 @@
  */
 #define BTS_BLOCKCHAIN_BLOCKS_PER_YEAR                      (BTS_BLOCKCHAIN_BLOCKS_PER_DAY*int64_t(365))
 
+/**
+ *  How often a consistent copy of the index databases is saved so that recovering from an
+ *  unclean shutdown only has to replay the blocks applied since the newest snapshot
+ */
+#define BTS_BLOCKCHAIN_INDEX_SNAPSHOT_INTERVAL              uint32_t(BTS_BLOCKCHAIN_BLOCKS_PER_HOUR*6)
+#define BTS_BLOCKCHAIN_MAX_INDEX_SNAPSHOTS                  2
+
 #define BTS_BLOCKCHAIN_AVERAGE_TRX_SIZE                     512 // just a random assumption used to calibrate TRX per SEC
 #define BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND                   1  // (10)
 #define BTS_BLOCKCHAIN_MAX_PENDING_QUEUE_SIZE               10 // (BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC)
 
+/** default bounds of the pending transaction queue, the lowest fee per byte is evicted first */
+#define BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS             10000
+#define BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTION_BYTES        (uint64_t(32)*1024*1024)
+#define BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_SIGNER  100
+/** estimated bytes of evaluation state retained per pending transaction, charged against the byte bound */
+#define BTS_BLOCKCHAIN_PENDING_TRANSACTION_STATE_BYTES      4096
+
 /** defines the maximum block size allowed, 2 MB per hour */
 #define BTS_BLOCKCHAIN_MAX_BLOCK_SIZE                       (10 * BTS_BLOCKCHAIN_AVERAGE_TRX_SIZE * BTS_BLOCKCHAIN_MAX_PENDING_QUEUE_SIZE )
 
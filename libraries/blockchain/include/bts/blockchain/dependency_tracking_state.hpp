@@ -0,0 +1,106 @@
+#pragma once
+#include <bts/blockchain/pending_chain_state.hpp>
+
+namespace bts { namespace blockchain {
+
+   /**
+    *  A pending state that remembers every record it read from the state below it. If all of those
+    *  records still have the same value on top of a different previous state, evaluating the same
+    *  transaction there would make the same changes, so the changes can be replayed instead.
+    *
+    *  Reads of anything that is not tracked record by record mark the state as untracked, and an
+    *  untracked state can never be rebased.
+    *
+    *  Reads of now() and get_head_block_num() are recorded like records once track_chain_time()
+    *  is called. Whoever rebases must re-check the reads made before that itself.
+    */
+   class dependency_tracking_state : public pending_chain_state
+   {
+      public:
+                                        dependency_tracking_state( chain_interface_ptr prev_state = chain_interface_ptr() );
+
+         /** from now on, record reads of now() and get_head_block_num() */
+         void                           track_chain_time() { _track_chain_time = true; }
+
+         /** true if every recorded read returns the same record from the current previous state */
+         bool                           can_rebase()const;
+
+         /**
+          *  Moves writes to records whose totals are only ever adjusted by a delta on top of the
+          *  current previous state. Only valid after can_rebase() returned true.
+          */
+         void                           rebase_totals();
+
+         virtual fc::time_point_sec     now()const override;
+         virtual uint32_t               get_head_block_num()const override;
+         virtual fc::ripemd160          get_current_random_seed()const override;
+         virtual optional<object_id_type> get_authorization( asset_id_type asset_id, const address& owner )const override;
+         virtual ofeed_record           get_feed( const feed_index& )const override;
+         virtual oprice                 get_median_delegate_price( const asset_id_type& quote_id,
+                                                                   const asset_id_type& base_id )const override;
+         virtual optional<proposal_record> fetch_asset_proposal( asset_id_type asset_id, proposal_id_type proposal_id )const override;
+         virtual oburn_record           fetch_burn_record( const burn_record_key& key )const override;
+
+         virtual oasset_record          get_asset_record( const asset_id_type& id )const override;
+         virtual oasset_record          get_asset_record( const string& symbol )const override;
+         virtual obalance_record        get_balance_record( const balance_id_type& id )const override;
+         virtual oaccount_record        get_account_record( const account_id_type& id )const override;
+         virtual oaccount_record        get_account_record( const address& owner )const override;
+         virtual oaccount_record        get_account_record( const string& name )const override;
+
+         virtual odelegate_slate        get_delegate_slate( slate_id_type id )const override;
+
+         virtual bool                   is_known_transaction( const fc::time_point_sec& exp, const digest_type& trx_id )const override;
+         virtual otransaction_record    get_transaction( const transaction_id_type& trx_id, bool exact = true )const override;
+
+         virtual omarket_status         get_market_status( const asset_id_type& quote_id, const asset_id_type& base_id )override;
+         virtual omarket_order          get_lowest_ask_record( const asset_id_type& quote_id,
+                                                               const asset_id_type& base_id )override;
+         virtual oorder_record          get_bid_record( const market_index_key& )const override;
+         virtual oorder_record          get_ask_record( const market_index_key& )const override;
+         virtual oorder_record          get_relative_bid_record( const market_index_key& )const override;
+         virtual oorder_record          get_relative_ask_record( const market_index_key& )const override;
+         virtual oorder_record          get_short_record( const market_index_key& )const override;
+         virtual ocollateral_record     get_collateral_record( const market_index_key& )const override;
+
+         virtual vector<operation>      get_recent_operations( operation_type_enum t )override;
+         virtual oobject_record         get_object_record( const object_id_type& id )const override;
+         virtual osite_record           lookup_site( const string& site_name )const override;
+         virtual oobject_record         get_edge( const object_id_type& from,
+                                                  const object_id_type& to,
+                                                  const string& name )const override;
+         virtual map<string, object_record> get_edges( const object_id_type& from,
+                                                       const object_id_type& to )const override;
+         virtual map<object_id_type, map<string, object_record>>
+                                        get_edges( const object_id_type& from )const override;
+
+         virtual variant                get_property( chain_property_enum property_id )const override;
+         virtual oslot_record           get_slot_record( const time_point_sec& start_time )const override;
+         virtual omarket_history_record get_market_history_record( const market_history_key& key )const override;
+
+      private:
+         mutable unordered_map<asset_id_type, oasset_record>                      _asset_reads;
+         mutable unordered_map<string, oasset_record>                             _asset_symbol_reads;
+         mutable unordered_map<balance_id_type, obalance_record>                  _balance_reads;
+         mutable unordered_map<account_id_type, oaccount_record>                  _account_reads;
+         mutable unordered_map<address, oaccount_record>                          _account_address_reads;
+         mutable unordered_map<string, oaccount_record>                           _account_name_reads;
+         mutable unordered_map<slate_id_type, odelegate_slate>                    _slate_reads;
+         mutable unordered_map<digest_type, std::pair<time_point_sec, bool>>      _known_transaction_reads;
+         mutable map<std::pair<asset_id_type, asset_id_type>, omarket_status>     _market_status_reads;
+         mutable map<market_index_key, oorder_record>                             _bid_reads;
+         mutable map<market_index_key, oorder_record>                             _ask_reads;
+         mutable map<market_index_key, oorder_record>                             _relative_bid_reads;
+         mutable map<market_index_key, oorder_record>                             _relative_ask_reads;
+         mutable map<market_index_key, oorder_record>                             _short_reads;
+         mutable map<market_index_key, ocollateral_record>                        _collateral_reads;
+         mutable map<chain_property_enum, variant>                                _property_reads;
+         mutable optional<fc::time_point_sec>                                     _now_read;
+         mutable optional<uint32_t>                                               _head_block_num_read;
+         bool                                                                     _track_chain_time = false;
+         mutable bool                                                             _untracked_reads = false;
+   };
+
+   typedef std::shared_ptr<dependency_tracking_state> dependency_tracking_state_ptr;
+
+} } // bts::blockchain
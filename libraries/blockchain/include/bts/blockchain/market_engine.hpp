@@ -2,6 +2,16 @@
 
 namespace bts { namespace blockchain { namespace detail {
 
+  /**
+   *  The values, from before any market was applied, of the records that markets executed in parallel
+   *  may share. Only asset records and balances can be written by more than one market.
+   */
+  struct market_merge_state
+  {
+    unordered_map<asset_id_type, oasset_record>       assets;
+    unordered_map<balance_id_type, obalance_record>   balances;
+  };
+
   class market_engine
   {
   public:
@@ -9,6 +19,25 @@ namespace bts { namespace blockchain { namespace detail {
     /** return true if execute was successful and applied */
     bool execute( asset_id_type quote_id, asset_id_type base_id, const fc::time_point_sec& timestamp );
 
+    /**
+     *  Matches the market without touching the prior state, so that independent markets can be
+     *  evaluated concurrently. Returns true if matching succeeded; apply() commits the result.
+     */
+    bool evaluate( asset_id_type quote_id, asset_id_type base_id, const fc::time_point_sec& timestamp );
+
+    /**
+     *  Applies the matched changes, or the error that stopped matching, to the prior state. If given,
+     *  merge_state remembers the previous values of any shared records written for the first time.
+     */
+    void apply( market_merge_state* merge_state = nullptr );
+
+    /**
+     *  Adjusts the changes from evaluate() for the markets applied to the prior state since this
+     *  engine was created. Returns false if the changes cannot be reconciled, in which case the
+     *  market has to be evaluated again against the current prior state.
+     */
+    bool rebase( const market_merge_state& merge_state );
+
     void cancel_all_shorts();
 
     static asset get_interest_paid(const asset& total_amount_paid, const price& apr, uint32_t age_seconds);
@@ -67,17 +96,18 @@ namespace bts { namespace blockchain { namespace detail {
     oprice                        _feed_price;
 
     int                           _orders_filled = 0;
+    optional<fc::exception>       _error;
 
   public:
     vector<market_transaction>    _market_transactions;
 
   private:
-    bts::db::cached_level_map< market_index_key, order_record >::iterator         _bid_itr;
-    bts::db::cached_level_map< market_index_key, order_record >::iterator         _ask_itr;
-    bts::db::cached_level_map< market_index_key, order_record >::iterator         _relative_bid_itr;
-    bts::db::cached_level_map< market_index_key, order_record >::iterator         _relative_ask_itr;
-    bts::db::cached_level_map< market_index_key, order_record >::iterator         _short_itr;
-    bts::db::cached_level_map< market_index_key, collateral_record >::iterator    _collateral_itr;
+    order_book< order_record >::cursor                       _bid_itr;
+    order_book< order_record >::cursor                       _ask_itr;
+    order_book< order_record >::cursor                       _relative_bid_itr;
+    order_book< order_record >::cursor                       _relative_ask_itr;
+    order_book< order_record >::cursor                       _short_itr;
+    order_book< collateral_record >::cursor                  _collateral_itr;
     std::set< expiration_index >::iterator                   _collateral_expiration_itr;
   };
 
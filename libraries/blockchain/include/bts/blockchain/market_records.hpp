@@ -53,7 +53,9 @@ namespace bts { namespace blockchain {
        enum time_granularity_enum {
          each_block,
          each_hour,
-         each_day
+         each_day,
+         each_week, ///< rolled up from each_day, weeks start on Monday
+         each_month ///< rolled up from each_day, months start on the 1st
        };
 
        market_history_key( asset_id_type quote_id = 0,
@@ -124,6 +126,21 @@ namespace bts { namespace blockchain {
    };
    typedef vector<market_history_point> market_history_points;
 
+   /**
+    *  The same points as market_history_points stored column by column, which avoids repeating
+    *  every field name for each point when the history is serialized.
+    */
+   struct market_history_series
+   {
+       market_history_key::time_granularity_enum granularity = market_history_key::each_block;
+       vector<uint32_t>   timestamps; ///< seconds since epoch
+       vector<double>     highest_bid;
+       vector<double>     lowest_ask;
+       vector<double>     opening_price;
+       vector<double>     closing_price;
+       vector<share_type> volume;
+   };
+
    struct order_record
    {
       order_record():balance(0){}
@@ -294,13 +311,14 @@ FC_REFLECT_ENUM( bts::blockchain::order_type_enum,
                  (relative_ask_order)
                )
 
-FC_REFLECT_ENUM( bts::blockchain::market_history_key::time_granularity_enum, (each_block)(each_hour)(each_day) )
+FC_REFLECT_ENUM( bts::blockchain::market_history_key::time_granularity_enum, (each_block)(each_hour)(each_day)(each_week)(each_month) )
 FC_REFLECT( bts::blockchain::market_status, (quote_id)(base_id)(current_feed_price)(last_valid_feed_price)(last_error)(ask_depth)(bid_depth)(center_price) )
 FC_REFLECT_DERIVED( bts::blockchain::api_market_status, (bts::blockchain::market_status), (current_feed_price)(last_valid_feed_price) )
 FC_REFLECT( bts::blockchain::market_index_key, (order_price)(owner) )
 FC_REFLECT( bts::blockchain::market_history_record, (highest_bid)(lowest_ask)(opening_price)(closing_price)(volume) )
 FC_REFLECT( bts::blockchain::market_history_key, (quote_id)(base_id)(granularity)(timestamp) )
 FC_REFLECT( bts::blockchain::market_history_point, (timestamp)(highest_bid)(lowest_ask)(opening_price)(closing_price)(volume) )
+FC_REFLECT( bts::blockchain::market_history_series, (granularity)(timestamps)(highest_bid)(lowest_ask)(opening_price)(closing_price)(volume) )
 FC_REFLECT( bts::blockchain::order_record, (balance)(limit_price)(last_update) )
 FC_REFLECT( bts::blockchain::collateral_record, (collateral_balance)(payoff_balance)(interest_rate)(expiration) )
 FC_REFLECT( bts::blockchain::market_order, (type)(market_index)(state)(collateral)(interest_rate)(expiration) )
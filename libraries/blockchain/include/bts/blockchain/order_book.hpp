@@ -0,0 +1,111 @@
+#pragma once
+
+#include <bts/blockchain/market_records.hpp>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace bts { namespace blockchain {
+
+   /**
+    *  An in-memory copy of one order database, split by market. Each market's orders are kept in
+    *  a contiguous vector sorted by market_index_key, so market execution can walk them without
+    *  tree lookups and read them without copying.
+    *
+    *  Cursors point into a market's vector and are invalidated by store() and remove(), which
+    *  chain_database only calls when applying changes, never during market execution.
+    */
+   template<typename RecordType>
+   class order_book
+   {
+      public:
+         typedef std::pair<market_index_key, RecordType>     entry_type;
+         typedef std::vector<entry_type>                     market_orders;
+
+         class cursor
+         {
+            public:
+               cursor(){}
+
+               /** stepping off either end of the market leaves the cursor invalid */
+               bool valid()const { return _orders != nullptr && _index < _orders->size(); }
+
+               const market_index_key& key()const   { return (*_orders)[ _index ].first; }
+               const RecordType&       value()const { return (*_orders)[ _index ].second; }
+
+               cursor& operator++() { ++_index; return *this; }
+               cursor& operator--() { --_index; return *this; }
+
+               void reset() { _orders = nullptr; }
+
+            private:
+               friend class order_book;
+               cursor( const market_orders* orders, size_t index )
+               :_orders(orders),_index(index){}
+
+               const market_orders*  _orders = nullptr;
+               size_t                _index = 0;
+         };
+
+         void store( const market_index_key& key, const RecordType& record )
+         {
+            auto& orders = _markets[ key.order_price.asset_pair() ];
+            auto itr = std::lower_bound( orders.begin(), orders.end(), key, entry_less() );
+            if( itr != orders.end() && itr->first == key )
+               itr->second = record;
+            else
+               orders.emplace( itr, key, record );
+         }
+
+         void remove( const market_index_key& key )
+         {
+            auto market_itr = _markets.find( key.order_price.asset_pair() );
+            if( market_itr == _markets.end() )
+               return;
+
+            auto& orders = market_itr->second;
+            auto itr = std::lower_bound( orders.begin(), orders.end(), key, entry_less() );
+            if( itr != orders.end() && itr->first == key )
+               orders.erase( itr );
+
+            if( orders.empty() )
+               _markets.erase( market_itr );
+         }
+
+         void clear()
+         {
+            _markets.clear();
+         }
+
+         /** the lowest priced order in the market */
+         cursor first( asset_id_type quote_id, asset_id_type base_id )const
+         {
+            const auto market_itr = _markets.find( std::make_pair( quote_id, base_id ) );
+            if( market_itr == _markets.end() )
+               return cursor();
+            return cursor( &market_itr->second, 0 );
+         }
+
+         /** the highest priced order in the market */
+         cursor last( asset_id_type quote_id, asset_id_type base_id )const
+         {
+            const auto market_itr = _markets.find( std::make_pair( quote_id, base_id ) );
+            if( market_itr == _markets.end() )
+               return cursor();
+            return cursor( &market_itr->second, market_itr->second.size() - 1 );
+         }
+
+      private:
+         struct entry_less
+         {
+            bool operator()( const entry_type& entry, const market_index_key& key )const
+            {
+               return entry.first < key;
+            }
+         };
+
+         std::map<std::pair<asset_id_type, asset_id_type>, market_orders>   _markets;
+   };
+
+} } // bts::blockchain
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <bts/blockchain/config.hpp>
+#include <bts/blockchain/transaction_evaluation_state.hpp>
+#include <fc/uint128.hpp>
+
+#include <map>
+
+namespace bts { namespace blockchain {
+
+   struct fee_index
+   {
+      fee_index( share_type fees = 0, transaction_id_type trx = transaction_id_type(), uint32_t size = 1 )
+      :_fees(fees),_trx(trx),_size(std::max<uint32_t>(size, 1)){}
+      share_type          _fees;
+      transaction_id_type _trx;
+      uint32_t            _size;
+      friend bool operator == ( const fee_index& a, const fee_index& b )
+      {
+         return a._fees == b._fees && a._trx == b._trx && a._size == b._size;
+      }
+      friend bool operator < ( const fee_index& a, const fee_index& b )
+      {
+         /* Compare fees per byte by cross multiplying so that no precision is lost */
+         const fc::uint128 a_rate = fc::uint128( uint64_t( std::max<share_type>( a._fees, 0 ) ) ) * fc::uint128( b._size );
+         const fc::uint128 b_rate = fc::uint128( uint64_t( std::max<share_type>( b._fees, 0 ) ) ) * fc::uint128( a._size );
+         if( a_rate == b_rate ) return a._trx < b._trx; /* Lowest id wins in ties */
+         return a_rate > b_rate; /* Reverse so that highest fee per byte is placed first in sorted maps */
+      }
+   };
+
+   /**
+    *  The evaluated pending transactions, ordered by fee per byte. The pool is bounded by a
+    *  transaction count, a total size and a count per signing address; when it is full a new
+    *  transaction is only admitted if it pays more per byte than the entries it evicts.
+    *
+    *  Every entry also keeps its evaluation state and the changes it made alive, so the total size
+    *  charges each entry BTS_BLOCKCHAIN_PENDING_TRANSACTION_STATE_BYTES on top of its packed size.
+    *  The fee per byte is still computed from the packed size alone.
+    *
+    *  A limit of 0 disables that limit.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         typedef std::map<fee_index, transaction_evaluation_state_ptr> index_type;
+
+         void        set_limits( uint32_t max_count, uint64_t max_bytes, uint32_t max_per_signer );
+
+         /** throws if a transaction with these fees, size and signers would not be admitted */
+         void        check_admission( share_type fees, uint32_t size, const unordered_set<address>& signers )const;
+
+         /**
+          *  Adds an evaluated transaction, evicting the lowest paying entries to make room.
+          *  @return the evicted transactions
+          */
+         vector<transaction_evaluation_state_ptr> insert( const transaction_evaluation_state_ptr& eval_state,
+                                                          share_type fees, uint32_t size );
+
+         void        clear();
+
+         const index_type& index()const { return _index; }
+         size_t      size()const        { return _index.size(); }
+         uint64_t    bytes()const       { return _bytes; }
+
+      private:
+         /** the entries that would have to be evicted to admit key, or false if key does not outbid them */
+         bool        find_evictions( const fee_index& key, vector<index_type::const_iterator>& evictions )const;
+         void        remove( index_type::const_iterator itr );
+         static uint64_t charged_bytes( uint32_t size ) { return uint64_t( size ) + BTS_BLOCKCHAIN_PENDING_TRANSACTION_STATE_BYTES; }
+
+         index_type                          _index;
+         uint64_t                            _bytes = 0;
+         unordered_map<address, uint32_t>    _signer_counts;
+
+         uint32_t                            _max_count = 0;
+         uint64_t                            _max_bytes = 0;
+         uint32_t                            _max_per_signer = 0;
+   };
+
+} } // bts::blockchain
+
+FC_REFLECT( bts::blockchain::fee_index, (_fees)(_trx)(_size) )
@@ -176,6 +176,14 @@ namespace bts { namespace blockchain {
       size_t                                  data_size()const;
       void                                    sign( const fc::ecc::private_key& signer, const digest_type& chain_id );
 
+      /**
+       *  Recovers the key behind every signature and returns each address form
+       *  (native and legacy PTS) that the signature authorizes. This is the
+       *  expensive part of evaluation and does not depend on chain state.
+       */
+      unordered_set<address>                  get_signed_addresses( const digest_type& chain_id,
+                                                                    bool enforce_canonical = true )const;
+
       vector<fc::ecc::compact_signature> signatures;
    };
    typedef vector<signed_transaction> signed_transactions;
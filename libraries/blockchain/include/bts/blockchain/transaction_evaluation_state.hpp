@@ -32,6 +32,10 @@ namespace bts { namespace blockchain {
          share_type get_alt_fees()const;
 
          virtual void evaluate( const signed_transaction& trx, bool skip_signature_check = false, bool enforce_canonical = true );
+
+         /** the expiration and duplicate checks evaluate() starts with, which need no state of their own */
+         static void check_expiration_and_uniqueness( const chain_interface& state, const signed_transaction& trx,
+                                                      const digest_type& chain_id );
          virtual void evaluate_operation( const operation& op );
          virtual bool verify_authority( const multisig_meta_info& siginfo );
 
@@ -67,6 +71,12 @@ namespace bts { namespace blockchain {
 
          void validate_asset( const asset& a )const;
 
+         /**
+          *  Supplies signer addresses that were recovered ahead of time (usually on a
+          *  worker thread) so that evaluate() does not need to recover them again.
+          */
+         void set_signed_keys( unordered_set<address> keys );
+
          signed_transaction                         trx;
          uint32_t                                   current_op_index = 0;
 
@@ -118,6 +128,7 @@ namespace bts { namespace blockchain {
          chain_interface*                           _current_state;
          digest_type                                _chain_id;
          bool                                       _skip_signature_check = false;
+         bool                                       _signed_keys_precomputed = false;
    };
    typedef shared_ptr<transaction_evaluation_state> transaction_evaluation_state_ptr;
 
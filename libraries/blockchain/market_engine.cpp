@@ -33,6 +33,13 @@ namespace bts { namespace blockchain { namespace detail {
   }
 
   bool market_engine::execute( asset_id_type quote_id, asset_id_type base_id, const fc::time_point_sec& timestamp )
+  {
+      const bool success = evaluate( quote_id, base_id, timestamp );
+      apply();
+      return success;
+  }
+
+  bool market_engine::evaluate( asset_id_type quote_id, asset_id_type base_id, const fc::time_point_sec& timestamp )
   {
       try
       {
@@ -46,15 +53,14 @@ namespace bts { namespace blockchain { namespace detail {
           FC_ASSERT( !quote_asset->is_market_frozen() );
           FC_ASSERT( !base_asset->is_market_frozen() );
 
-          // The order book is sorted from low to high price. So to get the last item (highest bid),
-          // we need to go to the first item in the next market class and then back up one
-          const price next_pair = (base_id+1 == quote_id) ? price( 0, quote_id+1, 0 ) : price( 0, quote_id, base_id+1 );
-          _bid_itr           = _db_impl._bid_db.lower_bound( market_index_key( next_pair ) );
-          _ask_itr           = _db_impl._ask_db.lower_bound( market_index_key( price( 0, quote_id, base_id) ) );
-          _relative_bid_itr  = _db_impl._relative_bid_db.lower_bound( market_index_key( next_pair ) );
-          _relative_ask_itr  = _db_impl._relative_ask_db.lower_bound( market_index_key( price( 0, quote_id, base_id) ) );
-          _short_itr         = _db_impl._short_db.lower_bound( market_index_key( next_pair ) );
-          _collateral_itr    = _db_impl._collateral_db.lower_bound( market_index_key( next_pair ) );
+          // The order books are sorted from low to high price, so bids are walked down from the
+          // last item (highest bid) and asks up from the first item (lowest ask)
+          _bid_itr           = _db_impl._bid_book.last( quote_id, base_id );
+          _ask_itr           = _db_impl._ask_book.first( quote_id, base_id );
+          _relative_bid_itr  = _db_impl._relative_bid_book.last( quote_id, base_id );
+          _relative_ask_itr  = _db_impl._relative_ask_book.first( quote_id, base_id );
+          _short_itr         = _db_impl._short_book.last( quote_id, base_id );
+          _collateral_itr    = _db_impl._collateral_book.last( quote_id, base_id );
 
           _collateral_expiration_itr  = _db_impl._collateral_expiration_index.lower_bound( { quote_id, time_point(), market_index_key( price(0,quote_id,base_id) ) } );
 
@@ -62,21 +68,6 @@ namespace bts { namespace blockchain { namespace detail {
           asset trading_volume(0, base_id);
           price opening_price, closing_price;
 
-          if( !_ask_itr.valid() ) _ask_itr = _db_impl._ask_db.begin();
-          if( !_relative_ask_itr.valid() ) _relative_ask_itr = _db_impl._relative_ask_db.begin();
-
-          if( _bid_itr.valid() )   --_bid_itr;
-          else _bid_itr = _db_impl._bid_db.last();
-
-          if( _relative_bid_itr.valid() )   --_relative_bid_itr;
-          else _relative_bid_itr = _db_impl._relative_bid_db.last();
-
-          if( _collateral_itr.valid() )   --_collateral_itr;
-          else _collateral_itr = _db_impl._collateral_db.last();
-
-          if( _short_itr.valid() )   --_short_itr;
-          else _short_itr = _db_impl._short_db.last();
-
           _feed_price = _db_impl.self->get_median_delegate_price( _quote_id, _base_id );
 
           // Market issued assets cannot match until the first time there is a median feed; assume feed price base id 0
@@ -328,20 +319,120 @@ namespace bts { namespace blockchain { namespace detail {
           wlog( "done matching orders" );
           idump( (_current_bid)(_current_ask) );
 
-          _pending_state->apply_changes();
           return true;
     }
     catch( const fc::exception& e )
     {
         wlog( "error executing market ${quote} / ${base}\n ${e}", ("quote",quote_id)("base",base_id)("e",e.to_detail_string()) );
-        omarket_status market_stat = _prior_state->get_market_status( _quote_id, _base_id );
-        if( !market_stat.valid() ) market_stat = market_status( _quote_id, _base_id );
-        market_stat->update_feed_price( _feed_price );
-        market_stat->last_error = e;
-        _prior_state->store_market_status( *market_stat );
+        _error = e;
     }
     return false;
-  } // execute(...)
+  } // evaluate(...)
+
+  void market_engine::apply( market_merge_state* merge_state )
+  {
+      if( !_error.valid() )
+      {
+          if( merge_state != nullptr )
+          {
+              for( const auto& item : _pending_state->assets )
+              {
+                  if( merge_state->assets.find( item.first ) == merge_state->assets.end() )
+                      merge_state->assets[ item.first ] = _prior_state->get_asset_record( item.first );
+              }
+              for( const auto& item : _pending_state->balances )
+              {
+                  if( merge_state->balances.find( item.first ) == merge_state->balances.end() )
+                      merge_state->balances[ item.first ] = _prior_state->get_balance_record( item.first );
+              }
+          }
+
+          _pending_state->apply_changes();
+          return;
+      }
+
+      omarket_status market_stat = _prior_state->get_market_status( _quote_id, _base_id );
+      if( !market_stat.valid() ) market_stat = market_status( _quote_id, _base_id );
+      market_stat->update_feed_price( _feed_price );
+      market_stat->last_error = *_error;
+      _prior_state->store_market_status( *market_stat );
+  }
+
+  bool market_engine::rebase( const market_merge_state& merge_state )
+  { try {
+      if( _error.valid() )
+          return true;
+
+      // Matching only ever reads records that it also writes, and everything except asset records and
+      // balances is specific to this market, so no other market can have changed what this one saw.
+      const auto market_pair = std::make_pair( _quote_id, _base_id );
+      const pending_chain_state& changes = *_pending_state;
+      if( !changes.properties.empty() || !changes.accounts.empty() || !changes.authorizations.empty()
+          || !changes.transactions.empty() || !changes.slates.empty() || !changes.slots.empty()
+          || !changes.asset_proposals.empty() || !changes.feeds.empty() || !changes.recent_operations.empty()
+          || !changes.burns.empty() || !changes.objects.empty() )
+          return false;
+
+      for( const auto& item : changes.bids )          if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.asks )          if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.relative_bids ) if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.relative_asks ) if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.shorts )        if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.collateral )    if( item.first.order_price.asset_pair() != market_pair ) return false;
+      for( const auto& item : changes.market_statuses ) if( item.first != market_pair ) return false;
+      for( const auto& item : changes.market_history )
+          if( item.first.quote_id != _quote_id || item.first.base_id != _base_id ) return false;
+
+      // Matching only adds to asset supplies and fees and to balances, so if another market already
+      // changed one of those records, apply our difference on top of its result
+      for( auto& item : _pending_state->assets )
+      {
+          const auto original_itr = merge_state.assets.find( item.first );
+          if( original_itr == merge_state.assets.end() )
+              continue;
+
+          const oasset_record& original = original_itr->second;
+          const oasset_record current = _prior_state->get_asset_record( item.first );
+          if( !original.valid() || !current.valid() )
+              return false;
+
+          asset_record merged = item.second;
+          merged.current_share_supply = current->current_share_supply;
+          merged.collected_fees = current->collected_fees;
+          if( fc::raw::pack( merged ) != fc::raw::pack( *current ) )
+              return false;
+
+          merged.current_share_supply += item.second.current_share_supply - original->current_share_supply;
+          merged.collected_fees += item.second.collected_fees - original->collected_fees;
+          item.second = merged;
+      }
+
+      for( auto& item : _pending_state->balances )
+      {
+          const auto original_itr = merge_state.balances.find( item.first );
+          if( original_itr == merge_state.balances.end() )
+              continue;
+
+          const obalance_record& original = original_itr->second;
+          const obalance_record current = _prior_state->get_balance_record( item.first );
+          if( !current.valid() )
+              return false;
+
+          balance_record merged = item.second;
+          merged.balance = current->balance;
+          merged.deposit_date = current->deposit_date;
+          merged.last_update = current->last_update;
+          if( fc::raw::pack( merged ) != fc::raw::pack( *current ) )
+              return false;
+
+          merged.balance += item.second.balance - (original.valid() ? original->balance : 0);
+          merged.deposit_date = item.second.deposit_date;
+          merged.last_update = item.second.last_update;
+          item.second = merged;
+      }
+
+      return true;
+  } FC_CAPTURE_AND_RETHROW( (_quote_id)(_base_id) ) }
 
   void market_engine::push_market_transaction( const market_transaction& mtrx )
   { try {
@@ -736,10 +736,4 @@ namespace bts { namespace blockchain {
       return prev_state->fetch_asset_proposal( asset_id, proposal_id );
    }
 
-   void    pending_chain_state::index_transaction( const address& addr, const transaction_id_type& trx_id )
-   {
-      chain_interface_ptr prev_state = _prev_state.lock();
-      prev_state->index_transaction( addr, trx_id );
-   }
-
 } } // bts::blockchain
@@ -0,0 +1,106 @@
+#include <bts/blockchain/exceptions.hpp>
+#include <bts/blockchain/pending_transaction_pool.hpp>
+
+namespace bts { namespace blockchain {
+
+   void pending_transaction_pool::set_limits( uint32_t max_count, uint64_t max_bytes, uint32_t max_per_signer )
+   {
+      _max_count = max_count;
+      _max_bytes = max_bytes;
+      _max_per_signer = max_per_signer;
+   }
+
+   void pending_transaction_pool::check_admission( share_type fees, uint32_t size, const unordered_set<address>& signers )const
+   { try {
+      if( _max_bytes != 0 && charged_bytes( size ) > _max_bytes )
+         FC_CAPTURE_AND_THROW( pending_queue_full, (size)(_max_bytes) );
+
+      if( _max_per_signer != 0 )
+      {
+         for( const address& signer : signers )
+         {
+            const auto itr = _signer_counts.find( signer );
+            if( itr != _signer_counts.end() && itr->second >= _max_per_signer )
+               FC_CAPTURE_AND_THROW( pending_queue_full, (signer)(_max_per_signer) );
+         }
+      }
+
+      vector<index_type::const_iterator> evictions;
+      if( !find_evictions( fee_index( fees, transaction_id_type(), size ), evictions ) )
+      {
+         const fee_index lowest = _index.empty() ? fee_index() : _index.rbegin()->first;
+         FC_CAPTURE_AND_THROW( pending_queue_full, (fees)(size)("lowest_fees",lowest._fees)("lowest_size",lowest._size) );
+      }
+   } FC_CAPTURE_AND_RETHROW( (fees)(size) ) }
+
+   vector<transaction_evaluation_state_ptr> pending_transaction_pool::insert( const transaction_evaluation_state_ptr& eval_state,
+                                                                              share_type fees, uint32_t size )
+   {
+      const fee_index key( fees, eval_state->trx.id(), size );
+
+      const auto existing = _index.find( key );
+      if( existing != _index.end() )
+         remove( existing );
+
+      vector<index_type::const_iterator> evictions;
+      find_evictions( key, evictions );
+
+      vector<transaction_evaluation_state_ptr> evicted;
+      evicted.reserve( evictions.size() );
+      for( const auto& itr : evictions )
+      {
+         evicted.push_back( itr->second );
+         remove( itr );
+      }
+
+      _index[ key ] = eval_state;
+      _bytes += charged_bytes( key._size );
+      for( const address& signer : eval_state->signed_keys )
+         ++_signer_counts[ signer ];
+
+      return evicted;
+   }
+
+   void pending_transaction_pool::clear()
+   {
+      _index.clear();
+      _bytes = 0;
+      _signer_counts.clear();
+   }
+
+   bool pending_transaction_pool::find_evictions( const fee_index& key, vector<index_type::const_iterator>& evictions )const
+   {
+      size_t   count = _index.size() + 1;
+      uint64_t bytes = _bytes + charged_bytes( key._size );
+
+      auto itr = _index.end();
+      while( (_max_count != 0 && count > _max_count) || (_max_bytes != 0 && bytes > _max_bytes) )
+      {
+         if( itr == _index.begin() )
+            return false;
+         --itr;
+
+         /* only entries paying strictly less per byte can be evicted */
+         if( !(key < itr->first) )
+            return false;
+
+         evictions.push_back( itr );
+         --count;
+         bytes -= charged_bytes( itr->first._size );
+      }
+      return true;
+   }
+
+   void pending_transaction_pool::remove( index_type::const_iterator itr )
+   {
+      _bytes -= charged_bytes( itr->first._size );
+      for( const address& signer : itr->second->signed_keys )
+      {
+         auto count_itr = _signer_counts.find( signer );
+         if( count_itr != _signer_counts.end() && --count_itr->second == 0 )
+            _signer_counts.erase( count_itr );
+      }
+      _index.erase( itr );
+   }
+
+} } // bts::blockchain
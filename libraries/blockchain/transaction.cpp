@@ -39,6 +39,22 @@ namespace bts { namespace blockchain {
       signatures.push_back( signer.sign_compact( digest(chain_id) ) );
    }
 
+   unordered_set<address> signed_transaction::get_signed_addresses( const digest_type& chain_id, bool enforce_canonical )const
+   {
+      unordered_set<address> signed_addresses;
+      const auto trx_digest = digest( chain_id );
+      for( const auto& sig : signatures )
+      {
+         const auto key = fc::ecc::public_key( sig, trx_digest, enforce_canonical ).serialize();
+         signed_addresses.insert( address( key ) );
+         signed_addresses.insert( address( pts_address( key, false, 56 ) ) );
+         signed_addresses.insert( address( pts_address( key, true, 56 ) ) );
+         signed_addresses.insert( address( pts_address( key, false, 0 ) ) );
+         signed_addresses.insert( address( pts_address( key, true, 0 ) ) );
+      }
+      return signed_addresses;
+   }
+
    void transaction::set_object( const object_record& obj )
    {
       operations.emplace_back( set_object_operation( obj ) );
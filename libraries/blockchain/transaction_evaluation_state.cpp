@@ -189,50 +189,49 @@ namespace bts { namespace blockchain {
       }
    } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
+   void transaction_evaluation_state::check_expiration_and_uniqueness( const chain_interface& state, const signed_transaction& trx_arg,
+                                                                        const digest_type& chain_id )
+   {
+      if( state.now() >= trx_arg.expiration )
+      {
+         if( state.now() > trx_arg.expiration || state.get_head_block_num() >= BTS_V0_4_21_FORK_BLOCK_NUM )
+         {
+             const auto expired_by_sec = (state.now() - trx_arg.expiration).to_seconds();
+             FC_CAPTURE_AND_THROW( expired_transaction, (trx_arg)(state.now())(expired_by_sec) );
+         }
+      }
+      if( (state.now() + BTS_BLOCKCHAIN_MAX_TRANSACTION_EXPIRATION_SEC) < trx_arg.expiration )
+         FC_CAPTURE_AND_THROW( invalid_transaction_expiration, (trx_arg)(state.now()) );
+
+      if( state.get_head_block_num() >= BTS_V0_4_26_FORK_BLOCK_NUM )
+      {
+          if( state.is_known_transaction( trx_arg.expiration, trx_arg.digest( chain_id ) ) )
+          {
+              auto current_trx = state.get_transaction( trx_arg.id() );
+              if( current_trx )
+              {
+                 const auto trx_id = trx_arg.id();
+                 FC_CAPTURE_AND_THROW( duplicate_transaction, (trx_id)(current_trx) );
+              }
+              else
+              {
+                 elog( "WARNING: unable to find existing transaction, false positive" );
+              }
+          }
+      }
+   }
+
    void transaction_evaluation_state::evaluate( const signed_transaction& trx_arg, bool skip_signature_check, bool enforce_canonical )
    { try {
       _skip_signature_check = skip_signature_check;
       try {
-        if( _current_state->now() >= trx_arg.expiration )
-        {
-           if( _current_state->now() > trx_arg.expiration || _current_state->get_head_block_num() >= BTS_V0_4_21_FORK_BLOCK_NUM )
-           {
-               const auto expired_by_sec = (_current_state->now() - trx_arg.expiration).to_seconds();
-               FC_CAPTURE_AND_THROW( expired_transaction, (trx_arg)(_current_state->now())(expired_by_sec) );
-           }
-        }
-        if( (_current_state->now() + BTS_BLOCKCHAIN_MAX_TRANSACTION_EXPIRATION_SEC) < trx_arg.expiration )
-           FC_CAPTURE_AND_THROW( invalid_transaction_expiration, (trx_arg)(_current_state->now()) );
-
-        auto trx_id = trx_arg.id();
-
-        if( _current_state->get_head_block_num() >= BTS_V0_4_26_FORK_BLOCK_NUM )
-        {
-            if( _current_state->is_known_transaction( trx_arg.expiration, trx_arg.digest( _chain_id ) ) )
-            {
-                auto current_trx = _current_state->get_transaction( trx_arg.id() );
-                if( current_trx )
-                   FC_CAPTURE_AND_THROW( duplicate_transaction, (trx_id)(current_trx) );
-                else
-                {
-                   elog( "WARNING: unable to find existing transaction, false positive" );
-                }
-            }
-        }
+        check_expiration_and_uniqueness( *_current_state, trx_arg, _chain_id );
 
         trx = trx_arg;
-        if( !_skip_signature_check )
+        if( !_skip_signature_check && !_signed_keys_precomputed )
         {
-           auto digest = trx_arg.digest( _chain_id );
-           for( const auto& sig : trx.signatures )
-           {
-              auto key = fc::ecc::public_key( sig, digest, enforce_canonical ).serialize();
-              signed_keys.insert( address(key) );
-              signed_keys.insert( address(pts_address(key,false,56) ) );
-              signed_keys.insert( address(pts_address(key,true,56) )  );
-              signed_keys.insert( address(pts_address(key,false,0) )  );
-              signed_keys.insert( address(pts_address(key,true,0) )   );
-           }
+           const auto addresses = trx.get_signed_addresses( _chain_id, enforce_canonical );
+           signed_keys.insert( addresses.begin(), addresses.end() );
         }
         current_op_index = 0;
         for( const auto& op : trx.operations )
@@ -251,6 +250,12 @@ namespace bts { namespace blockchain {
       }
    } FC_RETHROW_EXCEPTIONS( warn, "", ("trx",trx_arg) ) }
 
+   void transaction_evaluation_state::set_signed_keys( unordered_set<address> keys )
+   {
+      signed_keys = std::move( keys );
+      _signed_keys_precomputed = true;
+   }
+
    void transaction_evaluation_state::evaluate_operation( const operation& op )
    {
       operation_factory::instance().evaluate( *this, op );
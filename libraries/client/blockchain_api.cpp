@@ -293,13 +293,61 @@ map<balance_id_type, balance_record> detail::client_impl::blockchain_list_addres
     }
     return result;
 }
+static address address_from_string( const string& raw_addr )
+{
+    try {
+        return address( raw_addr );
+    } catch (...) {
+        return address( pts_address( raw_addr ) );
+    }
+}
+
 map<transaction_id_type, transaction_record> detail::client_impl::blockchain_list_address_transactions( const string& raw_addr, 
                                                                                                         const time_point& after )const
 {
+   const address addr = address_from_string( raw_addr );
+
+   // walk back from the newest transaction until one comes from a block older than after
    map<transaction_id_type,transaction_record> results;
+   otransaction_location start;
+   uint32_t block_num = 0;
+   fc::time_point_sec block_time;
+   do
+   {
+      const address_transaction_page page = _chain_db->fetch_address_transactions( addr, start, 100, true );
+      for( const auto& record : page.transactions )
+      {
+         if( record.chain_location.block_num != block_num )
+         {
+            block_num = record.chain_location.block_num;
+            block_time = _chain_db->get_block_header( _chain_db->get_block_id( block_num ) ).timestamp;
+         }
+         if( fc::time_point( block_time ) < after )
+            return results;
+         results[ record.trx.id() ] = record;
+      }
+      start = page.next;
+   } while( start.valid() );
    return results;
 }
 
+address_transaction_page detail::client_impl::blockchain_get_address_transactions( const string& raw_addr,
+                                                                                   uint32_t start_block_num,
+                                                                                   uint32_t start_trx_num,
+                                                                                   uint32_t limit,
+                                                                                   bool newest_first )const
+{
+   otransaction_location start;
+   if( start_block_num > 0 )
+      start = transaction_location( start_block_num, start_trx_num );
+   return _chain_db->fetch_address_transactions( address_from_string( raw_addr ), start, limit, newest_first );
+}
+
+uint32_t detail::client_impl::blockchain_count_address_transactions( const string& raw_addr )const
+{
+   return _chain_db->count_address_transactions( address_from_string( raw_addr ) );
+}
+
 map<balance_id_type, balance_record> detail::client_impl::blockchain_list_key_balances( const public_key_type& key )const
 {
     return _chain_db->get_balances_for_key( key );
@@ -510,6 +558,17 @@ market_history_points client_impl::blockchain_market_price_history( const std::s
                                                start_time, duration, granularity );
 }
 
+market_history_series client_impl::blockchain_market_price_series( const std::string& quote_symbol,
+                                                                   const std::string& base_symbol,
+                                                                   const fc::time_point& start_time,
+                                                                   const fc::microseconds& duration,
+                                                                   uint32_t max_points )const
+{
+   return _chain_db->get_market_price_series( _chain_db->get_asset_id(quote_symbol),
+                                              _chain_db->get_asset_id(base_symbol),
+                                              start_time, duration, max_points );
+}
+
 map<transaction_id_type, transaction_record> client_impl::blockchain_get_block_transactions( const string& block )const
 {
    vector<transaction_record> transactions;
@@ -885,11 +885,9 @@ bool client_impl::has_item(const bts::net::item_id& id)
 
    if (id.item_type == trx_message_type)
    {
-      //return _chain_db->is_known_transaction( id.item_hash );
-      // TODO: the performance of get_transaction is much slower than is_known_transaction,
-      // but we do not have enough information to call is_known_transaction because it depends
-      // upon the transaction digest + expiration date and we only have the trx id.
-      return _chain_db->get_transaction( id.item_hash ).valid();
+      // is_known_transaction needs the digest and expiration, but all we have is the id. Expired
+      // transactions can no longer be included, so the unexpired ones are all that matter here.
+      return _chain_db->is_recent_transaction( id.item_hash );
    }
    return false;
 }
@@ -922,6 +920,11 @@ bool client_impl::handle_message(const bts::net::message& message_to_handle, boo
       FC_THROW_EXCEPTION(bts::net::insufficient_relay_fee, "Insufficient relay fee; do not propagate!",
                          ("original_exception", original_exception.to_detail_string()));
    }
+   catch (const bts::blockchain::pending_queue_full& original_exception)
+   {
+      FC_THROW_EXCEPTION(bts::net::insufficient_relay_fee, "Pending transaction queue is full; do not propagate!",
+                         ("original_exception", original_exception.to_detail_string()));
+   }
    catch (const bts::blockchain::block_older_than_undo_history& original_exception)
    {
       FC_THROW_EXCEPTION(bts::net::block_older_than_undo_history, "Block is older than undo history, stop fetching blocks!",
@@ -1322,6 +1325,10 @@ void client::open( const path& data_dir, fc::optional<fc::path> genesis_file_pat
     {
        ulog( "Tracking Statistics: ${s}", ("s",my->_config.track_statistics ) );
        my->_chain_db->track_chain_statistics( my->_config.track_statistics );
+       my->_chain_db->set_state_cache_size( size_t( my->_config.state_cache_size_mb ) * 1024 * 1024 );
+       my->_chain_db->set_pending_transaction_limits( my->_config.max_pending_transactions,
+                                                      uint64_t( my->_config.max_pending_transaction_size_mb ) * 1024 * 1024,
+                                                      my->_config.max_pending_transactions_per_signer );
        my->_chain_db->open( data_dir / "chain", genesis_file_path, reindex_status_callback );
     }
     catch( const db::db_in_use_exception& e )
@@ -1,3 +1,4 @@
+#include <bts/api/api_call_stats.hpp>
 #include <bts/blockchain/time.hpp>
 #include <bts/client/client.hpp>
 #include <bts/client/client_impl.hpp>
@@ -115,6 +116,16 @@ fc::variant_object client_impl::debug_get_call_statistics() const
    return _p2p_node->get_call_statistics();
 }
 
+std::vector<bts::api::method_call_summary> client_impl::debug_get_api_call_statistics() const
+{
+   return bts::api::get_call_statistics();
+}
+
+std::string client_impl::debug_export_api_call_statistics() const
+{
+   return bts::api::export_call_statistics();
+}
+
 fc::variant_object client_impl::debug_verify_delegate_votes() const
 {
    return _chain_db->find_delegate_vote_discrepancies();
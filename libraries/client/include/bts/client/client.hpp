@@ -122,6 +122,12 @@ namespace bts { namespace client {
            */
           string              relay_account_name;
           bool                track_statistics = true;
+          /** memory limit in MiB for each of the large chain state databases, 0 keeps them fully in memory */
+          uint32_t            state_cache_size_mb = 0;
+          /** bounds of the pending transaction queue, 0 disables a limit */
+          uint32_t            max_pending_transactions = BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS;
+          uint32_t            max_pending_transaction_size_mb = BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTION_BYTES / (1024*1024);
+          uint32_t            max_pending_transactions_per_signer = BTS_BLOCKCHAIN_MAX_PENDING_TRANSACTIONS_PER_SIGNER;
 
           fc::optional<std::string> growl_notify_endpoint;
           fc::optional<std::string> growl_password;
@@ -230,5 +236,9 @@ FC_REFLECT( bts::client::config,
             (light_relay_fee)
             (relay_account_name)
             (track_statistics)
+            (state_cache_size_mb)
+            (max_pending_transactions)
+            (max_pending_transaction_size_mb)
+            (max_pending_transactions_per_signer)
            )
 
@@ -1,22 +1,34 @@
 #pragma once
 #include <bts/db/level_map.hpp>
 #include <fc/thread/thread.hpp>
+#include <list>
 #include <map>
+#include <mutex>
 
 namespace bts { namespace db {
 
+   /**
+    *  By default the whole database is mirrored in memory. If max_cache_size is given to open(),
+    *  entries are instead loaded on demand and the least recently used ones are evicted once their
+    *  serialized size exceeds max_cache_size bytes; iteration then merges unflushed changes with
+    *  the database on disk. Reads may then come from several threads at once, so that state is
+    *  guarded by a mutex. size() is only available while the whole database is mirrored.
+    *
+    *  While a write_journal defers writes they are kept as unflushed changes, even in write through mode.
+    */
    template<typename Key, typename Value, class CacheType = std::map<Key,Value>>
-   class cached_level_map
+   class cached_level_map : public journaled_database
    {
       public:
-        void open( const fc::path& dir, bool create = true, size_t leveldb_cache_size = 0, bool write_through = true, bool sync_on_write = false )
+        void open( const fc::path& dir, bool create = true, size_t leveldb_cache_size = 0, bool write_through = true, bool sync_on_write = false,
+                   size_t max_cache_size = 0 )
         { try {
             _db.open( dir, create, leveldb_cache_size );
-            for( auto itr = _db.begin(); itr.valid(); ++itr )
-                _cache.emplace_hint( _cache.end(), itr.key(), itr.value() );
+            _max_cache_size = max_cache_size;
+            load_cache();
             _write_through = write_through;
             _sync_on_write = sync_on_write;
-        } FC_CAPTURE_AND_RETHROW( (dir)(create)(leveldb_cache_size)(write_through)(sync_on_write) ) }
+        } FC_CAPTURE_AND_RETHROW( (dir)(create)(leveldb_cache_size)(write_through)(sync_on_write)(max_cache_size) ) }
 
         void close()
         { try {
@@ -25,6 +37,11 @@ namespace bts { namespace db {
             _cache.clear();
             _dirty_store.clear();
             _dirty_remove.clear();
+            _pending.clear();
+            _lru_cache.clear();
+            _lru_list.clear();
+            _lru_cache_size = 0;
+            ++_revision;
         } FC_CAPTURE_AND_RETHROW() }
 
         void set_write_through( bool write_through )
@@ -45,7 +62,19 @@ namespace bts { namespace db {
                 batch.store( key, _cache.at( key ) );
             for( const auto& key : _dirty_remove )
                 batch.remove( key );
-            batch.commit();
+            for( const auto& item : _pending )
+            {
+                if( item.second.valid() )
+                    batch.store( item.first, *item.second );
+                else
+                    batch.remove( item.first );
+            }
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                batch.commit();
+                _pending.clear();
+                ++_revision;
+            }
 
             _dirty_store.clear();
             _dirty_remove.clear();
@@ -53,6 +82,26 @@ namespace bts { namespace db {
 
         fc::optional<Value> fetch_optional( const Key& key )const
         { try {
+            if( is_lazy() )
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                const auto pending_itr = _pending.find( key );
+                if( pending_itr != _pending.end() )
+                    return pending_itr->second;
+
+                const auto cache_itr = _lru_cache.find( key );
+                if( cache_itr != _lru_cache.end() )
+                {
+                    _lru_list.splice( _lru_list.begin(), _lru_list, cache_itr->second.lru_itr );
+                    return cache_itr->second.value;
+                }
+
+                const auto value = _db.fetch_optional( key );
+                if( value.valid() )
+                    cache_insert( key, *value );
+                return value;
+            }
+
             const auto itr = _cache.find( key );
             if( itr != _cache.end() )
                 return itr->second;
@@ -61,16 +110,33 @@ namespace bts { namespace db {
 
         Value fetch( const Key& key )const
         { try {
-            const auto itr = _cache.find( key );
-            if( itr != _cache.end() )
-                return itr->second;
+            const auto value = fetch_optional( key );
+            if( value.valid() )
+                return *value;
             FC_CAPTURE_AND_THROW( fc::key_not_found_exception, (key) );
         } FC_CAPTURE_AND_RETHROW( (key) ) }
 
         void store( const Key& key, const Value& value )
         { try {
+            if( is_lazy() )
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                ++_revision;
+                if( _write_through && !writes_deferred() )
+                {
+                    _db.store( key, value, _sync_on_write );
+                    cache_insert( key, value );
+                }
+                else
+                {
+                    _pending[ key ] = value;
+                    cache_erase( key );
+                }
+                return;
+            }
+
             _cache[ key ] = value;
-            if( _write_through )
+            if( _write_through && !writes_deferred() )
             {
                 _db.store( key, value, _sync_on_write );
             }
@@ -83,8 +149,20 @@ namespace bts { namespace db {
 
         void remove( const Key& key )
         { try {
+            if( is_lazy() )
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                ++_revision;
+                if( _write_through && !writes_deferred() )
+                    _db.remove( key, _sync_on_write );
+                else
+                    _pending[ key ] = fc::optional<Value>();
+                cache_erase( key );
+                return;
+            }
+
             _cache.erase( key );
-            if( _write_through )
+            if( _write_through && !writes_deferred() )
             {
                 _db.remove( key, _sync_on_write );
             }
@@ -97,11 +175,21 @@ namespace bts { namespace db {
 
         size_t size()const
         { try {
+            FC_ASSERT( !is_lazy(), "the number of entries is not known when they are loaded on demand" );
             return _cache.size();
         } FC_CAPTURE_AND_RETHROW() }
 
         bool last( Key& key )const
         { try {
+            if( is_lazy() )
+            {
+                const auto itr = seek( fc::optional<Key>(), false, false );
+                if( !itr.valid() )
+                    return false;
+                key = itr.key();
+                return true;
+            }
+
             const auto ritr = _cache.crbegin();
             if( ritr != _cache.crend() )
             {
@@ -113,6 +201,16 @@ namespace bts { namespace db {
 
         bool last( Key& key, Value& value )
         { try {
+            if( is_lazy() )
+            {
+                const auto itr = seek( fc::optional<Key>(), false, false );
+                if( !itr.valid() )
+                    return false;
+                key = itr.key();
+                value = itr.value();
+                return true;
+            }
+
             const auto ritr = _cache.crbegin();
             if( ritr != _cache.crend() )
             {
@@ -123,25 +221,59 @@ namespace bts { namespace db {
             return false;
         } FC_CAPTURE_AND_RETHROW( (key)(value) ) }
 
+        /**
+         *  When entries are loaded on demand the iterator keeps its own copy of the current key and value
+         *  and its positions in the database and in the unflushed changes, so it stays usable while the
+         *  cache is evicting entries. It only looks its neighbours up again when the map was modified
+         *  since, or when it changes direction. A copy never shares those positions.
+         */
         class iterator
         {
            public:
              iterator(){}
-             bool valid()const { return _it != _end; }
+             iterator( const iterator& other )
+             :_it(other._it),_begin(other._begin),_end(other._end),_map(other._map),_key(other._key),_value(other._value)
+             { }
+             iterator( iterator&& other ) = default;
 
-             Key   key()const { return _it->first; }
-             Value value()const { return _it->second; }
+             iterator& operator=( const iterator& other )
+             {
+                if( this != &other )
+                   *this = iterator( other );
+                return *this;
+             }
+             iterator& operator=( iterator&& other ) = default;
+
+             bool valid()const { return _map ? _key.valid() : _it != _end; }
+
+             Key   key()const { return _map ? *_key : _it->first; }
+             Value value()const { return _map ? *_value : _it->second; }
+
+             iterator& operator++()
+             {
+                if( _map )
+                {
+                   if( _key.valid() )
+                      _map->step( *this, true );
+                }
+                else
+                {
+                   ++_it;
+                }
+                return *this;
+             }
 
-             iterator& operator++()    { ++_it; return *this; }
              iterator  operator++(int) {
                 auto backup = *this;
-                ++_it;
+                operator++();
                 return backup;
              }
 
              iterator& operator--()
              {
-                if( _it == _begin )
+                if( _map )
+                   _map->step( *this, false );
+                else if( _it == _begin )
                    _it = _end;
                 else
                    --_it;
@@ -154,7 +286,13 @@ namespace bts { namespace db {
                 return backup;
              }
 
-             void reset() { _it = _end; }
+             void reset()
+             {
+                _it = _end;
+                _key.reset();
+                _value.reset();
+                _positioned = false;
+             }
 
            protected:
              friend class cached_level_map;
@@ -162,18 +300,37 @@ namespace bts { namespace db {
              :_it(it),_begin(begin),_end(end)
              { }
 
+             iterator( const cached_level_map* map, fc::optional<Key> key = fc::optional<Key>(), fc::optional<Value> value = fc::optional<Value>() )
+             :_map(map),_key(std::move(key)),_value(std::move(value))
+             { }
+
              typename CacheType::const_iterator _it;
              typename CacheType::const_iterator _begin;
              typename CacheType::const_iterator _end;
+
+             const cached_level_map*            _map = nullptr;
+             fc::optional<Key>                  _key;
+             fc::optional<Value>                _value;
+
+             /** only meaningful while _positioned and _revision matches the map's */
+             typename level_map<Key, Value>::iterator                        _db_itr;
+             typename std::map<Key, fc::optional<Value>>::const_iterator    _pending_itr;
+             bool                               _forward = true;
+             bool                               _positioned = false;
+             uint64_t                           _revision = 0;
         };
 
         iterator begin()const
         {
+           if( is_lazy() )
+              return seek( fc::optional<Key>(), true, false );
            return iterator( _cache.begin(), _cache.begin(), _cache.end() );
         }
 
         iterator last()
         {
+           if( is_lazy() )
+              return seek( fc::optional<Key>(), false, false );
            if( _cache.empty() )
               return iterator( _cache.end(), _cache.begin(), _cache.end() );
            return iterator( --_cache.end(), _cache.begin(), _cache.end() );
@@ -181,11 +338,20 @@ namespace bts { namespace db {
 
         iterator find( const Key& key )
         {
+           if( is_lazy() )
+           {
+              const auto value = fetch_optional( key );
+              if( !value.valid() )
+                 return iterator( this );
+              return iterator( this, key, value );
+           }
            return iterator( _cache.find(key), _cache.begin(), _cache.end() );
         }
 
         iterator lower_bound( const Key& key )
         {
+           if( is_lazy() )
+              return seek( key, true, true );
            return iterator( _cache.lower_bound(key), _cache.begin(), _cache.end() );
         }
 
@@ -195,13 +361,288 @@ namespace bts { namespace db {
             _db.export_to_json( path );
         } FC_CAPTURE_AND_RETHROW( (path) ) }
 
+        /**
+         *  Returns the task that copies the contents into a new database at dir, see level_map. With
+         *  unflushed changes, which are only kept while reindexing, the copy is made right away instead.
+         */
+        std::function<void()> prepare_export_to_snapshot( const fc::path& dir )const
+        { try {
+            bool unflushed;
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                unflushed = !_dirty_store.empty() || !_dirty_remove.empty() || !_pending.empty();
+            }
+            if( !unflushed )
+                return _db.prepare_export_to_snapshot( dir );
+
+            export_to_snapshot( dir );
+            return [](){};
+        } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+        /** Writes the cached contents, including any unflushed changes, to a new database at dir */
+        void export_to_snapshot( const fc::path& dir )const
+        { try {
+            FC_ASSERT( !fc::exists( dir ) );
+
+            level_map<Key, Value> snapshot;
+            snapshot.open( dir );
+            {
+                typename level_map<Key, Value>::write_batch batch = snapshot.create_batch( true );
+                size_t batch_count = 0;
+                for( auto itr = begin(); itr.valid(); ++itr )
+                {
+                    batch.store( itr.key(), itr.value() );
+                    if( ++batch_count % 10000 == 0 )
+                        batch.commit();
+                }
+                batch.commit();
+            }
+            snapshot.close();
+        } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+        virtual void collect_writes( std::vector<journal_write>& writes )override
+        { try {
+            std::lock_guard<std::mutex> lock( _lazy_mutex );
+            writes.reserve( writes.size() + _dirty_store.size() + _dirty_remove.size() + _pending.size() );
+            for( const auto& key : _dirty_store )
+                writes.push_back( journal_write{ fc::raw::pack( key ), fc::raw::pack( _cache.at( key ) ) } );
+            for( const auto& key : _dirty_remove )
+                writes.push_back( journal_write{ fc::raw::pack( key ), fc::optional<std::vector<char>>() } );
+            for( const auto& item : _pending )
+            {
+                journal_write write{ fc::raw::pack( item.first ), fc::optional<std::vector<char>>() };
+                if( item.second.valid() )
+                    write.value = fc::raw::pack( *item.second );
+                writes.push_back( std::move( write ) );
+            }
+        } FC_CAPTURE_AND_RETHROW() }
+
+        virtual void apply_writes( const std::vector<journal_write>& writes, bool replayed )override
+        { try {
+            std::lock_guard<std::mutex> lock( _lazy_mutex );
+            _db.apply_writes( writes, replayed );
+            _dirty_store.clear();
+            _dirty_remove.clear();
+            _pending.clear();
+            ++_revision;
+            if( replayed )
+                load_cache();
+        } FC_CAPTURE_AND_RETHROW( (replayed) ) }
+
       private:
-        level_map<Key, Value>    _db;
-        CacheType                _cache;
-        std::set<Key>            _dirty_store;
-        std::set<Key>            _dirty_remove;
-        bool                     _write_through = true;
-        bool                     _sync_on_write = false;
+        bool is_lazy()const { return _max_cache_size != 0; }
+
+        /** mirrors the database in memory, or starts with an empty cache when entries are loaded on demand */
+        void load_cache()
+        {
+            _cache.clear();
+            _lru_cache.clear();
+            _lru_list.clear();
+            _lru_cache_size = 0;
+            ++_revision;
+            if( !is_lazy() )
+            {
+                for( auto itr = _db.begin(); itr.valid(); ++itr )
+                    _cache.emplace_hint( _cache.end(), itr.key(), itr.value() );
+            }
+        }
+
+        /**
+         *  Finds the nearest entry from key in the given direction (from the very first or last entry if
+         *  key is not set), letting unflushed stores and removes take precedence over the database.
+         */
+        iterator seek( fc::optional<Key> key, bool forward, bool inclusive )const
+        { try {
+            std::lock_guard<std::mutex> lock( _lazy_mutex );
+            typename level_map<Key, Value>::iterator db_itr;
+            if( forward )
+            {
+                db_itr = key.valid() ? _db.lower_bound( *key ) : _db.begin();
+                if( key.valid() && !inclusive && db_itr.valid() && db_itr.key() == *key )
+                    ++db_itr;
+            }
+            else if( !key.valid() )
+            {
+                db_itr = _db.last();
+            }
+            else
+            {
+                db_itr = _db.lower_bound( *key );
+                if( !db_itr.valid() )
+                    db_itr = _db.last();
+                else if( !inclusive || !(db_itr.key() == *key) )
+                    --db_itr;
+            }
+
+            auto pending_itr = _pending.end();
+            if( forward )
+            {
+                if( !key.valid() )
+                    pending_itr = _pending.begin();
+                else
+                    pending_itr = inclusive ? _pending.lower_bound( *key ) : _pending.upper_bound( *key );
+            }
+            else
+            {
+                auto after_itr = _pending.end();
+                if( key.valid() )
+                    after_itr = inclusive ? _pending.upper_bound( *key ) : _pending.lower_bound( *key );
+                if( after_itr != _pending.begin() )
+                    pending_itr = --after_itr;
+            }
+
+            iterator itr( this );
+            itr._db_itr = std::move( db_itr );
+            itr._pending_itr = pending_itr;
+            resolve( itr, forward );
+            return itr;
+        } FC_CAPTURE_AND_RETHROW( (key)(forward)(inclusive) ) }
+
+        /** moves a lazy iterator to the next entry in the given direction */
+        void step( iterator& itr, bool forward )const
+        { try {
+            {
+                std::lock_guard<std::mutex> lock( _lazy_mutex );
+                if( itr._positioned && itr._key.valid() && itr._forward == forward && itr._revision == _revision )
+                {
+                    const Key key = *itr._key;
+                    if( itr._db_itr.valid() && itr._db_itr.key() == key )
+                    {
+                        if( forward ) ++itr._db_itr;
+                        else --itr._db_itr;
+                    }
+                    if( itr._pending_itr != _pending.end() && itr._pending_itr->first == key )
+                        step_pending( itr._pending_itr, forward );
+                    resolve( itr, forward );
+                    return;
+                }
+            }
+            itr = seek( itr._key, forward, false );
+        } FC_CAPTURE_AND_RETHROW( (forward) ) }
+
+        /**
+         *  Points itr at the nearer of the database and unflushed entries it is positioned at, letting
+         *  unflushed stores and removes take precedence over the database.
+         */
+        void resolve( iterator& itr, bool forward )const
+        {
+            itr._forward = forward;
+            itr._positioned = true;
+            itr._revision = _revision;
+            while( true )
+            {
+                const bool have_db = itr._db_itr.valid();
+                const bool have_pending = itr._pending_itr != _pending.end();
+                if( !have_db && !have_pending )
+                {
+                    itr._key.reset();
+                    itr._value.reset();
+                    return;
+                }
+
+                fc::optional<Key> db_key;
+                if( have_db )
+                    db_key = itr._db_itr.key();
+
+                bool use_pending = have_pending;
+                if( have_db && have_pending )
+                {
+                    if( *db_key == itr._pending_itr->first )
+                        use_pending = true;
+                    else
+                        use_pending = forward ? itr._pending_itr->first < *db_key : *db_key < itr._pending_itr->first;
+                }
+
+                if( !use_pending )
+                {
+                    itr._key = db_key;
+                    itr._value = itr._db_itr.value();
+                    return;
+                }
+
+                if( itr._pending_itr->second.valid() )
+                {
+                    itr._key = itr._pending_itr->first;
+                    itr._value = itr._pending_itr->second;
+                    return;
+                }
+
+                /* Skip over entries removed since the last flush, and the database entry they hide */
+                if( have_db && *db_key == itr._pending_itr->first )
+                {
+                    if( forward ) ++itr._db_itr;
+                    else --itr._db_itr;
+                }
+                step_pending( itr._pending_itr, forward );
+            }
+        }
+
+        /** _pending.end() stands for no more unflushed entries in either direction */
+        void step_pending( typename std::map<Key, fc::optional<Value>>::const_iterator& itr, bool forward )const
+        {
+            if( forward )
+                ++itr;
+            else if( itr == _pending.begin() )
+                itr = _pending.end();
+            else
+                --itr;
+        }
+
+        void cache_insert( const Key& key, const Value& value )const
+        {
+            const size_t size = fc::raw::pack_size( key ) + fc::raw::pack_size( value );
+            auto itr = _lru_cache.find( key );
+            if( itr != _lru_cache.end() )
+            {
+                _lru_cache_size -= itr->second.size;
+                itr->second.value = value;
+                itr->second.size = size;
+                _lru_list.splice( _lru_list.begin(), _lru_list, itr->second.lru_itr );
+            }
+            else
+            {
+                _lru_list.push_front( key );
+                _lru_cache.emplace( key, cache_entry{ value, size, _lru_list.begin() } );
+            }
+            _lru_cache_size += size;
+
+            while( _lru_cache_size > _max_cache_size && !_lru_list.empty() )
+                cache_erase( _lru_list.back() );
+        }
+
+        void cache_erase( const Key& key )const
+        {
+            auto itr = _lru_cache.find( key );
+            if( itr == _lru_cache.end() )
+                return;
+            _lru_cache_size -= itr->second.size;
+            _lru_list.erase( itr->second.lru_itr );
+            _lru_cache.erase( itr );
+        }
+
+        struct cache_entry
+        {
+            Value                                 value;
+            size_t                                size;
+            typename std::list<Key>::iterator     lru_itr;
+        };
+
+        mutable level_map<Key, Value>            _db;
+        CacheType                                _cache;
+        std::set<Key>                            _dirty_store;
+        std::set<Key>                            _dirty_remove;
+        bool                                     _write_through = true;
+        bool                                     _sync_on_write = false;
+
+        /** only used when entries are loaded on demand */
+        size_t                                   _max_cache_size = 0;
+        std::map<Key, fc::optional<Value>>       _pending;
+        mutable std::map<Key, cache_entry>       _lru_cache;
+        mutable std::list<Key>                   _lru_list;
+        mutable size_t                           _lru_cache_size = 0;
+        mutable std::mutex                       _lazy_mutex;
+        /** bumped on every change to _db or _pending, so that iterators know when to seek again */
+        mutable uint64_t                         _revision = 0;
    };
 
 } }
@@ -0,0 +1,46 @@
+#pragma once
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <vector>
+
+namespace bts { namespace db {
+
+   /** a serialized write to a single database, a write without a value removes the key */
+   struct journal_write
+   {
+      std::vector<char>                 key;
+      fc::optional<std::vector<char>>   value;
+   };
+
+   class write_journal;
+
+   /**
+    *  A database that can hold its writes back while attached to a write_journal, so that they
+    *  are committed together with the writes to every other attached database.
+    */
+   class journaled_database
+   {
+      public:
+         virtual ~journaled_database(){}
+
+         /** true between write_journal::begin() and write_journal::commit() */
+         bool writes_deferred()const { return _writes_deferred; }
+
+         /** appends every write held back since write_journal::begin() */
+         virtual void collect_writes( std::vector<journal_write>& writes ) = 0;
+
+         /**
+          *  Writes a journal record to the database and drops the writes that were held back for it.
+          *  replayed is set when the record is left over from an interrupted commit.
+          */
+         virtual void apply_writes( const std::vector<journal_write>& writes, bool replayed ) = 0;
+
+      private:
+         friend class write_journal;
+         bool _writes_deferred = false;
+   };
+
+} } // bts::db
+
+FC_REFLECT( bts::db::journal_write, (key)(value) )
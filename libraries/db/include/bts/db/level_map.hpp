@@ -6,6 +6,7 @@
 #include <leveldb/write_batch.h>
 
 #include <bts/db/exception.hpp>
+#include <bts/db/journaled_database.hpp>
 #include <bts/db/upgrade_leveldb.hpp>
 
 #include <fc/filesystem.hpp>
@@ -14,6 +15,9 @@
 #include <fc/reflect/reflect.hpp>
 
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
 
 namespace bts { namespace db {
 
@@ -21,9 +25,15 @@ namespace bts { namespace db {
 
   /**
    *  @brief implements a high-level API on top of Level DB that stores items using fc::raw / reflection
+   *
+   *  While writes are deferred by a write_journal they are kept in memory, where lookups and
+   *  iteration see them merged with the entries that have been written to the database.
+   *
+   *  fetch(), fetch_packed() and find() may be called from other threads while the owning thread
+   *  writes, the held back writes are guarded by a mutex. Iterators may only be used by the owner.
    */
   template<typename Key, typename Value>
-  class level_map
+  class level_map : public journaled_database
   {
      public:
         void open( const fc::path& dir, bool create = true, size_t cache_size = 0 )
@@ -78,6 +88,8 @@ namespace bts { namespace db {
         {
           _db.reset();
           _cache.reset();
+          std::lock_guard<std::mutex> lock( _deferred_mutex );
+          _deferred_writes.clear();
         }
 
         fc::optional<Value> fetch_optional( const Key& k )
@@ -93,6 +105,14 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
+           fc::optional<Value> deferred_value;
+           if( find_deferred( k, deferred_value ) )
+           {
+             if( !deferred_value.valid() )
+               FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+             return *deferred_value;
+           }
+
            std::vector<char> kslice = fc::raw::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
            std::string value;
@@ -111,17 +131,53 @@ namespace bts { namespace db {
            return tmp;
         } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
 
+        /** the stored serialized value of k, for callers that pass it on without unpacking it */
+        fc::optional<std::vector<char>> fetch_packed( const Key& k )
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           fc::optional<Value> deferred_value;
+           if( find_deferred( k, deferred_value ) )
+           {
+             if( !deferred_value.valid() ) return fc::optional<std::vector<char>>();
+             return fc::raw::pack( *deferred_value );
+           }
+
+           std::vector<char> kslice = fc::raw::pack( k );
+           ldb::Slice ks( kslice.data(), kslice.size() );
+           std::string value;
+           auto status = _db->Get( _read_options, ks, &value );
+           if( status.IsNotFound() )
+           {
+             return fc::optional<std::vector<char>>();
+           }
+           if( !status.ok() )
+           {
+               FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
+           }
+           return std::vector<char>( value.begin(), value.end() );
+        } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+        /** writes held back by a write_journal, an empty value is a removal */
+        typedef std::map<Key, fc::optional<Value>> deferred_writes_type;
+
+        /**
+         *  Visits the entries in the database merged with the writes held back by a write_journal:
+         *  a deferred store replaces or adds its entry and a deferred removal hides it. Each step
+         *  seeks both sides by key, so the iterator stays correct while more writes are deferred.
+         */
         class iterator
         {
            public:
              iterator(){}
              bool valid()const
              {
-                return _it && _it->Valid();
+                return _deferred || (_it && _it->Valid());
              }
 
              Key key()const
              {
+                 if( _deferred ) return _deferred->first;
                  Key tmp_key;
                  fc::datastream<const char*> ds2( _it->key().data(), _it->key().size() );
                  fc::raw::unpack( ds2, tmp_key );
@@ -130,29 +186,118 @@ namespace bts { namespace db {
 
              Value value()const
              {
+               if( _deferred ) return _deferred->second;
                Value tmp_val;
                fc::datastream<const char*> ds( _it->value().data(), _it->value().size() );
                fc::raw::unpack( ds, tmp_val );
                return tmp_val;
              }
 
-             iterator& operator++()    { _it->Next(); return *this; }
-             iterator& operator--()    { _it->Prev(); return *this; }
+             iterator& operator++()
+             {
+                if( !has_deferred_writes() && !_deferred ) _it->Next();
+                else if( valid() ) seek_forward( fc::optional<Key>( key() ), false );
+                return *this;
+             }
+
+             iterator& operator--()
+             {
+                if( !has_deferred_writes() && !_deferred ) _it->Prev();
+                else if( valid() ) seek_backward( fc::optional<Key>( key() ), false );
+                return *this;
+             }
 
            protected:
              friend class level_map;
-             iterator( ldb::Iterator* it )
-             :_it(it){}
+             iterator( ldb::Iterator* it, const deferred_writes_type* deferred_writes = nullptr )
+             :_it(it),_deferred_writes(deferred_writes){}
+
+             bool has_deferred_writes()const
+             {
+                return _deferred_writes != nullptr && !_deferred_writes->empty();
+             }
+
+             Key db_key()const
+             {
+                Key tmp_key;
+                fc::datastream<const char*> ds( _it->key().data(), _it->key().size() );
+                fc::raw::unpack( ds, tmp_key );
+                return tmp_key;
+             }
+
+             bool deferred( const Key& k )const
+             {
+                return has_deferred_writes() && _deferred_writes->find( k ) != _deferred_writes->end();
+             }
+
+             static void seek_db( ldb::Iterator& it, const Key& k )
+             {
+                std::vector<char> kslice = fc::raw::pack( k );
+                it.Seek( ldb::Slice( kslice.data(), kslice.size() ) );
+             }
+
+             /** moves to the first entry at or after from (after it if not inclusive), or the very first one */
+             void seek_forward( const fc::optional<Key>& from, bool inclusive )
+             {
+                _deferred.reset();
+
+                if( !from.valid() ) _it->SeekToFirst();
+                else
+                {
+                   seek_db( *_it, *from );
+                   if( !inclusive && _it->Valid() && !(*from < db_key()) ) _it->Next();
+                }
+                while( _it->Valid() && deferred( db_key() ) ) _it->Next();
+
+                if( !has_deferred_writes() ) return;
+                auto pending = !from.valid() ? _deferred_writes->begin()
+                                             : inclusive ? _deferred_writes->lower_bound( *from )
+                                                         : _deferred_writes->upper_bound( *from );
+                while( pending != _deferred_writes->end() && !pending->second.valid() ) ++pending;
+
+                if( pending != _deferred_writes->end() && (!_it->Valid() || pending->first < db_key()) )
+                   _deferred = std::make_shared<std::pair<Key, Value>>( pending->first, *pending->second );
+             }
+
+             /** moves to the last entry at or before from (before it if not inclusive), or the very last one */
+             void seek_backward( const fc::optional<Key>& from, bool inclusive )
+             {
+                _deferred.reset();
+
+                if( !from.valid() ) _it->SeekToLast();
+                else
+                {
+                   seek_db( *_it, *from );
+                   if( !_it->Valid() ) _it->SeekToLast();
+                   else if( !inclusive || *from < db_key() ) _it->Prev();
+                }
+                while( _it->Valid() && deferred( db_key() ) ) _it->Prev();
 
-             std::shared_ptr<ldb::Iterator> _it;
+                if( !has_deferred_writes() ) return;
+                auto pending = !from.valid() ? _deferred_writes->end()
+                                             : inclusive ? _deferred_writes->upper_bound( *from )
+                                                         : _deferred_writes->lower_bound( *from );
+                while( pending != _deferred_writes->begin() )
+                {
+                   --pending;
+                   if( !pending->second.valid() ) continue;
+                   if( !_it->Valid() || db_key() < pending->first )
+                      _deferred = std::make_shared<std::pair<Key, Value>>( pending->first, *pending->second );
+                   break;
+                }
+             }
+
+             std::shared_ptr<ldb::Iterator>           _it;
+             const deferred_writes_type*              _deferred_writes = nullptr;
+             std::shared_ptr<std::pair<Key, Value>>   _deferred;
         };
 
         iterator begin() const
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           iterator itr( _db->NewIterator( _iter_options ) );
-           itr._it->SeekToFirst();
+           iterator itr( _db->NewIterator( _iter_options ), &_deferred_writes );
+           itr.seek_forward( fc::optional<Key>(), true );
 
            if( itr._it->status().IsNotFound() )
            {
@@ -174,6 +319,15 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
+           fc::optional<Value> deferred_value;
+           if( find_deferred( key, deferred_value ) )
+           {
+              if( !deferred_value.valid() ) return iterator();
+              iterator itr( _db->NewIterator( _iter_options ), &_deferred_writes );
+              itr._deferred = std::make_shared<std::pair<Key, Value>>( key, *deferred_value );
+              return itr;
+           }
+
            ldb::Slice key_slice;
 
            /** avoid dynamic memory allocation at this step if possible, most
@@ -195,7 +349,7 @@ namespace bts { namespace db {
               key_slice = ldb::Slice( kslice.data(), kslice.size() );
            }
 
-           iterator itr( _db->NewIterator( _iter_options ) );
+           iterator itr( _db->NewIterator( _iter_options ), &_deferred_writes );
            itr._it->Seek( key_slice );
            if( itr.valid() && itr.key() == key )
            {
@@ -208,11 +362,8 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( key );
-           ldb::Slice key_slice( kslice.data(), kslice.size() );
-
-           iterator itr( _db->NewIterator( _iter_options ) );
-           itr._it->Seek( key_slice );
+           iterator itr( _db->NewIterator( _iter_options ), &_deferred_writes );
+           itr.seek_forward( fc::optional<Key>( key ), true );
            return itr;
         } FC_RETHROW_EXCEPTIONS( warn, "error finding ${key}", ("key",key) ) }
 
@@ -220,43 +371,31 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           iterator itr( _db->NewIterator( _iter_options ) );
-           itr._it->SeekToLast();
+           iterator itr( _db->NewIterator( _iter_options ), &_deferred_writes );
+           itr.seek_backward( fc::optional<Key>(), true );
            return itr;
         } FC_RETHROW_EXCEPTIONS( warn, "error finding last" ) }
 
         bool last( Key& k )
         { try {
-           FC_ASSERT( is_open(), "Database is not open!" );
-
-           std::unique_ptr<ldb::Iterator> it( _db->NewIterator( _iter_options ) );
-           FC_ASSERT( it != nullptr );
-           it->SeekToLast();
-           if( !it->Valid() )
+           auto itr = last();
+           if( !itr.valid() )
            {
              return false;
            }
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           k = itr.key();
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
         bool last( Key& k, Value& v )
         { try {
-           FC_ASSERT( is_open(), "Database is not open!" );
-
-           std::unique_ptr<ldb::Iterator> it( _db->NewIterator( _iter_options ) );
-           FC_ASSERT( it != nullptr );
-           it->SeekToLast();
-           if( !it->Valid() )
+           auto itr = last();
+           if( !itr.valid() )
            {
              return false;
            }
-           fc::datastream<const char*> ds( it->value().data(), it->value().size() );
-           fc::raw::unpack( ds, v );
-
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           k = itr.key();
+           v = itr.value();
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -347,6 +486,16 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
+           {
+              std::lock_guard<std::mutex> lock( _deferred_mutex );
+              if( writes_deferred() )
+              {
+                 _deferred_writes[ k ] = v;
+                 return;
+              }
+              if( !_deferred_writes.empty() ) _deferred_writes.erase( k );
+           }
+
            std::vector<char> kslice = fc::raw::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
 
@@ -364,6 +513,16 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
+           {
+              std::lock_guard<std::mutex> lock( _deferred_mutex );
+              if( writes_deferred() )
+              {
+                 _deferred_writes[ k ] = fc::optional<Value>();
+                 return;
+              }
+              if( !_deferred_writes.empty() ) _deferred_writes.erase( k );
+           }
+
            std::vector<char> kslice = fc::raw::pack( k );
            ldb::Slice ks( kslice.data(), kslice.size() );
            auto status = _db->Delete( sync ? _sync_options : _write_options, ks );
@@ -396,6 +555,100 @@ namespace bts { namespace db {
             fs.write( "]", 1 );
         } FC_CAPTURE_AND_RETHROW( (path) ) }
 
+        /** Copies every entry into a new database at dir */
+        void export_to_snapshot( const fc::path& dir )const
+        {
+            prepare_export_to_snapshot( dir )();
+        }
+
+        /**
+         *  Pins the current contents with a LevelDB snapshot and returns the task that copies them into
+         *  a new database at dir. Later writes do not show up in the copy, so the task can run on another
+         *  thread while blocks keep being applied, but this database has to stay open until it is done.
+         */
+        std::function<void()> prepare_export_to_snapshot( const fc::path& dir )const
+        { try {
+            FC_ASSERT( is_open(), "Database is not open!" );
+            FC_ASSERT( _deferred_writes.empty(), "writes held back by a write_journal would be missing from the copy" );
+
+            ldb::DB* db = _db.get();
+            std::shared_ptr<const ldb::Snapshot> pinned( db->GetSnapshot(), [db]( const ldb::Snapshot* s ){ db->ReleaseSnapshot( s ); } );
+            ldb::ReadOptions read_options = _iter_options;
+            const ldb::WriteOptions write_options = _write_options;
+            const ldb::WriteOptions sync_options = _sync_options;
+
+            return [=]()
+            { try {
+                FC_ASSERT( !fc::exists( dir ) );
+
+                level_map snapshot;
+                snapshot.open( dir );
+
+                ldb::ReadOptions options = read_options;
+                options.snapshot = pinned.get();
+                std::unique_ptr<ldb::Iterator> it( db->NewIterator( options ) );
+                FC_ASSERT( it != nullptr );
+
+                ldb::WriteBatch batch;
+                size_t batch_count = 0;
+                for( it->SeekToFirst(); it->Valid(); it->Next() )
+                {
+                    batch.Put( it->key(), it->value() );
+                    if( ++batch_count % 10000 == 0 )
+                    {
+                        auto status = snapshot._db->Write( write_options, &batch );
+                        if( !status.ok() )
+                            FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
+                        batch.Clear();
+                    }
+                }
+                if( !it->status().ok() )
+                    FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", it->status().ToString() ) );
+
+                auto status = snapshot._db->Write( sync_options, &batch );
+                if( !status.ok() )
+                    FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
+
+                snapshot.close();
+            } FC_CAPTURE_AND_RETHROW( (dir) ) };
+        } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+        virtual void collect_writes( std::vector<journal_write>& writes )override
+        {
+           writes.reserve( writes.size() + _deferred_writes.size() );
+           for( const auto& item : _deferred_writes )
+           {
+              journal_write write;
+              write.key = fc::raw::pack( item.first );
+              if( item.second.valid() )
+                 write.value = fc::raw::pack( *item.second );
+              writes.push_back( std::move( write ) );
+           }
+        }
+
+        virtual void apply_writes( const std::vector<journal_write>& writes, bool replayed )override
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           ldb::WriteBatch batch;
+           for( const auto& write : writes )
+           {
+              const ldb::Slice ks( write.key.data(), write.key.size() );
+              if( write.value.valid() )
+                 batch.Put( ks, ldb::Slice( write.value->data(), write.value->size() ) );
+              else
+                 batch.Delete( ks );
+           }
+
+           auto status = _db->Write( _write_options, &batch );
+           if( !status.ok() )
+           {
+               FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
+           }
+           std::lock_guard<std::mutex> lock( _deferred_mutex );
+           _deferred_writes.clear();
+        } FC_CAPTURE_AND_RETHROW( (replayed) ) }
+
         // note: this loops through all the items in the database, so it's not exactly fast.  it's intended for debugging, nothing else.
         size_t size() const
         {
@@ -410,6 +663,16 @@ namespace bts { namespace db {
         }
 
      private:
+        /** copies the held back write for k into value, returns false if there is none */
+        bool find_deferred( const Key& k, fc::optional<Value>& value )const
+        {
+           std::lock_guard<std::mutex> lock( _deferred_mutex );
+           const auto itr = _deferred_writes.find( k );
+           if( itr == _deferred_writes.end() ) return false;
+           value = itr->second;
+           return true;
+        }
+
         class key_compare : public leveldb::Comparator
         {
           public:
@@ -439,6 +702,9 @@ namespace bts { namespace db {
         ldb::ReadOptions                _iter_options;
         ldb::WriteOptions               _write_options;
         ldb::WriteOptions               _sync_options;
+
+        deferred_writes_type            _deferred_writes;
+        mutable std::mutex              _deferred_mutex;
   };
 
 } } // bts::db
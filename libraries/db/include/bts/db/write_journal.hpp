@@ -0,0 +1,73 @@
+#pragma once
+#include <bts/db/journaled_database.hpp>
+#include <bts/db/level_map.hpp>
+
+#include <map>
+#include <string>
+
+namespace bts { namespace db {
+
+   /** every write made to the attached databases between write_journal::begin() and write_journal::commit() */
+   struct journal_record
+   {
+      std::map<std::string, std::vector<journal_write>> writes;
+   };
+
+   /**
+    *  Commits the writes to several databases as one unit.
+    *
+    *  Between begin() and commit() the attached databases hold their writes back in memory.
+    *  commit() first stores all of them as a single record in the journal and only then writes
+    *  them to the individual databases, in the order they were attached, after which the record
+    *  is removed again. When the process dies part way through, the record is still in the journal
+    *  the next time the databases are attached and is replayed into them before they are used, so
+    *  either every write of a commit is observed or none of them are.
+    *
+    *  None of these writes are synced unless commit() is asked to, so this only holds for a
+    *  process that dies while the operating system keeps running. After a power loss the databases
+    *  may disagree and have to be rebuilt.
+    *
+    *  This costs bytes rather than saving them: a commit that touches more than one database writes
+    *  everything twice, once in the journal record and once more in the databases themselves.
+    *
+    *  Writes left over for a name that is never attached again are logged and dropped by the next
+    *  begin(), since there is no database left to replay them into.
+    */
+   class write_journal
+   {
+      public:
+         void open( const fc::path& dir );
+         void close();
+         bool is_open()const;
+
+         /**
+          *  Adds db to the journal. name identifies the database across restarts, any writes to it
+          *  left over from an interrupted commit are replayed immediately. Writes are applied in the
+          *  order the databases were attached, so the database that decides what was committed
+          *  should be attached last.
+          */
+         void attach( const std::string& name, journaled_database& db );
+
+         /** holds back every write to the attached databases until commit() */
+         void begin();
+         bool is_deferring()const { return _deferring; }
+
+         /**
+          *  Writes everything held back since begin() as one unit. Only the journal record is synced,
+          *  and only if sync is set.
+          */
+         void commit( bool sync = false );
+
+      private:
+         void set_deferring( bool deferring );
+
+         level_map<uint32_t, journal_record>           _records;
+         std::map<std::string, journaled_database*>    _databases;
+         std::vector<std::string>                      _attach_order;
+         fc::optional<journal_record>                  _interrupted;
+         bool                                          _deferring = false;
+   };
+
+} } // bts::db
+
+FC_REFLECT( bts::db::journal_record, (writes) )
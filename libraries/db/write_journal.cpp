@@ -0,0 +1,117 @@
+#include <bts/db/write_journal.hpp>
+
+#include <fc/log/logger.hpp>
+
+namespace bts { namespace db {
+
+   /* There is only ever a single record, the one being committed */
+   static const uint32_t journal_record_key = 0;
+
+   void write_journal::open( const fc::path& dir )
+   { try {
+      _records.open( dir );
+      _interrupted = _records.fetch_optional( journal_record_key );
+      if( _interrupted.valid() )
+         wlog( "found writes to ${n} databases from an interrupted commit", ("n",_interrupted->writes.size()) );
+   } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+   void write_journal::close()
+   {
+      set_deferring( false );
+      _databases.clear();
+      _attach_order.clear();
+      _interrupted.reset();
+      _records.close();
+   }
+
+   bool write_journal::is_open()const
+   {
+      return _records.is_open();
+   }
+
+   void write_journal::attach( const std::string& name, journaled_database& db )
+   { try {
+      FC_ASSERT( is_open(), "Journal is not open!" );
+      FC_ASSERT( !_deferring );
+      FC_ASSERT( _databases.find( name ) == _databases.end(), "database already attached" );
+
+      _databases[ name ] = &db;
+      _attach_order.push_back( name );
+
+      if( !_interrupted.valid() )
+         return;
+
+      const auto itr = _interrupted->writes.find( name );
+      if( itr != _interrupted->writes.end() )
+      {
+         wlog( "replaying ${n} writes to ${db} from an interrupted commit", ("n",itr->second.size())("db",name) );
+         db.apply_writes( itr->second, true );
+         _interrupted->writes.erase( itr );
+      }
+
+      if( _interrupted->writes.empty() )
+      {
+         _records.remove( journal_record_key, true );
+         _interrupted.reset();
+      }
+   } FC_CAPTURE_AND_RETHROW( (name) ) }
+
+   void write_journal::begin()
+   { try {
+      FC_ASSERT( is_open(), "Journal is not open!" );
+      FC_ASSERT( !_deferring );
+
+      /* Whatever is left was written for databases that are no longer attached, e.g. because they
+       * were renamed or removed. Nothing can replay it, and keeping it would stop every commit. */
+      if( _interrupted.valid() )
+      {
+         std::vector<std::string> names;
+         for( const auto& item : _interrupted->writes )
+            names.push_back( item.first );
+         elog( "discarding interrupted writes to databases that were never attached: ${names}", ("names",names) );
+         _records.remove( journal_record_key, true );
+         _interrupted.reset();
+      }
+
+      set_deferring( true );
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void write_journal::commit( bool sync )
+   { try {
+      FC_ASSERT( _deferring );
+
+      journal_record record;
+      for( const auto& item : _databases )
+      {
+         std::vector<journal_write> writes;
+         item.second->collect_writes( writes );
+         if( !writes.empty() )
+            record.writes[ item.first ] = std::move( writes );
+      }
+      set_deferring( false );
+
+      if( record.writes.empty() )
+         return;
+
+      /* A single database applies its writes in one batch, which needs no journal record */
+      const bool journaled = record.writes.size() > 1;
+      if( journaled )
+         _records.store( journal_record_key, record, sync );
+      for( const auto& name : _attach_order )
+      {
+         const auto itr = record.writes.find( name );
+         if( itr != record.writes.end() )
+            _databases.at( name )->apply_writes( itr->second, false );
+      }
+      if( journaled )
+         _records.remove( journal_record_key );
+   } FC_CAPTURE_AND_RETHROW( (sync) ) }
+
+   void write_journal::set_deferring( bool deferring )
+   {
+      _deferring = deferring;
+      for( const auto& item : _databases )
+         item.second->_writes_deferred = deferring;
+   }
+
+} } // bts::db
@@ -1,5 +1,6 @@
 #include <bts/mail/client.hpp>
 #include <bts/mail/exceptions.hpp>
+#include <bts/mail/proof_of_work.hpp>
 #include <bts/mail/server.hpp>
 #include <bts/db/level_map.hpp>
 #include <bts/db/cached_level_map.hpp>
@@ -131,7 +132,7 @@ public:
 
     job_queue _transmit_message_jobs;
     fc::future<void> _transmit_message_worker;
-    fc::thread _proof_of_work_thread;
+    proof_of_work_engine _proof_of_work_engine;
 
     fc::future<void> _archive_indexing_future;
     fc::thread _archive_indexing_thread;
@@ -180,7 +181,6 @@ public:
         : self(self),
           _wallet(wallet),
           _chain(chain),
-          _proof_of_work_thread("Mail client proof-of-work thread"),
           _archive_indexing_thread("Mail client indexing thread")
     {}
     ~client_impl(){
@@ -363,28 +363,22 @@ public:
                 return;
             }
 
-            std::unique_ptr<fc::future<void>> slave_handle_uptr(new fc::future<void>());
-            fc::future<void>* slave_handle = slave_handle_uptr.get();
             while (_processing_db.fetch(message_id).status != client::canceled &&
                    email->content.id() > email->proof_of_work_target) {
                 email->content.timestamp = blockchain::now();
                 _processing_db.store(email->id, *email);
 
-                try {
-                    *slave_handle = _proof_of_work_thread.async([email, slave_handle] {
-                        fc::time_point start_time = fc::time_point::now();
-                        while (!slave_handle->canceled() &&
-                               fc::time_point::now() - start_time < fc::seconds(1) &&
-                               email->content.id() > email->proof_of_work_target)
-                            ++email->content.nonce;
-                    }, "Mail client proof-of-work worker");
-
-                    slave_handle->wait();
-                } catch (fc::canceled_exception&) {
-                    slave_handle->cancel();
-                    _proof_of_work_thread.quit();
-                    throw;
-                }
+                //Search for a second at a time so that cancellation and the timestamp are checked regularly
+                proof_of_work_result result = _proof_of_work_engine.search(email->content,
+                                                                           email->proof_of_work_target,
+                                                                           fc::seconds(1));
+                ilog("Proof-of-work for message ${id}: ${n} attempts at ${rate} attempts/sec on ${t} threads",
+                     ("id", message_id)("n", result.attempts)("rate", result.attempts_per_second())
+                     ("t", _proof_of_work_engine.thread_count()));
+                if (result.nonce)
+                    email->content.nonce = *result.nonce;
+                else
+                    email->content.nonce += result.attempts;
             }
 
             if (_processing_db.fetch(message_id).status == client::canceled) {
@@ -0,0 +1,50 @@
+#pragma once
+#include <bts/mail/message.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <memory>
+
+namespace bts { namespace mail {
+
+   struct proof_of_work_result
+   {
+      /** set if a nonce giving an id at or below the target was found */
+      fc::optional<uint64_t>  nonce;
+      uint64_t                attempts = 0;
+      fc::microseconds        elapsed;
+
+      double attempts_per_second()const;
+   };
+
+   /**
+    *  Searches for a message nonce whose id meets a proof-of-work target on several threads at once.
+    *
+    *  The message is serialized once, after which every attempt only overwrites the nonce in that
+    *  serialization and hashes it, rather than serializing the whole message again for each nonce.
+    *  Each thread takes every num_threads'th nonce from the starting nonce, so no two threads ever
+    *  try the same one.
+    */
+   class proof_of_work_engine
+   {
+      public:
+         /** num_threads of 0 uses one thread per core */
+         proof_of_work_engine( uint32_t num_threads = 0 );
+         ~proof_of_work_engine();
+
+         /**
+          *  Tries nonces from msg.nonce upwards until one is found or time_limit has passed. msg is not
+          *  modified; the nonce found is returned in the result.
+          */
+         proof_of_work_result search( const message& msg, const message_id_type& target, const fc::microseconds& time_limit );
+
+         uint32_t thread_count()const { return _threads.size(); }
+
+      private:
+         std::vector<std::unique_ptr<fc::thread>> _threads;
+   };
+
+} } // bts::mail
+
+FC_REFLECT( bts::mail::proof_of_work_result, (nonce)(attempts)(elapsed) )
@@ -0,0 +1,99 @@
+#include <bts/mail/proof_of_work.hpp>
+
+#include <fc/crypto/ripemd160.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace bts { namespace mail {
+
+   double proof_of_work_result::attempts_per_second()const
+   {
+      if( elapsed.count() <= 0 ) return 0;
+      return attempts / (elapsed.count() / 1000000.0);
+   }
+
+   proof_of_work_engine::proof_of_work_engine( uint32_t num_threads )
+   {
+      if( num_threads == 0 )
+         num_threads = std::max( 1u, std::thread::hardware_concurrency() );
+      for( uint32_t i = 0; i < num_threads; ++i )
+         _threads.emplace_back( new fc::thread( "Mail proof-of-work thread " + std::to_string( i ) ) );
+   }
+
+   proof_of_work_engine::~proof_of_work_engine()
+   {
+      for( const auto& thread : _threads )
+         thread->quit();
+   }
+
+   proof_of_work_result proof_of_work_engine::search( const message& msg, const message_id_type& target,
+                                                      const fc::microseconds& time_limit )
+   { try {
+      /* message::id() hashes the packed message, in which the nonce follows the type and recipient */
+      const std::vector<char> packed = fc::raw::pack( msg );
+      const size_t nonce_offset = fc::raw::pack_size( msg.type ) + fc::raw::pack_size( msg.recipient );
+      FC_ASSERT( nonce_offset + sizeof( msg.nonce ) <= packed.size() );
+
+      const fc::time_point start = fc::time_point::now();
+      const fc::time_point deadline = start + time_limit;
+      const uint64_t num_threads = _threads.size();
+
+      std::atomic<bool> found( false );
+      std::vector<uint64_t> attempts( num_threads, 0 );
+      std::vector<fc::optional<uint64_t>> nonces( num_threads );
+
+      std::vector<fc::future<void>> workers;
+      workers.reserve( num_threads );
+      for( uint64_t i = 0; i < num_threads; ++i )
+      {
+         workers.push_back( _threads[ i ]->async( [&, i]()
+         {
+            std::vector<char> buffer = packed;
+            char* const nonce_bytes = buffer.data() + nonce_offset;
+            for( uint64_t nonce = msg.nonce + i; !found; nonce += num_threads )
+            {
+               std::memcpy( nonce_bytes, &nonce, sizeof( nonce ) );
+               ++attempts[ i ];
+               if( !( fc::ripemd160::hash( buffer.data(), buffer.size() ) > target ) )
+               {
+                  nonces[ i ] = nonce;
+                  found = true;
+                  return;
+               }
+               /* Reading the clock is far more expensive than an attempt on short messages */
+               if( attempts[ i ] % 1024 == 0 && fc::time_point::now() >= deadline )
+                  return;
+            }
+         }, "proof_of_work_engine::search" ) );
+      }
+
+      try
+      {
+         for( auto& worker : workers )
+            worker.wait();
+      }
+      catch( ... )
+      {
+         /* The workers reference this frame, so they must finish before it is unwound */
+         found = true;
+         for( auto& worker : workers )
+         {
+            try { worker.wait(); } catch( ... ) {}
+         }
+         throw;
+      }
+
+      proof_of_work_result result;
+      result.elapsed = fc::time_point::now() - start;
+      for( uint64_t i = 0; i < num_threads; ++i )
+      {
+         result.attempts += attempts[ i ];
+         if( nonces[ i ].valid() && ( !result.nonce.valid() || *nonces[ i ] < *result.nonce ) )
+            result.nonce = nonces[ i ];
+      }
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (target)(time_limit) ) }
+
+} } // bts::mail
@@ -6,6 +6,11 @@
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <deque>
+#include <limits>
+#include <map>
+#include <thread>
+
 namespace bts { namespace net {
 
     namespace detail {
@@ -16,38 +21,284 @@ namespace bts { namespace net {
           std::unique_ptr<fc::tcp_socket> _client_socket;
           std::vector<fc::ip::endpoint> _chain_servers;
 
+          /** Number of blocks requested from a server with a single get_blocks_in_range command */
+          static const uint32_t range_size = 500;
+          /** Number of ranges each server connection has requested but not yet received */
+          static const uint32_t ranges_per_server = 2;
+          /** Fetching stops getting ahead of the blocks handed to the callback by this many blocks */
+          static const uint32_t max_blocks_buffered = 16 * range_size;
+
+          struct block_range {
+              uint32_t first;
+              uint32_t count;
+          };
+
+          /** A connection to a chain server supporting extension level 1 or later, used to fetch block ranges */
+          struct range_server {
+              std::unique_ptr<fc::tcp_socket> socket;
+              uint32_t head_block_number = 0;
+          };
+
+          /** State of a range download, shared between the fetching fibers and the delivering one */
+          struct range_download {
+              uint32_t target_block_number = 0;
+              uint32_t next_range_first = 0;
+              uint32_t next_block_to_deliver = 0;
+              std::deque<block_range> retry_ranges;
+              std::map<uint32_t, fc::future<blockchain::full_block>> unpacked_blocks;
+              std::vector<std::unique_ptr<fc::thread>> unpack_threads;
+              uint32_t blocks_unpacked = 0;
+          };
+
+          /**
+           * Connects to server, returning an open socket and the server's protocol version on success, or a closed
+           * socket if the server could not be reached or speaks a newer protocol than we do.
+           */
+          std::unique_ptr<fc::tcp_socket> open_connection(const fc::ip::endpoint& server, uint32_t& protocol_version)
+          {
+              std::unique_ptr<fc::tcp_socket> socket(new fc::tcp_socket);
+              try
+              {
+                  ilog("Attempting to connect to chain server ${s}", ("s",server));
+                  socket->connect_to(server);
+              }
+              catch ( const fc::canceled_exception& )
+              {
+                  throw;
+              }
+              catch (const fc::exception& e) {
+                  wlog("Failed to connect to chain_server: ${e}", ("e", e.to_detail_string()));
+                  socket->close();
+                  return socket;
+              }
+
+              protocol_version = -1;
+              fc::raw::unpack(*socket, protocol_version);
+              if (protocol_version > PROTOCOL_VERSION) {
+                  wlog("Can't talk to chain server; he's using protocol ${srv} and I'm using ${cli}!",
+                       ("srv", protocol_version)("cli", PROTOCOL_VERSION));
+                  fc::raw::pack(*socket, finish);
+                  socket->close();
+              }
+              return socket;
+          }
+
+          /**
+           * Asks a connected server which optional commands it supports. Servers that predate get_extension_level
+           * ignore it and only answer the get_blocks_from_number that follows, which asks for no blocks, with a 0.
+           * @return The server's extension level, or 0 if it supports no optional commands
+           */
+          uint32_t get_server_extension_level(fc::tcp_socket& socket)
+          {
+              fc::raw::pack(socket, get_extension_level);
+              fc::raw::pack(socket, get_blocks_from_number);
+              fc::raw::pack(socket, std::numeric_limits<uint32_t>::max());
+
+              uint32_t reply = 0;
+              fc::raw::unpack(socket, reply);
+              if (reply == 0)
+                  return 0;
+
+              uint32_t blocks_sent = 0;
+              fc::raw::unpack(socket, blocks_sent);
+              FC_ASSERT(blocks_sent == 0, "unexpected reply to extension level probe");
+              return reply;
+          }
+
           void connect_to_chain_server()
           { try {
               _client_socket = std::unique_ptr<fc::tcp_socket>(new fc::tcp_socket);
               while(!_client_socket->is_open() && !_chain_servers.empty()) {
                   auto next_server = _chain_servers.back();
                   _chain_servers.pop_back();
-                  _client_socket = std::unique_ptr<fc::tcp_socket>(new fc::tcp_socket);
-                  try
-                  {
-                      ilog("Attempting to connect to chain server ${s}", ("s",next_server));
-                      _client_socket->connect_to(next_server);
+                  uint32_t protocol_version = 0;
+                  _client_socket = open_connection(next_server, protocol_version);
+              }
+          } FC_RETHROW_EXCEPTIONS(error, "") }
+
+          /** Claims the next range server can provide, or returns false if there is none yet */
+          bool claim_range(range_download& download, const range_server& server, block_range& range)
+          {
+              for (auto itr = download.retry_ranges.begin(); itr != download.retry_ranges.end(); ++itr) {
+                  if (itr->first <= server.head_block_number) {
+                      range = *itr;
+                      download.retry_ranges.erase(itr);
+                      return true;
                   }
-                  catch ( const fc::canceled_exception& )
-                  {
-                      throw;
+              }
+
+              if (download.next_range_first > download.target_block_number ||
+                  download.next_range_first > server.head_block_number ||
+                  download.next_range_first >= download.next_block_to_deliver + max_blocks_buffered)
+                  return false;
+
+              range.first = download.next_range_first;
+              range.count = std::min(range_size, download.target_block_number - range.first + 1);
+              download.next_range_first += range.count;
+              return true;
+          }
+
+          /**
+           * Requests ranges from a single server, keeping several requests in flight, and hands the raw blocks to the
+           * unpacking threads. Ranges that were requested but not received are put back for another server.
+           */
+          void fetch_ranges(range_download& download, range_server& server)
+          {
+              std::deque<block_range> in_flight;
+              try {
+                  while (true) {
+                      block_range range;
+                      while (in_flight.size() < ranges_per_server && claim_range(download, server, range)) {
+                          fc::raw::pack(*server.socket, get_blocks_in_range);
+                          fc::raw::pack(*server.socket, range.first);
+                          fc::raw::pack(*server.socket, range.count);
+                          in_flight.push_back(range);
+                      }
+
+                      if (in_flight.empty()) {
+                          // Done once everything this server has left to offer was claimed
+                          if (download.next_range_first > server.head_block_number &&
+                              std::none_of(download.retry_ranges.begin(), download.retry_ranges.end(),
+                                           [&](const block_range& r) { return r.first <= server.head_block_number; }))
+                              break;
+                          fc::usleep(fc::milliseconds(10));
+                          continue;
+                      }
+
+                      block_range& current = in_flight.front();
+                      uint32_t blocks_sent = 0;
+                      fc::raw::unpack(*server.socket, blocks_sent);
+                      for (uint32_t i = 0; i < blocks_sent; ++i) {
+                          auto packed_block = std::make_shared<std::vector<char>>();
+                          fc::raw::unpack(*server.socket, *packed_block);
+
+                          fc::thread& unpack_thread = *download.unpack_threads[download.blocks_unpacked++ % download.unpack_threads.size()];
+                          download.unpacked_blocks[current.first] = unpack_thread.async([packed_block]() {
+                              return fc::raw::unpack<blockchain::full_block>(*packed_block);
+                          }, "unpack_block");
+                          ++current.first;
+                          --current.count;
+                      }
+
+                      if (current.count > 0) {
+                          // The server's head is behind the others, let one of them provide the rest
+                          server.head_block_number = std::min(server.head_block_number, current.first - 1);
+                          download.retry_ranges.push_back(current);
+                      }
+                      in_flight.pop_front();
                   }
-                  catch (const fc::exception& e) {
-                      wlog("Failed to connect to chain_server: ${e}", ("e", e.to_detail_string()));
-                      _client_socket->close();
-                      continue;
+                  fc::raw::pack(*server.socket, finish);
+              }
+              catch (const fc::canceled_exception&) {
+                  throw;
+              }
+              catch (const fc::exception& e) {
+                  wlog("Failed to fetch blocks from ${remote}: ${e}",
+                       ("remote", server.socket->remote_endpoint())("e", e.to_detail_string()));
+                  download.retry_ranges.insert(download.retry_ranges.end(), in_flight.begin(), in_flight.end());
+              }
+              server.socket->close();
+          }
+
+          /**
+           * Downloads blocks from first_block_number up to the highest head block of the chain servers supporting
+           * extension level 1, fetching ranges from all of them at once, and hands them to new_block_callback in order.
+           * Stops early if the servers stall or a block fails to unpack, leaving the rest to the streaming path.
+           * @return The number of the first block that was not delivered
+           */
+          uint32_t get_block_ranges(const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                    uint32_t first_block_number)
+          {
+              if (first_block_number == 0) first_block_number = 1;
+
+              std::vector<range_server> servers;
+              range_download download;
+              for (const auto& endpoint : _chain_servers) {
+                  try {
+                      range_server server;
+                      uint32_t protocol_version = 0;
+                      server.socket = open_connection(endpoint, protocol_version);
+                      if (!server.socket->is_open())
+                          continue;
+                      if (get_server_extension_level(*server.socket) < 1) {
+                          fc::raw::pack(*server.socket, finish);
+                          server.socket->close();
+                          continue;
+                      }
+                      fc::raw::pack(*server.socket, get_head_block_number);
+                      fc::raw::unpack(*server.socket, server.head_block_number);
+                      download.target_block_number = std::max(download.target_block_number, server.head_block_number);
+                      servers.push_back(std::move(server));
                   }
+                  catch (const fc::canceled_exception&) {
+                      throw;
+                  }
+                  FC_CAPTURE_AND_LOG((endpoint))
+              }
+              if (servers.empty() || download.target_block_number < first_block_number)
+                  return first_block_number;
+
+              ulog("Starting fast-sync of blocks ${first} to ${last} from ${n} chain servers",
+                   ("first", first_block_number)("last", download.target_block_number)("n", servers.size()));
+              auto start_time = fc::time_point::now();
+
+              download.next_range_first = first_block_number;
+              download.next_block_to_deliver = first_block_number;
+              const uint32_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+              for (uint32_t i = 0; i < num_threads; ++i)
+                  download.unpack_threads.emplace_back(new fc::thread("chain_downloader unpack"));
+
+              std::vector<fc::future<void>> fetchers;
+              for (auto& server : servers)
+                  fetchers.push_back(fc::async([&download, &server, this]{ fetch_ranges(download, server); }, "fetch_ranges"));
 
-                  uint32_t protocol_version = -1;
-                  fc::raw::unpack(*_client_socket, protocol_version);
-                  if (protocol_version != PROTOCOL_VERSION) {
-                      wlog("Can't talk to chain server; he's using protocol ${srv} and I'm using ${cli}!",
-                           ("srv", protocol_version)("cli", PROTOCOL_VERSION));
-                      fc::raw::pack(*_client_socket, finish);
-                      _client_socket->close();
+              try {
+                  auto last_progress = fc::time_point::now();
+                  while (download.next_block_to_deliver <= download.target_block_number) {
+                      auto itr = download.unpacked_blocks.find(download.next_block_to_deliver);
+                      if (itr == download.unpacked_blocks.end()) {
+                          bool fetching = std::any_of(fetchers.begin(), fetchers.end(),
+                                                      [](const fc::future<void>& f) { return !f.ready(); });
+                          if (!fetching || fc::time_point::now() - last_progress > fc::seconds(30)) {
+                              wlog("Fast-sync stalled waiting for block ${num}", ("num", download.next_block_to_deliver));
+                              break;
+                          }
+                          fc::usleep(fc::milliseconds(10));
+                          continue;
+                      }
+
+                      blockchain::full_block block;
+                      try {
+                          block = itr->second.wait();
+                      }
+                      catch (const fc::canceled_exception&) {
+                          throw;
+                      }
+                      catch (const fc::exception& e) {
+                          // Leave this block and the rest to the get_blocks_from_number stream
+                          wlog("Failed to unpack fast-synced block ${num}: ${e}",
+                               ("num", download.next_block_to_deliver)("e", e.to_detail_string()));
+                          break;
+                      }
+                      download.unpacked_blocks.erase(itr);
+                      new_block_callback(block, download.target_block_number - download.next_block_to_deliver + 1);
+                      ++download.next_block_to_deliver;
+                      last_progress = fc::time_point::now();
                   }
+              } catch (...) {
+                  for (auto& fetcher : fetchers)
+                      fetcher.cancel_and_wait();
+                  throw;
               }
-          } FC_RETHROW_EXCEPTIONS(error, "") }
+
+              for (auto& fetcher : fetchers)
+                  fetcher.cancel_and_wait();
+
+              const uint32_t blocks_in = download.next_block_to_deliver - first_block_number;
+              ulog("Finished fast-syncing ${num} blocks at ${rate} blocks/sec.",
+                   ("num", blocks_in)("rate", blocks_in/((fc::time_point::now() - start_time).count() / 1000000.0)));
+              return download.next_block_to_deliver;
+          }
 
           void get_all_blocks(std::function<void (const blockchain::full_block&, uint32_t)> new_block_callback,
                               uint32_t first_block_number)
@@ -55,6 +306,9 @@ namespace bts { namespace net {
               if (!new_block_callback)
                   return;
 
+              // Fetch as much as we can in parallel, then stream whatever is left and keep up with new blocks
+              first_block_number = get_block_ranges(new_block_callback, first_block_number);
+
               fc::future<void> work_future;
               while(!_chain_servers.empty()) {
                  try {
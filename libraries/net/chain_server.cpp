@@ -70,6 +70,22 @@ namespace bts { namespace net {
                 }
             }
 
+            /** Blocks are collected into a buffer of about this many bytes before it is written to the socket */
+            static const size_t send_buffer_size = 1024 * 1024;
+
+            template<typename T>
+            static void append_packed(std::vector<char>& buffer, const T& value) {
+                const auto packed = fc::raw::pack(value);
+                buffer.insert(buffer.end(), packed.begin(), packed.end());
+            }
+
+            static void send_buffer(fc::tcp_socket& connection_socket, std::vector<char>& buffer) {
+                if (buffer.empty())
+                    return;
+                connection_socket.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+
             void handle_get_blocks_from_number(fc::tcp_socket& connection_socket) {
               try {
                 uint32_t start_block;
@@ -77,23 +93,61 @@ namespace bts { namespace net {
                 if (start_block == 0) start_block = 1;
                 uint32_t end_block = start_block;
 
+                std::vector<char> buffer;
+                buffer.reserve(send_buffer_size);
                 while (end_block <= _chain_db->get_head_block_num()) {
                     end_block = _chain_db->get_head_block_num();
                     auto blocks_to_send = end_block - start_block + 1;
-                    fc::raw::pack(connection_socket, blocks_to_send);
+                    append_packed(buffer, blocks_to_send);
 
                     ilog("Sending blocks from ${start} to ${finish} to ${remote}",
                          ("start", start_block)("finish", end_block)("remote", connection_socket.remote_endpoint()));
                     for (; start_block <= end_block; ++start_block) {
-                        fc::raw::pack(connection_socket, _chain_db->get_block(start_block));
-                        if (start_block % 10 == 0)
+                        // The stored block is already in the wire format
+                        const auto packed_block = _chain_db->get_packed_block(start_block);
+                        buffer.insert(buffer.end(), packed_block.begin(), packed_block.end());
+                        if (buffer.size() >= send_buffer_size) {
+                            send_buffer(connection_socket, buffer);
                             fc::yield();
+                        }
                     }
                     end_block = start_block;
                 }
 
                 // Now sending zero more blocks...
-                fc::raw::pack(connection_socket, uint32_t(0));
+                append_packed(buffer, uint32_t(0));
+                send_buffer(connection_socket, buffer);
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
+            void handle_get_head_block_number(fc::tcp_socket& connection_socket) {
+              try {
+                fc::raw::pack(connection_socket, _chain_db->get_head_block_num());
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
+            void handle_get_blocks_in_range(fc::tcp_socket& connection_socket) {
+              try {
+                uint32_t start_block;
+                uint32_t block_count;
+                fc::raw::unpack(connection_socket, start_block);
+                fc::raw::unpack(connection_socket, block_count);
+                if (start_block == 0) start_block = 1;
+
+                const uint32_t head_block = _chain_db->get_head_block_num();
+                const uint32_t blocks_to_send = start_block > head_block ? 0 : std::min(block_count, head_block - start_block + 1);
+
+                std::vector<char> buffer;
+                buffer.reserve(send_buffer_size);
+                append_packed(buffer, blocks_to_send);
+                for (uint32_t block_num = start_block; block_num < start_block + blocks_to_send; ++block_num) {
+                    append_packed(buffer, _chain_db->get_packed_block(block_num));
+                    if (buffer.size() >= send_buffer_size) {
+                        send_buffer(connection_socket, buffer);
+                        fc::yield();
+                    }
+                }
+                send_buffer(connection_socket, buffer);
               } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
             }
 
@@ -111,6 +165,15 @@ namespace bts { namespace net {
                       case get_blocks_from_number:
                         handle_get_blocks_from_number(*connection_socket);
                         break;
+                      case get_head_block_number:
+                        handle_get_head_block_number(*connection_socket);
+                        break;
+                      case get_blocks_in_range:
+                        handle_get_blocks_in_range(*connection_socket);
+                        break;
+                      case get_extension_level:
+                        fc::raw::pack(*connection_socket, EXTENSION_LEVEL);
+                        break;
                       case finish:
                         break;
                     }
@@ -26,6 +26,22 @@ namespace bts { namespace net {
      *      full_block objects. When the server has finished sending these blocks, it repeats the procedure for
      *      any new blocks which have been made in the interim, so another count is sent, followed by that number
      *      of blocks. When the server sends a count of 0, there are no blocks, and the command is complete.
+     * * get_extension_level
+     *      This command takes no arguments. The server responds with a nonzero uint32_t level of the optional
+     *      commands it supports. Servers predating this command silently ignore it, as they do every command they do
+     *      not know, so a client should follow it with get_blocks_from_number for a block past any head: a reply of 0
+     *      then means the server supports no extensions, and anything else is the level, followed by the 0 ending
+     *      get_blocks_from_number.
+     * * get_head_block_number (extension level 1)
+     *      This command takes no arguments. The server responds with the number of its head block.
+     * * get_blocks_in_range (extension level 1)
+     *      This command takes two arguments, the number of the first block to retrieve and the number of blocks to
+     *      retrieve. The server responds with a uint32_t count of blocks it will send, which is less than requested if
+     *      the range extends past its head block, followed by the blocks. Each block is sent as a packed
+     *      std::vector<char> holding the packed full_block, so that the client can split the stream into blocks
+     *      without unpacking them.
+     *
+     * Blocks are sent exactly as they are stored in the server's database, without being unpacked first.
      *
      * All block numbers are of type uint32_t
      */
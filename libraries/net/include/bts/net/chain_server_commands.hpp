@@ -8,13 +8,19 @@
 #include <fc/reflect/reflect.hpp>
 
 const static uint32_t PROTOCOL_VERSION = 0;
+/** Level of the optional commands a server reports in response to get_extension_level */
+const static uint32_t EXTENSION_LEVEL = 1;
 
 namespace bts { namespace net { namespace detail {
     enum chain_server_commands {
         finish = 0,
-        get_blocks_from_number
+        get_blocks_from_number,
+        // Extension level 1; servers which do not report it ignore these
+        get_head_block_number,
+        get_blocks_in_range,
+        get_extension_level
     };
 } } } //namespace bts::net::detail
 
-FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number))
+FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number)(get_head_block_number)(get_blocks_in_range)(get_extension_level))
 FC_REFLECT_TYPENAME(bts::net::detail::chain_server_commands)
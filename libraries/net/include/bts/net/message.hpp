@@ -6,6 +6,9 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstring>
+#include <memory>
+
 namespace bts { namespace net {
 
   /**
@@ -87,6 +90,69 @@ namespace bts { namespace net {
      }
   };
 
+  /**
+   *  A message serialized once in the form it is sent on the wire: the header, the data and
+   *  zero padding up to a multiple of 16 bytes for the cipher.  It is never modified after it
+   *  is packed, so a single packed_message_ptr can sit in the send queue of every peer at once
+   *  instead of each queue holding its own copy.
+   */
+  class packed_message
+  {
+  public:
+     explicit packed_message( const message& m )
+     :_buffer( 16 * ((sizeof(message_header) + m.size + 15) / 16), 0 )
+     {
+        memcpy( _buffer.data(), (const char*)&static_cast<const message_header&>(m), sizeof(message_header) );
+        memcpy( _buffer.data() + sizeof(message_header), m.data.data(), m.size );
+     }
+
+     uint32_t    msg_type()const { return header().msg_type; }
+     /** the size of the message data, excluding the header and padding */
+     uint32_t    size()const     { return header().size; }
+
+     /** the bytes to send, padded_size() of them */
+     const char* data()const        { return _buffer.data(); }
+     size_t      padded_size()const { return _buffer.size(); }
+
+     fc::uint160_t id()const
+     {
+        return fc::ripemd160::hash( _buffer.data() + sizeof(message_header), size() );
+     }
+
+     /** unpacks a modifiable copy of the message */
+     message to_message()const
+     {
+        message result;
+        static_cast<message_header&>(result) = header();
+        result.data.assign( _buffer.data() + sizeof(message_header), _buffer.data() + sizeof(message_header) + size() );
+        return result;
+     }
+
+     /** deserializes T straight from the packed buffer, see message::as() */
+     template<typename T>
+     T as()const
+     {
+         try {
+          FC_ASSERT( msg_type() == T::type );
+          T tmp;
+          fc::datastream<const char*> ds( size() ? _buffer.data() + sizeof(message_header) : nullptr, size() );
+          fc::raw::unpack( ds, tmp );
+          return tmp;
+         } FC_RETHROW_EXCEPTIONS( warn,
+              "error unpacking network message as a '${type}'  ${x} !=? ${msg_type}",
+              ("type", fc::get_typename<T>::name() )
+              ("x", T::type)
+              ("msg_type", msg_type())
+              );
+     }
+
+  private:
+     const message_header& header()const { return *reinterpret_cast<const message_header*>( _buffer.data() ); }
+
+     std::vector<char> _buffer;
+  };
+  typedef std::shared_ptr<const packed_message> packed_message_ptr;
+
 } } // bts::net
 
 
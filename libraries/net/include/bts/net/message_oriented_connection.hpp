@@ -28,6 +28,8 @@ namespace bts { namespace net {
     void connect_to(const fc::ip::endpoint& remote_endpoint);
 
     void send_message(const message& message_to_send);
+    /** sends the already padded buffer as is, nothing is copied before it is encrypted */
+    void send_message(const packed_message& message_to_send);
     void close_connection();
     void destroy_connection();
 
@@ -88,13 +88,13 @@ namespace bts { namespace net
 
       struct queued_message
       {
-        message        message_to_send;
+        packed_message_ptr message_to_send; // may be queued for other peers too, never modified
         size_t         message_send_time_field_offset;
         fc::time_point enqueue_time;
         fc::time_point transmission_start_time;
         fc::time_point transmission_finish_time;
 
-        queued_message(message message_to_send, 
+        queued_message(packed_message_ptr message_to_send, 
                        size_t message_send_time_field_offset = (size_t)-1, 
                        fc::time_point enqueue_time = fc::time_point::now()) :
           message_to_send(std::move(message_to_send)),
@@ -221,6 +221,8 @@ namespace bts { namespace net
       void on_connection_closed(message_oriented_connection* originating_connection) override;
 
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      /** queues a message that was packed once to be sent to several peers */
+      void send_message(const packed_message_ptr& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
       void close_connection();
       void destroy_connection();
 
@@ -55,7 +55,7 @@ namespace bts { namespace net {
                                        message_oriented_connection_delegate* delegate = nullptr);
       ~message_oriented_connection_impl();
 
-      void send_message(const message& message_to_send);
+      void send_message(const packed_message& message_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -203,7 +203,7 @@ namespace bts { namespace net {
         throw *exception_to_rethrow;
     }
 
-    void message_oriented_connection_impl::send_message(const message& message_to_send)
+    void message_oriented_connection_impl::send_message(const packed_message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
@@ -232,15 +232,11 @@ namespace bts { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        // the packed message is already padded to a multiple of 16 bytes, _sock encrypts it
+        // into its own write buffer a piece at a time
+        _sock.write(message_to_send.data(), message_to_send.padded_size());
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += message_to_send.padded_size();
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
@@ -342,6 +338,11 @@ namespace bts { namespace net {
   }
 
   void message_oriented_connection::send_message(const message& message_to_send)
+  {
+    my->send_message(packed_message(message_to_send));
+  }
+
+  void message_oriented_connection::send_message(const packed_message& message_to_send)
   {
     my->send_message(message_to_send);
   }
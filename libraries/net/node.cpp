@@ -108,16 +108,16 @@ namespace bts { namespace net {
       struct block_clock_index{};
       struct message_info
       {
-        message_hash_type message_hash;
-        message           message_body;
-        uint32_t          block_clock_when_received;
+        message_hash_type  message_hash;
+        packed_message_ptr message_body; // shared with the send queues of the peers it is sent to
+        uint32_t           block_clock_when_received;
 
         // for network performance stats
         message_propagation_data propagation_data;
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      const packed_message_ptr& message_body,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
@@ -149,7 +149,7 @@ namespace bts { namespace net {
       void block_accepted();
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      packed_message_ptr get_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
@@ -168,13 +168,13 @@ namespace bts { namespace net {
                                                      const fc::uint160_t& message_content_hash )
     {
       _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
+                                         std::make_shared<packed_message>( message_to_cache ),
                                          block_clock,
                                          propagation_data,
                                          message_content_hash ) );
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    packed_message_ptr blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
@@ -2454,17 +2454,18 @@ namespace bts { namespace net { namespace detail {
            ( "type", fetch_items_message_received.item_type )
            ( "endpoint", originating_peer->get_remote_endpoint() ) );
 
-      fc::optional<message> last_block_message_sent;
+      packed_message_ptr last_block_message_sent;
 
-      std::list<message> reply_messages;
+      // cached items are packed once and shared by every peer that fetches them
+      std::list<packed_message_ptr> reply_messages;
       for( const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch )
       {
         try
         {
-          message requested_message = _message_cache.get_message( item_hash );
+          packed_message_ptr requested_message = _message_cache.get_message( item_hash );
           dlog( "received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ( "endpoint", originating_peer->get_remote_endpoint() )
-               ( "id", requested_message.id() ) );
+               ( "id", requested_message->id() ) );
           reply_messages.push_back( requested_message );
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
@@ -2478,10 +2479,10 @@ namespace bts { namespace net { namespace detail {
         item_id item_to_fetch( fetch_items_message_received.item_type, item_hash );
         try
         {
-          message requested_message = _delegate->get_item( item_to_fetch );
+          packed_message_ptr requested_message = std::make_shared<packed_message>( _delegate->get_item( item_to_fetch ) );
           dlog( "received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ( "id", requested_message.id() )
-               ( "size", requested_message.size )
+               ( "id", requested_message->id() )
+               ( "size", requested_message->size() )
                ( "endpoint", originating_peer->get_remote_endpoint() ) );
           reply_messages.push_back( requested_message );
           if (fetch_items_message_received.item_type == block_message_type)
@@ -2490,7 +2491,7 @@ namespace bts { namespace net { namespace detail {
         }
         catch ( fc::key_not_found_exception& )
         {
-          reply_messages.push_back( item_not_available_message(item_to_fetch ) );
+          reply_messages.push_back( std::make_shared<packed_message>( message( item_not_available_message(item_to_fetch ) ) ) );
           dlog( "received item request from peer ${endpoint} but we don't have it",
                ( "endpoint", originating_peer->get_remote_endpoint() ) );
         }
@@ -2505,7 +2506,7 @@ namespace bts { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const packed_message_ptr& reply : reply_messages)
         originating_peer->send_message(reply);
     }
 
@@ -238,17 +238,20 @@ namespace bts { namespace net
         {
           dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
                "to send message of type ${type} for peer ${endpoint}",
-               ("type", _queued_messages.front().message_to_send.msg_type)("endpoint", get_remote_endpoint()));
+               ("type", _queued_messages.front().message_to_send->msg_type())("endpoint", get_remote_endpoint()));
           if (_queued_messages.front().message_send_time_field_offset != (size_t)-1)
           {
-            // patch the current time into the message.  Since this operates on the packed version of the structure,
-            // it won't work for anything after a variable-length field
+            // patch the current time into a copy of the message, the packed one may be shared.  Since this operates
+            // on the packed version of the structure, it won't work for anything after a variable-length field
+            message message_to_send = _queued_messages.front().message_to_send->to_message();
             std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
-            assert(_queued_messages.front().message_send_time_field_offset + packed_current_time.size() <= _queued_messages.front().message_to_send.data.size());
-            memcpy(_queued_messages.front().message_to_send.data.data() + _queued_messages.front().message_send_time_field_offset,
+            assert(_queued_messages.front().message_send_time_field_offset + packed_current_time.size() <= message_to_send.data.size());
+            memcpy(message_to_send.data.data() + _queued_messages.front().message_send_time_field_offset,
                    packed_current_time.data(), packed_current_time.size());
+            _message_connection.send_message(message_to_send);
           }
-          _message_connection.send_message(_queued_messages.front().message_to_send);
+          else
+            _message_connection.send_message(*_queued_messages.front().message_to_send);
           dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
                ("endpoint", get_remote_endpoint()));
         }
@@ -279,19 +282,25 @@ namespace bts { namespace net
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
         _queued_messages.front().transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front().message_to_send.size;
+        _total_queued_messages_size -= _queued_messages.front().message_to_send->size();
         _queued_messages.pop();
       }
       dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
     void peer_connection::send_message(const message& message_to_send, size_t message_send_time_field_offset)
+    {
+      VERIFY_CORRECT_THREAD();
+      send_message(std::make_shared<packed_message>(message_to_send), message_send_time_field_offset);
+    }
+
+    void peer_connection::send_message(const packed_message_ptr& message_to_send, size_t message_send_time_field_offset)
     {
       VERIFY_CORRECT_THREAD();
       dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
-           ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
+           ("type", message_to_send->msg_type())("endpoint", get_remote_endpoint()));
       _queued_messages.emplace(queued_message(message_to_send, message_send_time_field_offset));
-      _total_queued_messages_size += message_to_send.size;
+      _total_queued_messages_size += message_to_send->size();
       if (_total_queued_messages_size > BTS_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -1,5 +1,7 @@
 #define DEFAULT_LOGGER "rpc"
 
+#include <bts/api/api_call_stats.hpp>
+#include <bts/blockchain/chain_database.hpp>
 #include <bts/wallet/exceptions.hpp>
 #include <bts/rpc/exceptions.hpp>
 #include <bts/rpc/rpc_server.hpp>
@@ -24,7 +26,9 @@
 
 #include <iomanip>
 #include <limits>
+#include <memory>
 #include <sstream>
+#include <unordered_map>
 
 #include <bts/rpc_stubs/common_api_rpc_server.hpp>
 
@@ -58,11 +62,56 @@ namespace bts { namespace rpc {
          /** the set of connections that have successfully logged in */
          std::unordered_set<fc::rpc::json_connection*> _authenticated_connection_set;
 
+         /** the result of a cached method, serialized once so HTTP replies can embed it as is */
+         struct cached_response
+         {
+            fc::variant   result;
+            std::string   json;
+         };
+
+         /** empties the response cache whenever the chain state changes */
+         class response_cache_invalidator : public bts::blockchain::chain_observer
+         {
+            public:
+               response_cache_invalidator( rpc_server_impl& server ) : _server( server ) {}
+
+               virtual void state_changed( const bts::blockchain::pending_chain_state_ptr& ) override { _server.clear_response_cache(); }
+               virtual void block_applied( const bts::blockchain::block_summary& ) override           { _server.clear_response_cache(); }
+
+            private:
+               rpc_server_impl& _server;
+         };
+
+         /** cleared when full, the key space is whatever parameters callers send */
+         static const size_t                                max_cached_responses = 1000;
+
+         /** results of methods flagged "cached" keyed by method name and parameters */
+         std::unordered_map<std::string, std::shared_ptr<const cached_response>> _response_cache;
+         /** head block the cached responses were computed at, observers are notified asynchronously */
+         bts::blockchain::block_id_type                     _response_cache_head_block_id;
+         /** bumped on every clear, a result computed across a clear is not stored */
+         uint64_t                                           _response_cache_generation = 0;
+         response_cache_invalidator                         _response_cache_invalidator;
+         bool                                               _observing_chain = false;
+
          rpc_server_impl(bts::client::client* client) :
            _client(client),
-           _on_quit_promise(new fc::promise<void>("rpc_quit"))
+           _on_quit_promise(new fc::promise<void>("rpc_quit")),
+           _response_cache_invalidator(*this)
          {}
 
+         void clear_response_cache()
+         {
+            _response_cache.clear();
+            ++_response_cache_generation;
+         }
+
+         ~rpc_server_impl()
+         {
+            if( _observing_chain && _client->get_chain() )
+               _client->get_chain()->remove_observer( &_response_cache_invalidator );
+         }
+
          void shutdown_rpc_server();
 
          virtual bts::api::common_api* get_client() const override;
@@ -202,6 +251,14 @@ namespace bts { namespace rpc {
                   //  dlog( "RPC ${r}", ("r",r.path) );
                     status = handle_http_rpc( r, s );
                 }
+                else if( r.path == fc::path("/metrics") )
+                {
+                    const std::string metrics = bts::api::export_call_statistics();
+                    s.add_header( "Content-Type", "text/plain; version=0.0.4" );
+                    s.set_status( fc::http::reply::OK );
+                    s.set_length( metrics.size() );
+                    s.write( metrics.c_str(), metrics.size() );
+                }
                 else if( _http_file_callback )
                 {
                    _http_file_callback( path, s );
@@ -279,69 +336,160 @@ namespace bts { namespace rpc {
              fc_ilog( fc::logger::get("rpc"), "Completed ${path} ${status} in ${ms}ms", ("path",r.path)("status",(int)status)("ms",(end_time - begin_time).count()/1000));
          }
 
-         fc::http::reply::status_code handle_http_rpc(const fc::http::request& r, const fc::http::server::response& s )
+         /** builds the log text only when the rpc logger will actually write it */
+         static bool rpc_log_enabled()
          {
-                fc::http::reply::status_code status = fc::http::reply::OK;
-                std::string str(r.body.data(),r.body.size());
-                //wlog( "RPC: ${r}", ("r",str) );
-                fc::string method_name;
+                return fc::logger::get("rpc").is_enabled( fc::log_level::info );
+         }
 
-                fc::optional<std::string> invalid_rpc_request_message;
+         /**
+          *  Executes a single JSON-RPC call object and returns its serialized response object. status is set
+          *  to the HTTP status the call would have been answered with on its own.
+          */
+         std::string execute_http_rpc_call( const fc::http::request& r, const fc::variant_object& rpc_call,
+                                            fc::http::reply::status_code& status )
+         {
+                fc::mutable_variant_object result;
+                result["id"] = rpc_call.contains( "id" ) ? rpc_call["id"] : fc::variant();
 
-                try {
-                   auto rpc_call = fc::json::from_string( str ).get_object();
-                   method_name = rpc_call["method"].as_string();
-                   auto params = rpc_call["params"].get_array();
-                   auto params_log = fc::json::to_string(rpc_call["params"]);
+                const fc::string method_name = rpc_call["method"].as_string();
+                const auto params = rpc_call.contains( "params" ) ? rpc_call["params"].get_array() : fc::variants();
+                if( rpc_log_enabled() )
+                {
+                   auto params_log = fc::json::to_string( params );
                    if(method_name.find("wallet") != std::string::npos || method_name.find("priv") != std::string::npos)
                        params_log = "***";
                    fc_ilog( fc::logger::get("rpc"), "Processing ${path} ${method} (${params})", ("path",r.path)("method",method_name)("params",params_log));
+                }
 
-                   auto call_itr = _alias_map.find( method_name );
-                   if( call_itr != _alias_map.end() )
+                auto call_itr = _alias_map.find( method_name );
+                if( call_itr == _alias_map.end() )
+                {
+                   fc_ilog( fc::logger::get("rpc"), "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
+                   elog( "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
+                   status = fc::http::reply::NotFound;
+                   result["error"] = fc::mutable_variant_object( "message", "Invalid Method: " + method_name );
+                   return fc::json::to_string( result );
+                }
+
+                try
+                {
+                   const bts::api::method_data& method_data = _method_map[call_itr->second];
+                   if( method_data.cached )
                    {
-                      fc::mutable_variant_object  result;
-                      result["id"]     =  rpc_call["id"];
-                      try
-                      {
-                         result["result"] = dispatch_authenticated_method(_method_map[call_itr->second], params);
-                         auto reply = fc::json::to_string( result );
-                         status = fc::http::reply::OK;
-                         s.set_status( status );
-                      }
-                      catch ( const fc::canceled_exception& )
-                      {
-                          throw;
-                      }
-                      catch ( const fc::exception& e )
-                      {
-                          status = fc::http::reply::InternalServerError;
-                          s.set_status( status );
-                          result["error"] = fc::mutable_variant_object("message",e.to_string())( "detail",e.to_detail_string() )("code",e.code());
-                      }
-                      //ilog( "${e}", ("e",result) );
-                      auto reply = fc::json::to_string( result );
-                      s.set_length( reply.size() );
-                      s.write( reply.c_str(), reply.size() );
-                      auto reply_log = reply.size() > 253 ? reply.substr(0,253) + ".." :  reply;
-                      fc_ilog( fc::logger::get("rpc"), "Result ${path} ${method}: ${reply}", ("path",r.path)("method",method_name)("reply",reply_log));
-                      return status;
+                      const auto response = dispatch_cached_method( method_data, params );
+                      status = fc::http::reply::OK;
+                      return "{\"id\":" + fc::json::to_string( result["id"] ) + ",\"result\":" + response->json + "}";
                    }
-                   else
+                   result["result"] = invoke_authenticated_method(method_data, params);
+                   status = fc::http::reply::OK;
+                }
+                catch ( const fc::canceled_exception& )
+                {
+                    throw;
+                }
+                catch ( const fc::exception& e )
+                {
+                    status = fc::http::reply::InternalServerError;
+                    result["error"] = fc::mutable_variant_object("message",e.to_string())( "detail",e.to_detail_string() )("code",e.code());
+                }
+                return fc::json::to_string( result );
+         }
+
+         void log_http_rpc_reply( const fc::http::request& r, const fc::string& method_name, const std::string& reply )
+         {
+                if( !rpc_log_enabled() )
+                   return;
+                auto reply_log = reply.size() > 253 ? reply.substr(0,253) + ".." :  reply;
+                fc_ilog( fc::logger::get("rpc"), "Result ${path} ${method}: ${reply}", ("path",r.path)("method",method_name)("reply",reply_log));
+         }
+
+         /**
+          *  Handles a JSON-RPC 2.0 batch: an array of call objects answered with an array of response
+          *  objects in the same order. Calls without an id are notifications and get no response. Each
+          *  response is serialized once and written straight after the previous one.
+          */
+         fc::http::reply::status_code handle_http_rpc_batch( const fc::http::request& r, const fc::http::server::response& s,
+                                                             const fc::variants& rpc_calls )
+         {
+                FC_ASSERT( !rpc_calls.empty(), "Empty batch" );
+
+                std::vector<std::string> replies;
+                replies.reserve( rpc_calls.size() );
+                for( const auto& call : rpc_calls )
+                {
+                   fc::string method_name;
+                   bool is_notification = false;
+                   std::string reply;
+                   try
+                   {
+                      const auto rpc_call = call.get_object();
+                      is_notification = !rpc_call.contains( "id" );
+                      method_name = rpc_call["method"].as_string();
+                      fc::http::reply::status_code call_status;
+                      reply = execute_http_rpc_call( r, rpc_call, call_status );
+                   }
+                   catch ( const fc::canceled_exception& )
+                   {
+                       throw;
+                   }
+                   catch ( const fc::exception& e )
                    {
-                       fc_ilog( fc::logger::get("rpc"), "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
-                       elog( "Invalid Method ${path} ${method}", ("path",r.path)("method",method_name));
-                       std::string message = "Invalid Method: " + method_name;
-                       fc::mutable_variant_object  result;
-                       result["id"]     =  rpc_call["id"];
-                       status = fc::http::reply::NotFound;
-                       s.set_status( status );
-                       result["error"] = fc::mutable_variant_object( "message", message );
-                       auto reply = fc::json::to_string( result );
-                       s.set_length( reply.size() );
-                       s.write( reply.c_str(), reply.size() );
-                       return status;
+                       reply = fc::json::to_string( fc::mutable_variant_object( "id", fc::variant() )
+                                ( "error", fc::mutable_variant_object( "message", "Invalid RPC Request" )( "detail", e.to_detail_string() ) ) );
                    }
+
+                   if( is_notification )
+                      continue;
+                   replies.push_back( std::move( reply ) );
+                   log_http_rpc_reply( r, method_name, replies.back() );
+                }
+
+                // a batch made only of notifications gets no reply at all, not an empty array
+                s.set_status( fc::http::reply::OK );
+                if( replies.empty() )
+                {
+                   s.set_length( 0 );
+                   return fc::http::reply::OK;
+                }
+
+                size_t length = 1;
+                for( const auto& reply : replies )
+                   length += reply.size() + 1;
+                s.set_length( length );
+                s.write( "[", 1 );
+                for( size_t i = 0; i < replies.size(); ++i )
+                {
+                   if( i > 0 ) s.write( ",", 1 );
+                   s.write( replies[i].c_str(), replies[i].size() );
+                }
+                s.write( "]", 1 );
+                return fc::http::reply::OK;
+         }
+
+         fc::http::reply::status_code handle_http_rpc(const fc::http::request& r, const fc::http::server::response& s )
+         {
+                fc::http::reply::status_code status = fc::http::reply::OK;
+                std::string str(r.body.data(),r.body.size());
+                //wlog( "RPC: ${r}", ("r",str) );
+                fc::string method_name;
+
+                fc::optional<std::string> invalid_rpc_request_message;
+
+                try {
+                   const auto request = fc::json::from_string( str );
+                   if( request.is_array() )
+                      return handle_http_rpc_batch( r, s, request.get_array() );
+
+                   const auto rpc_call = request.get_object();
+                   method_name = rpc_call["method"].as_string();
+                   const auto reply = execute_http_rpc_call( r, rpc_call, status );
+                   s.set_status( status );
+                   s.set_length( reply.size() );
+                   s.write( reply.c_str(), reply.size() );
+                   if( status != fc::http::reply::NotFound )
+                      log_http_rpc_reply( r, method_name, reply );
+                   return status;
                 }
                 catch ( const fc::canceled_exception& )
                 {
@@ -448,6 +596,55 @@ namespace bts { namespace rpc {
 
         fc::variant dispatch_authenticated_method(const bts::api::method_data& method_data,
                                                   const fc::variants& arguments_from_caller)
+        {
+          if (method_data.cached)
+            return dispatch_cached_method(method_data, arguments_from_caller)->result;
+          return invoke_authenticated_method(method_data, arguments_from_caller);
+        }
+
+        /**
+         *  Answers a method flagged "cached" in its api json from the response cache, computing and storing the
+         *  result on a miss. The cache is dropped when the head block moves, either here or by the chain observer.
+         */
+        std::shared_ptr<const cached_response> dispatch_cached_method(const bts::api::method_data& method_data,
+                                                                      const fc::variants& arguments_from_caller)
+        {
+          const bts::blockchain::chain_database_ptr chain = _client->get_chain();
+          if (!_observing_chain)
+          {
+            chain->add_observer(&_response_cache_invalidator);
+            _observing_chain = true;
+          }
+
+          const bts::blockchain::block_id_type head_block_id = chain->get_head_block_id();
+          if (head_block_id != _response_cache_head_block_id)
+          {
+            clear_response_cache();
+            _response_cache_head_block_id = head_block_id;
+          }
+
+          std::string key = method_data.name + "\n" + fc::json::to_string(arguments_from_caller);
+          auto itr = _response_cache.find(key);
+          if (itr != _response_cache.end())
+            return itr->second;
+
+          const uint64_t generation = _response_cache_generation;
+          auto response = std::make_shared<cached_response>();
+          response->result = invoke_authenticated_method(method_data, arguments_from_caller);
+          response->json = fc::json::to_string(response->result);
+
+          // the call may have yielded while the state changed, then the result may already be stale
+          if (generation != _response_cache_generation || chain->get_head_block_id() != head_block_id)
+            return response;
+
+          if (_response_cache.size() >= max_cached_responses)
+            clear_response_cache();
+          _response_cache[std::move(key)] = response;
+          return response;
+        }
+
+        fc::variant invoke_authenticated_method(const bts::api::method_data& method_data,
+                                                const fc::variants& arguments_from_caller)
         {
           fc::scoped_lock<fc::mutex> lock(_rpc_mutex);
 
@@ -2,6 +2,7 @@
 #include <fc/reflect/reflect.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/io/enum_type.hpp>
+#include <fc/variant_object.hpp>
 #include <vector>
 
 namespace bts { namespace vm {
@@ -46,6 +47,8 @@ namespace bts { namespace vm {
 
           void execute( const vector<operation>& ops );
 
+          const fc::variants& get_stack()const { return stack; }
+
           const variant&      get_value( const variant& op_value, uint16_t stack_index )
           {
              return stack_index ? stack[stack.size() - stack_index] : op_value;
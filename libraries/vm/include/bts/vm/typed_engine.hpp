@@ -0,0 +1,82 @@
+#pragma once
+#include <bts/vm/engine.hpp>
+
+#include <fc/variant.hpp>
+
+#include <memory>
+
+namespace bts { namespace vm {
+
+   /**
+    *  Runs the same operations as engine without keeping its stack as variants.
+    *
+    *  Operations are compiled once into a program: each operand is resolved to a fixed slot in a
+    *  register file holding the constants followed by the stack, which is possible because scripts
+    *  have no jumps and so the stack depth at every operation is known in advance. Out of range
+    *  stack references are rejected when compiling rather than checked on every operation.
+    *
+    *  Integers and booleans are stored unboxed; every other value is a shared reference to an
+    *  immutable variant and operations on them fall back to the variant operators, so results are
+    *  the same as engine's.
+    */
+   class typed_engine
+   {
+       public:
+          struct value
+          {
+             enum kind_type : uint8_t
+             {
+                null_kind,
+                int_kind,
+                bool_kind,
+                ref_kind
+             };
+
+             value():kind(null_kind),int_value(0){}
+
+             static value from_variant( const variant& v );
+             variant      to_variant()const;
+
+             kind_type                          kind;
+             union
+             {
+                int64_t                         int_value;
+                bool                            bool_value;
+             };
+             /** strings, objects, arrays and every other type */
+             std::shared_ptr<const variant>     ref;
+          };
+
+          struct instruction
+          {
+             uint16_t code;
+             /** the slot written, or the object modified by SET_CHILD */
+             uint16_t target;
+             uint16_t a;
+             uint16_t b;
+          };
+
+          struct program
+          {
+             /** terminated by an END instruction */
+             vector<instruction>  code;
+             vector<value>        constants;
+             uint16_t             max_depth = 0;
+             uint16_t             final_depth = 0;
+          };
+
+          /** validates ops, which are run against an empty stack, and resolves their operands */
+          static program compile( const vector<engine::operation>& ops );
+
+          void execute( const program& prog );
+
+          /** the stack left by the last execute() */
+          fc::variants get_stack()const;
+
+       private:
+          vector<value> _slots;
+          uint16_t      _stack_base = 0;
+          uint16_t      _stack_depth = 0;
+   };
+
+} } // bts::vm
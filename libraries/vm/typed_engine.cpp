@@ -0,0 +1,333 @@
+#include <bts/vm/typed_engine.hpp>
+
+#include <limits>
+
+#if defined( __GNUC__ )
+#define BTS_VM_COMPUTED_GOTO
+#endif
+
+namespace bts { namespace vm {
+
+   namespace
+   {
+      /* The engine's op codes followed by the end of a program */
+      enum compiled_op_code : uint16_t
+      {
+         ADD = engine::ADD, SUB = engine::SUB, MULT = engine::MULT, DIV = engine::DIV, PUSH = engine::PUSH,
+         LT = engine::LT, GT = engine::GT, LTEQ = engine::LTEQ, GTEQ = engine::GTEQ, EQ = engine::EQ,
+         NEQ = engine::NEQ, NOT_OP = engine::NOT_OP, POP = engine::POP, PUSH_CHILD = engine::PUSH_CHILD,
+         SET_CHILD = engine::SET_CHILD, PUSH_INDEX = engine::PUSH_INDEX, SET_INDEX = engine::SET_INDEX,
+         SET = engine::SET, PUSH_SIZE = engine::PUSH_SIZE,
+         END
+      };
+
+      typedef typed_engine::value value;
+
+      value binary_variant_op( engine::op_code code, const value& a, const value& b )
+      {
+         const variant va = a.to_variant();
+         const variant vb = b.to_variant();
+         switch( code )
+         {
+            case engine::ADD:  return value::from_variant( va + vb );
+            case engine::SUB:  return value::from_variant( va - vb );
+            case engine::MULT: return value::from_variant( va * vb );
+            case engine::DIV:  return value::from_variant( va / vb );
+            case engine::LT:   return value::from_variant( va < vb );
+            case engine::GT:   return value::from_variant( va > vb );
+            case engine::LTEQ: return value::from_variant( va <= vb );
+            case engine::GTEQ: return value::from_variant( va >= vb );
+            case engine::EQ:   return value::from_variant( va == vb );
+            case engine::NEQ:  return value::from_variant( !( va == vb ) );
+            default:           FC_THROW_EXCEPTION( fc::invalid_arg_exception, "not a binary operation: ${c}", ("c",code) );
+         }
+      }
+
+      inline value make_bool( bool b )
+      {
+         value v;
+         v.kind = value::bool_kind;
+         v.bool_value = b;
+         return v;
+      }
+
+      inline value make_int( int64_t i )
+      {
+         value v;
+         v.kind = value::int_kind;
+         v.int_value = i;
+         return v;
+      }
+
+      inline const variant& as_ref( const value& v )
+      {
+         FC_ASSERT( v.kind == value::ref_kind );
+         return *v.ref;
+      }
+   }
+
+   value typed_engine::value::from_variant( const variant& v )
+   {
+      switch( v.get_type() )
+      {
+         case variant::null_type:  return value();
+         case variant::int64_type: return make_int( v.as_int64() );
+         case variant::bool_type:  return make_bool( v.as_bool() );
+         default:
+         {
+            value result;
+            result.kind = ref_kind;
+            result.ref = std::make_shared<const variant>( v );
+            return result;
+         }
+      }
+   }
+
+   variant typed_engine::value::to_variant()const
+   {
+      switch( kind )
+      {
+         case int_kind:  return variant( int_value );
+         case bool_kind: return variant( bool_value );
+         case ref_kind:  return *ref;
+         default:        return variant();
+      }
+   }
+
+   typed_engine::program typed_engine::compile( const vector<engine::operation>& ops )
+   { try {
+      program prog;
+      prog.code.reserve( ops.size() + 1 );
+
+      /* Every operation may use arg0 as a constant, but only those that do get a constant slot. Stack
+         slots are numbered after the constants, so they are resolved once the count is known. */
+      struct pending_instruction
+      {
+         uint16_t code;
+         int32_t  target;
+         int32_t  a;
+         int32_t  b;
+      };
+      vector<pending_instruction> pending;
+      pending.reserve( ops.size() );
+
+      const int32_t constant_flag = 1 << 30;
+      int32_t depth = 0;
+      int32_t max_depth = 0;
+
+      /* stack_index counts down from the top of the stack, 1 being the top, and 0 means the constant */
+      const auto operand = [&]( const engine::operation& op, int16_t stack_index ) -> int32_t
+      {
+         if( stack_index == 0 )
+         {
+            prog.constants.push_back( value::from_variant( op.arg0 ) );
+            return constant_flag | int32_t( prog.constants.size() - 1 );
+         }
+         FC_ASSERT( stack_index > 0 && stack_index <= depth, "stack index ${i} out of range at depth ${d}",
+                    ("i",stack_index)("d",depth) );
+         return depth - stack_index;
+      };
+      const auto stack_operand = [&]( int16_t stack_index ) -> int32_t
+      {
+         FC_ASSERT( stack_index > 0 && stack_index <= depth, "stack index ${i} out of range at depth ${d}",
+                    ("i",stack_index)("d",depth) );
+         return depth - stack_index;
+      };
+
+      for( uint32_t i = 0; i < ops.size(); ++i )
+      {
+         const engine::operation& op = ops[ i ];
+         pending_instruction ins{ uint16_t( op.code.value ), 0, 0, 0 };
+         try
+         {
+            switch( (engine::op_code)op.code )
+            {
+               case engine::PUSH:
+                  ins.a = operand( op, op.arg1 );
+                  ins.target = depth++;
+                  break;
+               case engine::SET:
+                  ins.target = stack_operand( op.arg1 );
+                  ins.a = operand( op, op.arg2 );
+                  break;
+               case engine::POP:
+                  ins.target = stack_operand( 1 );
+                  --depth;
+                  break;
+               case engine::ADD: case engine::SUB: case engine::MULT: case engine::DIV:
+               case engine::LT: case engine::GT: case engine::LTEQ: case engine::GTEQ: case engine::EQ: case engine::NEQ:
+                  ins.target = stack_operand( 1 );
+                  ins.a = operand( op, op.arg1 );
+                  break;
+               case engine::NOT_OP:
+                  ins.target = stack_operand( 1 );
+                  ins.a = operand( op, op.arg1 );
+                  break;
+               case engine::PUSH_CHILD:
+                  ins.a = operand( op, op.arg1 );
+                  ins.b = operand( op, op.arg2 );
+                  ins.target = depth++;
+                  break;
+               case engine::SET_CHILD:
+                  ins.target = stack_operand( op.arg1 );
+                  ins.a = operand( op, op.arg2 );
+                  ins.b = operand( op, op.arg3 );
+                  break;
+               case engine::PUSH_INDEX:
+               case engine::SET_INDEX:
+                  break;
+               case engine::PUSH_SIZE:
+                  ins.a = operand( op, op.arg1 );
+                  ins.target = depth++;
+                  break;
+               default:
+                  FC_THROW_EXCEPTION( fc::invalid_arg_exception, "unknown op code ${c}", ("c",op.code.value) );
+            }
+         }
+         FC_CAPTURE_AND_RETHROW( (i) )
+
+         max_depth = std::max( max_depth, depth );
+         pending.push_back( ins );
+      }
+
+      const int32_t num_slots = int32_t( prog.constants.size() ) + max_depth;
+      FC_ASSERT( num_slots <= std::numeric_limits<uint16_t>::max(), "script uses too many slots" );
+      prog.max_depth = uint16_t( max_depth );
+      prog.final_depth = uint16_t( depth );
+
+      const uint16_t base = uint16_t( prog.constants.size() );
+      const auto resolve = [&]( int32_t slot ) -> uint16_t
+      {
+         return ( slot & constant_flag ) ? uint16_t( slot & ~constant_flag ) : uint16_t( base + slot );
+      };
+      for( const auto& ins : pending )
+         prog.code.push_back( instruction{ ins.code, resolve( ins.target ), resolve( ins.a ), resolve( ins.b ) } );
+      prog.code.push_back( instruction{ END, 0, 0, 0 } );
+
+      return prog;
+   } FC_CAPTURE_AND_RETHROW( (ops.size()) ) }
+
+   void typed_engine::execute( const program& prog )
+   {
+      _stack_base = uint16_t( prog.constants.size() );
+      _stack_depth = 0;
+      _slots.resize( prog.constants.size() + prog.max_depth );
+      std::copy( prog.constants.begin(), prog.constants.end(), _slots.begin() );
+
+      value* const slots = _slots.data();
+      const instruction* ip = prog.code.data();
+
+#define VM_INT_OP( OP, RESULT ) \
+      { \
+         value& target = slots[ ip->target ]; \
+         const value& arg = slots[ ip->a ]; \
+         if( target.kind == value::int_kind && arg.kind == value::int_kind ) \
+            target = RESULT( target.int_value OP arg.int_value ); \
+         else \
+            target = binary_variant_op( engine::op_code( ip->code ), target, arg ); \
+      }
+
+#ifdef BTS_VM_COMPUTED_GOTO
+      /* In the order of engine::op_code, followed by END */
+      static void* const dispatch_table[] = {
+         &&op_ADD, &&op_SUB, &&op_MULT, &&op_DIV, &&op_PUSH, &&op_LT, &&op_GT, &&op_LTEQ, &&op_GTEQ, &&op_EQ,
+         &&op_NEQ, &&op_NOT_OP, &&op_POP, &&op_PUSH_CHILD, &&op_SET_CHILD, &&op_PUSH_INDEX, &&op_SET_INDEX,
+         &&op_SET, &&op_PUSH_SIZE, &&op_END
+      };
+#define VM_CASE( name ) op_##name:
+#define VM_NEXT() goto *dispatch_table[ (++ip)->code ]
+      goto *dispatch_table[ ip->code ];
+#else
+#define VM_CASE( name ) case name:
+#define VM_NEXT() ++ip; continue
+      for( ;; ) switch( ip->code )
+#endif
+      {
+         VM_CASE( PUSH )
+            slots[ ip->target ] = slots[ ip->a ];
+            VM_NEXT();
+         VM_CASE( SET )
+            slots[ ip->target ] = slots[ ip->a ];
+            VM_NEXT();
+         VM_CASE( POP )
+            slots[ ip->target ] = value();
+            VM_NEXT();
+         VM_CASE( ADD )
+            VM_INT_OP( +, make_int )
+            VM_NEXT();
+         VM_CASE( SUB )
+            VM_INT_OP( -, make_int )
+            VM_NEXT();
+         VM_CASE( MULT )
+            VM_INT_OP( *, make_int )
+            VM_NEXT();
+         VM_CASE( DIV )
+            FC_ASSERT( slots[ ip->a ].kind != value::int_kind || slots[ ip->a ].int_value != 0, "division by zero" );
+            VM_INT_OP( /, make_int )
+            VM_NEXT();
+         VM_CASE( LT )
+            VM_INT_OP( <, make_bool )
+            VM_NEXT();
+         VM_CASE( GT )
+            VM_INT_OP( >, make_bool )
+            VM_NEXT();
+         VM_CASE( LTEQ )
+            VM_INT_OP( <=, make_bool )
+            VM_NEXT();
+         VM_CASE( GTEQ )
+            VM_INT_OP( >=, make_bool )
+            VM_NEXT();
+         VM_CASE( EQ )
+            VM_INT_OP( ==, make_bool )
+            VM_NEXT();
+         VM_CASE( NEQ )
+            VM_INT_OP( !=, make_bool )
+            VM_NEXT();
+         VM_CASE( NOT_OP )
+         {
+            const value& arg = slots[ ip->a ];
+            if( arg.kind == value::bool_kind )
+               slots[ ip->target ] = make_bool( !arg.bool_value );
+            else if( arg.kind == value::int_kind )
+               slots[ ip->target ] = make_bool( arg.int_value == 0 );
+            else
+               slots[ ip->target ] = make_bool( !arg.to_variant().as_bool() );
+            VM_NEXT();
+         }
+         VM_CASE( PUSH_CHILD )
+            slots[ ip->target ] = value::from_variant( as_ref( slots[ ip->a ] ).get_object()[ as_ref( slots[ ip->b ] ).get_string() ] );
+            VM_NEXT();
+         VM_CASE( SET_CHILD )
+         {
+            fc::mutable_variant_object mutable_obj( as_ref( slots[ ip->target ] ).get_object() );
+            mutable_obj[ as_ref( slots[ ip->a ] ).get_string() ] = slots[ ip->b ].to_variant();
+            slots[ ip->target ] = value::from_variant( variant( fc::variant_object( std::move( mutable_obj ) ) ) );
+            VM_NEXT();
+         }
+         VM_CASE( PUSH_INDEX )
+            VM_NEXT();
+         VM_CASE( SET_INDEX )
+            VM_NEXT();
+         VM_CASE( PUSH_SIZE )
+            slots[ ip->target ] = value::from_variant( variant( slots[ ip->a ].to_variant().size() ) );
+            VM_NEXT();
+         VM_CASE( END )
+            _stack_depth = prog.final_depth;
+            return;
+      }
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_INT_OP
+   }
+
+   fc::variants typed_engine::get_stack()const
+   {
+      fc::variants stack;
+      stack.reserve( _stack_depth );
+      for( uint16_t i = 0; i < _stack_depth; ++i )
+         stack.push_back( _slots[ _stack_base + i ].to_variant() );
+      return stack;
+   }
+
+} } // bts::vm
@@ -27,6 +27,20 @@ class wallet_impl : public chain_observer
        vector<std::unique_ptr<fc::thread>>        _scanner_threads;
        float                                      _scan_progress = 0;
 
+       /** for each titan memo, the index of every scanning key that decrypted it and what it decrypted to */
+       typedef map<fc::ripemd160, vector<pair<uint32_t, memo_status>>> prescanned_memo_map;
+
+       /** a block read for a rescan, with every titan memo in it already tried against the scanning keys */
+       struct prescanned_block
+       {
+           uint32_t                               block_num = 0;
+           full_block                             block;
+           prescanned_memo_map                    memos;
+       };
+
+       /** set while scanning a prescanned block, so that its memos are not decrypted again */
+       const prescanned_memo_map*                 _prescanned_memos = nullptr;
+
        struct login_record
        {
            private_key_type key;
@@ -75,6 +89,28 @@ class wallet_impl : public chain_observer
       void scan_state();
 
       void scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec& received_time );
+      void scan_block( uint32_t block_num, const full_block& block, const vector<private_key_type>& keys,
+                       const time_point_sec& received_time );
+      void scan_block( const prescanned_block& block, const vector<private_key_type>& keys, const time_point_sec& received_time );
+
+      /** unpacks a block and decrypts its titan memos with keys; safe to call from any thread */
+      static prescanned_block prescan_block( uint32_t block_num, const vector<char>& packed_block,
+                                             const vector<private_key_type>& keys );
+
+      /**
+       * Reads the blocks [first, last] and prescans them on the scanner threads, split into one contiguous
+       * range per thread. Blocks that could not be prescanned or do not involve wallet_addresses are missing
+       * from the results.
+       */
+      vector<fc::future<vector<prescanned_block>>> prescan_blocks( uint32_t first, uint32_t last,
+                                                                   const vector<private_key_type>& keys,
+                                                                   const unordered_set<address>& wallet_addresses );
+
+      /** every address of every key in the wallet, in each form a balance can be owned by */
+      unordered_set<address> get_wallet_addresses()const;
+
+      /** false if the block's filter shows that it involves none of wallet_addresses */
+      bool block_may_involve( uint32_t block_num, const unordered_set<address>& wallet_addresses )const;
 
       wallet_transaction_record scan_transaction(
               const signed_transaction& transaction,
@@ -175,6 +211,30 @@ class wallet_impl : public chain_observer
                                  );
 
 
+      /** decrypts the memo of deposit with keys[key_index], using the prescanned result if there is one */
+      template<typename ConditionType>
+      omemo_status decrypt_deposit_memo( const ConditionType& deposit, uint32_t key_index, const private_key_type& key )
+      {
+          if( _prescanned_memos != nullptr )
+          {
+              const auto itr = _prescanned_memos->find( fc::ripemd160::hash( *deposit.memo ) );
+              if( itr != _prescanned_memos->end() )
+              {
+                  for( const auto& item : itr->second )
+                  {
+                      if( item.first == key_index )
+                          return item.second;
+                  }
+                  return omemo_status();
+              }
+          }
+
+          omemo_status status;
+          _scanner_threads[ key_index % _num_scanner_threads ]->async( [&]()
+              { status = deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
+          return status;
+      }
+
       template<typename ConditionType>
       bool scan_condition( const ConditionType& deposit, const asset& amount, 
                            wallet_transaction_record& trx_rec, asset& total_fee, const vector<private_key_type>& keys )
@@ -188,9 +248,7 @@ class wallet_impl : public chain_observer
              {
                 const auto& key = keys[i];
                 scan_key_progress[i] = fc::async([&,i](){
-                   omemo_status status;
-                   _scanner_threads[ i % _num_scanner_threads ]->async( [&]()
-                       { status =  deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
+                   const omemo_status status = decrypt_deposit_memo( deposit, i, key );
                    if( status.valid() ) /* If I've successfully decrypted then it's for me */
                    {
                       cache_deposit = true;
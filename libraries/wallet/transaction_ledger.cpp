@@ -282,7 +282,27 @@ void wallet_impl::scan_registered_accounts()
 
 void wallet_impl::scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec& received_time )
 { try {
-    const full_block& block = _blockchain->get_block( block_num );
+    scan_block( block_num, _blockchain->get_block( block_num ), keys, received_time );
+} FC_CAPTURE_AND_RETHROW( (block_num)(received_time) ) }
+
+void wallet_impl::scan_block( const prescanned_block& block, const vector<private_key_type>& keys, const time_point_sec& received_time )
+{
+    _prescanned_memos = &block.memos;
+    try
+    {
+        scan_block( block.block_num, block.block, keys, received_time );
+    }
+    catch( ... )
+    {
+        _prescanned_memos = nullptr;
+        throw;
+    }
+    _prescanned_memos = nullptr;
+}
+
+void wallet_impl::scan_block( uint32_t block_num, const full_block& block, const vector<private_key_type>& keys,
+                              const time_point_sec& received_time )
+{ try {
     for( const signed_transaction& transaction : block.user_transactions )
     {
         try
@@ -307,6 +327,128 @@ void wallet_impl::scan_block( uint32_t block_num, const vector<private_key_type>
     }
 } FC_CAPTURE_AND_RETHROW( (block_num)(received_time) ) }
 
+wallet_impl::prescanned_block wallet_impl::prescan_block( uint32_t block_num, const vector<char>& packed_block,
+                                                          const vector<private_key_type>& keys )
+{ try {
+    prescanned_block result;
+    result.block_num = block_num;
+    result.block = fc::raw::unpack<full_block>( packed_block );
+
+    const auto prescan_memo = [&]( const optional<titan_memo>& memo, const std::function<omemo_status( const private_key_type& )>& decrypt )
+    {
+        if( !memo.valid() ) return;
+        auto& matches = result.memos[ fc::ripemd160::hash( *memo ) ];
+        for( uint32_t i = 0; i < keys.size(); ++i )
+        {
+            const omemo_status status = decrypt( keys[ i ] );
+            if( status.valid() )
+                matches.emplace_back( i, *status );
+        }
+    };
+
+    for( const signed_transaction& transaction : result.block.user_transactions )
+    {
+        for( const operation& op : transaction.operations )
+        {
+            if( operation_type_enum( op.type ) != deposit_op_type )
+                continue;
+
+            const deposit_operation deposit_op = op.as<deposit_operation>();
+            switch( withdraw_condition_types( deposit_op.condition.type ) )
+            {
+                case withdraw_signature_type:
+                {
+                    const auto condition = deposit_op.condition.as<withdraw_with_signature>();
+                    prescan_memo( condition.memo, [&]( const private_key_type& key ) { return condition.decrypt_memo_data( key ); } );
+                    break;
+                }
+                case withdraw_escrow_type:
+                {
+                    const auto condition = deposit_op.condition.as<withdraw_with_escrow>();
+                    prescan_memo( condition.memo, [&]( const private_key_type& key ) { return condition.decrypt_memo_data( key ); } );
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    return result;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+unordered_set<address> wallet_impl::get_wallet_addresses()const
+{
+    unordered_set<address> addresses;
+    for( const auto& item : _wallet_db.get_keys() )
+    {
+        const public_key_type& key = item.second.public_key;
+        addresses.insert( item.first );
+        addresses.insert( address( key ) );
+        addresses.insert( address( pts_address( key, false, 56 ) ) );
+        addresses.insert( address( pts_address( key, true, 56 ) ) );
+        addresses.insert( address( pts_address( key, false, 0 ) ) );
+        addresses.insert( address( pts_address( key, true, 0 ) ) );
+    }
+    return addresses;
+}
+
+bool wallet_impl::block_may_involve( uint32_t block_num, const unordered_set<address>& wallet_addresses )const
+{
+    const oblock_filter filter = _blockchain->get_block_filter( block_num );
+    return !filter.valid() || filter->may_involve( wallet_addresses );
+}
+
+vector<fc::future<vector<wallet_impl::prescanned_block>>> wallet_impl::prescan_blocks( uint32_t first, uint32_t last,
+                                                                                      const vector<private_key_type>& keys,
+                                                                                      const unordered_set<address>& wallet_addresses )
+{
+    vector<fc::future<vector<prescanned_block>>> ranges;
+    if( first > last ) return ranges;
+
+    const uint32_t num_blocks = last - first + 1;
+    const uint32_t range_size = ( num_blocks + _num_scanner_threads - 1 ) / _num_scanner_threads;
+    for( uint32_t range_first = first; range_first <= last && range_first >= first; range_first += range_size )
+    {
+        const uint32_t range_last = std::min( last, range_first + range_size - 1 );
+
+        /* Reading is done here since the chain database is not thread safe; only the unpacking and
+           decryption are moved to the scanner threads */
+        vector<pair<uint32_t, vector<char>>> packed_blocks;
+        packed_blocks.reserve( range_last - range_first + 1 );
+        for( uint32_t block_num = range_first; block_num <= range_last; ++block_num )
+        {
+            try
+            {
+                if( !block_may_involve( block_num, wallet_addresses ) )
+                    continue;
+                packed_blocks.emplace_back( block_num, _blockchain->get_packed_block( block_num ) );
+            }
+            catch( const fc::exception& )
+            {
+            }
+        }
+
+        ranges.push_back( _scanner_threads[ ranges.size() % _num_scanner_threads ]->async( [packed_blocks, keys]()
+        {
+            vector<prescanned_block> blocks;
+            blocks.reserve( packed_blocks.size() );
+            for( const auto& item : packed_blocks )
+            {
+                try
+                {
+                    blocks.push_back( prescan_block( item.first, item.second, keys ) );
+                }
+                catch( const fc::exception& )
+                {
+                }
+            }
+            return blocks;
+        }, "prescan blocks" ) );
+    }
+    return ranges;
+}
+
 wallet_transaction_record wallet_impl::scan_transaction(
         const signed_transaction& transaction,
         uint32_t block_num,
@@ -1205,9 +1347,7 @@ bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<privat
              {
                 const auto& key = keys[i];
                 scan_key_progress[i] = fc::async([&,i](){
-                   omemo_status status;
-                   _scanner_threads[ i % _num_scanner_threads ]->async( [&]()
-                       { status =  deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
+                   const omemo_status status = decrypt_deposit_memo( deposit, i, key );
                    /* If I've successfully decrypted then it's for me */
                    if( status.valid() )
                    {
@@ -218,25 +218,53 @@ namespace detail {
               ulog( "Beginning scan at block ${n}...", ("n",start) );
 
           uint32_t last_scanned_block_num = std::min( {self->get_last_scanned_block_number(), start - 1, start} );
-          for( auto block_num = start; !_scan_in_progress.canceled() && block_num <= min_end; ++block_num )
+
+          /* Blocks are unpacked and their memos decrypted on the scanner threads one batch ahead of
+             being merged into the wallet in block order here; blocks whose filter rules out every
+             wallet address are skipped without being read */
+          const uint32_t batch_size = _num_scanner_threads * BTS_WALLET_RESCAN_BLOCKS_PER_THREAD;
+          const auto batch_last = [&]( uint32_t first ) { return uint32_t( std::min<size_t>( min_end, size_t( first ) + batch_size - 1 ) ); };
+          const auto wallet_addresses = get_wallet_addresses();
+          auto next_batch = prescan_blocks( start, batch_last( start ), private_keys, wallet_addresses );
+
+          for( uint32_t batch_first = start; !_scan_in_progress.canceled() && batch_first <= min_end; batch_first = batch_last( batch_first ) + 1 )
           {
-              try
-              {
-                  scan_block( block_num, private_keys, now );
-                  last_scanned_block_num = block_num;
-              }
-              catch( const fc::exception& )
+              auto batch = std::move( next_batch );
+              next_batch.clear();
+              if( batch_last( batch_first ) < min_end )
+                  next_batch = prescan_blocks( batch_last( batch_first ) + 1, batch_last( batch_last( batch_first ) + 1 ), private_keys, wallet_addresses );
+
+              map<uint32_t, const prescanned_block*> prescanned;
+              for( auto& range : batch )
               {
+                  for( const auto& block : range.wait() )
+                      prescanned[ block.block_num ] = &block;
               }
 
-              _scan_progress = float(block_num-start)/(min_end-start+1);
-              if( block_num > start )
+              for( auto block_num = batch_first; !_scan_in_progress.canceled() && block_num <= batch_last( batch_first ); ++block_num )
               {
-                  if( (block_num - start) % 10000 == 0 )
-                      ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
+                  try
+                  {
+                      const auto itr = prescanned.find( block_num );
+                      if( itr != prescanned.end() )
+                          scan_block( *itr->second, private_keys, now );
+                      else if( block_may_involve( block_num, wallet_addresses ) )
+                          scan_block( block_num, private_keys, now );
+                      last_scanned_block_num = block_num;
+                  }
+                  catch( const fc::exception& )
+                  {
+                  }
 
-                  if( !fast_scan && (block_num - start) % 100 == 0 )
-                      fc::usleep( fc::microseconds( 100 ) );
+                  _scan_progress = float(block_num-start)/(min_end-start+1);
+                  if( block_num > start )
+                  {
+                      if( (block_num - start) % 10000 == 0 )
+                          ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
+
+                      if( !fast_scan && (block_num - start) % 100 == 0 )
+                          fc::usleep( fc::microseconds( 100 ) );
+                  }
               }
           }
 
@@ -0,0 +1,81 @@
+/**
+ *  Repeatable throughput numbers for chain_database.
+ *
+ *  Replays a range of blocks from an existing raw_chain into a fresh database and reports the time
+ *  spent in each stage of applying them, then runs synthetic transfer, order placement and market
+ *  matching workloads against the resulting state.
+ *
+ *  chain_benchmarks --raw-chain ~/.BitShares/raw_chain --to 50000
+ *  chain_benchmarks --genesis tests/test_genesis.json --transactions 5000
+ */
+#include "chain_benchmarks.hpp"
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/log/logger_config.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+using namespace bts::blockchain;
+using namespace chain_benchmarks;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      namespace po = boost::program_options;
+      po::options_description options( "chain_benchmarks options" );
+      options.add_options()
+         ( "help", "display this help message" )
+         ( "data-dir", po::value<std::string>(), "scratch directory for the benchmark database, removed before each run" )
+         ( "genesis", po::value<std::string>(), "genesis file, defaults to the built in genesis" )
+         ( "raw-chain", po::value<std::string>(), "raw_chain directory of an existing data directory to replay" )
+         ( "from", po::value<uint32_t>()->default_value( 1 ), "first block to time" )
+         ( "to", po::value<uint32_t>()->default_value( uint32_t( -1 ) ), "last block to replay" )
+         ( "transactions", po::value<uint32_t>()->default_value( 1000 ), "transactions per synthetic workload, 0 skips them" );
+
+      po::variables_map args;
+      po::store( po::parse_command_line( argc, argv, options ), args );
+      po::notify( args );
+      if( args.count( "help" ) )
+      {
+         std::cout << options << "\n";
+         return 0;
+      }
+
+      fc::path data_dir = "chain_benchmarks_data";
+      if( args.count( "data-dir" ) )
+         data_dir = fc::path( args[ "data-dir" ].as<std::string>() );
+      fc::remove_all( data_dir );
+
+      fc::optional<fc::path> genesis;
+      if( args.count( "genesis" ) )
+         genesis = fc::path( args[ "genesis" ].as<std::string>() );
+
+      fc::configure_logging( fc::logging_config() );
+
+      const chain_database_ptr db = std::make_shared<chain_database>();
+      db->open( data_dir, genesis );
+      db->set_relay_fee( 0 );
+
+      if( args.count( "raw-chain" ) )
+         replay_blocks( db, fc::path( args[ "raw-chain" ].as<std::string>() ), args[ "from" ].as<uint32_t>(), args[ "to" ].as<uint32_t>() );
+
+      const uint32_t num_transactions = args[ "transactions" ].as<uint32_t>();
+      if( num_transactions > 0 )
+         run_synthetic_workloads( db, num_transactions );
+
+      db->close();
+      fc::remove_all( data_dir );
+      return 0;
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   return 1;
+}
@@ -0,0 +1,197 @@
+#pragma once
+/**
+ *  Workloads shared by the chain_benchmarks program and the short run in dev_tests.
+ */
+#include <bts/blockchain/chain_database.hpp>
+#include <bts/blockchain/config.hpp>
+#include <bts/blockchain/fork_blocks.hpp>
+#include <bts/blockchain/time.hpp>
+#include <bts/blockchain/transaction_evaluation_state.hpp>
+#include <bts/db/level_map.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace chain_benchmarks
+{
+   using namespace bts::blockchain;
+
+   inline void print_timing( const std::string& name, const fc::microseconds& elapsed, uint64_t count, const std::string& unit )
+   {
+      const double seconds = double( elapsed.count() ) / 1000000;
+      std::cout << std::left << std::setw( 24 ) << name
+                << std::right << std::setw( 12 ) << std::fixed << std::setprecision( 3 ) << seconds << " s";
+      if( count > 0 && seconds > 0 )
+         std::cout << std::setw( 14 ) << std::setprecision( 1 ) << double( count ) / seconds << " " << unit << "/s"
+                   << std::setw( 12 ) << std::setprecision( 2 ) << double( elapsed.count() ) / count << " us/" << unit;
+      std::cout << "\n";
+   }
+
+   /** pushes blocks [1, to] from raw_chain and times the blocks from `from` onwards */
+   inline void replay_blocks( const chain_database_ptr& db, const fc::path& raw_chain_dir, uint32_t from, uint32_t to )
+   {
+      bts::db::level_map<uint32_t, block_id_type> block_num_to_id;
+      block_num_to_id.open( raw_chain_dir / "block_num_to_id_db" );
+      bts::db::level_map<block_id_type, full_block> raw_blocks;
+      raw_blocks.open( raw_chain_dir / "block_id_to_block_data_db" );
+
+      std::map<uint32_t, block_id_type> num_to_id;
+      for( auto itr = block_num_to_id.lower_bound( 1 ); itr.valid() && itr.key() <= to; ++itr )
+         num_to_id[ itr.key() ] = itr.value();
+      block_num_to_id.close();
+
+      std::cout << "Replaying " << num_to_id.size() << " blocks, timing blocks " << from << " to " << to << "\n";
+
+      fc::time_point start = fc::time_point::now();
+      for( const auto& item : num_to_id )
+      {
+         if( item.first == from )
+         {
+            db->reset_block_stage_timings();
+            start = fc::time_point::now();
+         }
+         const auto block = raw_blocks.fetch( item.second );
+         const auto fork_data = db->push_block( block );
+         FC_ASSERT( fork_data.is_included, "block ${n} was not applied", ("n",item.first) );
+      }
+      const fc::microseconds elapsed = fc::time_point::now() - start;
+      raw_blocks.close();
+
+      const block_stage_timings timings = db->get_block_stage_timings();
+      std::cout << "\nBlock replay\n";
+      print_timing( "push_block",         elapsed,                     timings.blocks, "block" );
+      print_timing( "verify_header",      timings.verify_header,       timings.blocks, "block" );
+      print_timing( "pay_delegate",       timings.pay_delegate,        timings.blocks, "block" );
+      print_timing( "execute_markets",    timings.execute_markets,     timings.blocks, "block" );
+      print_timing( "apply_transactions", timings.apply_transactions,  timings.blocks, "block" );
+      print_timing( "save_undo_state",    timings.save_undo_state,     timings.blocks, "block" );
+      print_timing( "apply_changes",      timings.apply_changes,       timings.blocks, "block" );
+   }
+
+   inline fc::ecc::private_key benchmark_key( uint32_t i )
+   {
+      return fc::ecc::private_key::regenerate( fc::sha256::hash( "chain_benchmarks" + std::to_string( i ) ) );
+   }
+
+   inline balance_id_type benchmark_balance_id( const address& owner, asset_id_type asset_id )
+   {
+      return balance_record( owner, asset( 0, asset_id ), 0 ).id();
+   }
+
+   /** gives every benchmark key a balance of each asset so that workloads have something to spend */
+   inline void fund_keys( const chain_database_ptr& db, uint32_t num_keys, const vector<asset_id_type>& asset_ids )
+   {
+      for( uint32_t i = 0; i < num_keys; ++i )
+      {
+         const address owner( benchmark_key( i ).get_public_key() );
+         for( const asset_id_type asset_id : asset_ids )
+            db->store_balance_record( balance_record( owner, asset( 1000000 * BTS_BLOCKCHAIN_PRECISION, asset_id ), 0 ) );
+      }
+   }
+
+   inline asset_id_type create_benchmark_asset( const chain_database_ptr& db )
+   {
+      asset_record record;
+      record.id = db->last_asset_id() + 1;
+      record.symbol = "BENCH";
+      record.name = "Benchmark asset";
+      record.issuer_account_id = 1;
+      record.precision = BTS_BLOCKCHAIN_PRECISION;
+      record.registration_date = db->now();
+      record.last_update = db->now();
+      record.maximum_share_supply = BTS_BLOCKCHAIN_MAX_SHARES;
+      record.flags = 0;
+      record.issuer_permissions = 0;
+      db->store_asset_record( record );
+      db->set_property( chain_property_enum::last_asset_id, variant( record.id ) );
+      return record.id;
+   }
+
+   /** times evaluating each transaction on its own pending state, like the pending queue does */
+   inline fc::microseconds evaluate_all( const chain_database_ptr& db, const vector<signed_transaction>& trxs )
+   {
+      const fc::time_point start = fc::time_point::now();
+      for( const auto& trx : trxs )
+      {
+         const pending_chain_state_ptr pending_state = std::make_shared<pending_chain_state>( db );
+         transaction_evaluation_state eval_state( pending_state.get(), db->chain_id() );
+         eval_state.evaluate( trx, false, false );
+      }
+      return fc::time_point::now() - start;
+   }
+
+   inline void run_synthetic_workloads( const chain_database_ptr& db, uint32_t num_transactions )
+   {
+      const uint32_t num_keys = std::max<uint32_t>( num_transactions, 1 );
+      const asset_id_type quote_id = create_benchmark_asset( db );
+      fund_keys( db, num_keys, { asset_id_type( 0 ), quote_id } );
+
+      const share_type fee = BTS_BLOCKCHAIN_PRECISION;
+      const fc::time_point_sec expiration = db->now() + fc::hours( 1 );
+
+      vector<signed_transaction> transfers;
+      vector<signed_transaction> orders;
+      transfers.reserve( num_transactions );
+      orders.reserve( num_transactions );
+      for( uint32_t i = 0; i < num_transactions; ++i )
+      {
+         const fc::ecc::private_key key = benchmark_key( i );
+         const address owner( key.get_public_key() );
+
+         signed_transaction transfer;
+         transfer.expiration = expiration;
+         transfer.withdraw( benchmark_balance_id( owner, asset_id_type( 0 ) ), 100 * BTS_BLOCKCHAIN_PRECISION + fee );
+         transfer.deposit( address( benchmark_key( i + num_keys ).get_public_key() ), asset( 100 * BTS_BLOCKCHAIN_PRECISION ), 0 );
+         transfer.sign( key, db->chain_id() );
+         transfers.push_back( transfer );
+
+         signed_transaction order;
+         order.expiration = expiration;
+         if( i % 2 == 0 )
+         {
+            order.withdraw( benchmark_balance_id( owner, quote_id ), 100 * BTS_BLOCKCHAIN_PRECISION );
+            order.bid( asset( 100 * BTS_BLOCKCHAIN_PRECISION, quote_id ), price( 1.0 + (i % 100) / 1000.0, quote_id, asset_id_type( 0 ) ), owner );
+         }
+         else
+         {
+            order.withdraw( benchmark_balance_id( owner, asset_id_type( 0 ) ), 100 * BTS_BLOCKCHAIN_PRECISION );
+            order.ask( asset( 100 * BTS_BLOCKCHAIN_PRECISION ), price( 0.9 + (i % 100) / 1000.0, quote_id, asset_id_type( 0 ) ), owner );
+         }
+         order.withdraw( benchmark_balance_id( owner, asset_id_type( 0 ) ), fee );
+         order.sign( key, db->chain_id() );
+         orders.push_back( order );
+      }
+
+      std::cout << "\nSynthetic workloads\n";
+      print_timing( "transfer",        evaluate_all( db, transfers ), transfers.size(), "trx" );
+      print_timing( "order_placement", evaluate_all( db, orders ),    orders.size(),    "trx" );
+
+      // market matching only runs through execute_markets once the chain is past the 0.4.9 fork
+      if( db->get_head_block_num() < BTS_V0_4_9_FORK_BLOCK_NUM )
+      {
+         std::cout << std::left << std::setw( 24 ) << "market_matching" << "skipped, replay past block "
+                   << BTS_V0_4_9_FORK_BLOCK_NUM << " first\n";
+         return;
+      }
+
+      for( uint32_t i = 0; i < num_transactions; ++i )
+      {
+         const address owner( benchmark_key( i ).get_public_key() );
+         if( i % 2 == 0 )
+            db->store_bid_record( market_index_key( price( 1.0 + (i % 100) / 1000.0, quote_id, asset_id_type( 0 ) ), owner ),
+                                  order_record( 100 * BTS_BLOCKCHAIN_PRECISION ) );
+         else
+            db->store_ask_record( market_index_key( price( 0.9 + (i % 100) / 1000.0, quote_id, asset_id_type( 0 ) ), owner ),
+                                  order_record( 100 * BTS_BLOCKCHAIN_PRECISION ) );
+      }
+      db->set_market_dirty( quote_id, asset_id_type( 0 ) );
+
+      const fc::time_point start = fc::time_point::now();
+      db->generate_block( db->now() + BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC );
+      print_timing( "market_matching", fc::time_point::now() - start, num_transactions, "order" );
+   }
+}
@@ -1,6 +1,11 @@
 #define BOOST_TEST_MODULE BlockchainTests2cc
 #include <boost/test/unit_test.hpp>
 #include "dev_fixture.hpp"
+#include "chain_benchmarks.hpp"
+
+#include <bts/mail/proof_of_work.hpp>
+
+#include <cstring>
 
 
 BOOST_FIXTURE_TEST_CASE( basic_commands, chain_fixture )
@@ -802,3 +807,257 @@ BOOST_FIXTURE_TEST_CASE( fork_testing, chain_fixture )
    exec( clientb, "info" );
    exec( clienta, "info" );
 }
+
+/** short run of tests/chain_benchmarks, replaying the fixture's blocks into a fresh database */
+BOOST_FIXTURE_TEST_CASE( chain_benchmarks_short_run, chain_fixture )
+{ try {
+   for( uint32_t i = 0; i < 3; ++i )
+   {
+      produce_block(clientb);
+      produce_block(clienta);
+   }
+
+   // the fixture's databases stay open, so replay from a copy of its raw_chain
+   fc::temp_directory replay_dir;
+   const fc::path raw_chain = replay_dir.path() / "raw_chain";
+   for( const std::string name : { "block_num_to_id_db", "block_id_to_block_data_db" } )
+   {
+      const boost::filesystem::path source = clienta_dir.path() / "chain/raw_chain" / name;
+      const boost::filesystem::path target = raw_chain / name;
+      boost::filesystem::create_directories( target );
+      for( boost::filesystem::directory_iterator itr( source ), end; itr != end; ++itr )
+      {
+         if( itr->path().filename() != "LOCK" )
+            boost::filesystem::copy_file( itr->path(), target / itr->path().filename() );
+      }
+   }
+
+   const chain_database_ptr db = std::make_shared<chain_database>();
+   db->open( replay_dir.path() / "chain", clienta_dir.path() / "genesis.json" );
+   db->set_relay_fee( 0 );
+   chain_benchmarks::replay_blocks( db, raw_chain, 1, -1 );
+   BOOST_CHECK_EQUAL( db->get_head_block_num(), clienta->get_chain()->get_head_block_num() );
+
+   chain_benchmarks::run_synthetic_workloads( db, 10 );
+   db->close();
+} FC_LOG_AND_RETHROW() }
+
+/** the records market execution writes, packed without depending on the order they were inserted in */
+static vector<char> pack_market_results( const pending_chain_state& state )
+{
+   vector<char> result;
+   const auto append = [&]( const vector<char>& bytes ) { result.insert( result.end(), bytes.begin(), bytes.end() ); };
+   append( fc::raw::pack( std::map<asset_id_type, asset_record>( state.assets.begin(), state.assets.end() ) ) );
+   append( fc::raw::pack( std::map<balance_id_type, balance_record>( state.balances.begin(), state.balances.end() ) ) );
+   append( fc::raw::pack( state.bids ) );
+   append( fc::raw::pack( state.asks ) );
+   append( fc::raw::pack( state.relative_bids ) );
+   append( fc::raw::pack( state.relative_asks ) );
+   append( fc::raw::pack( state.shorts ) );
+   append( fc::raw::pack( state.collateral ) );
+   append( fc::raw::pack( state.market_statuses ) );
+   append( fc::raw::pack( state.market_history ) );
+   append( fc::raw::pack( state.market_transactions ) );
+   return result;
+}
+
+/**
+ *  Two markets that share their base asset and a buyer, so that both pay into the same XTS balance,
+ *  must leave the same state whether they are matched one after another or in parallel and merged.
+ */
+BOOST_FIXTURE_TEST_CASE( parallel_markets_match_serial_execution, chain_fixture )
+{ try {
+   exec( clientb, "wallet_asset_create USD Dollar delegate30 \"paper bucks\" 1000000000 1000" );
+   exec( clientb, "wallet_asset_create GLD Gold delegate30 \"gram o gold\" 1000000000 1000" );
+   produce_block( clientb );
+   exec( clientb, "wallet_asset_issue 20000 USD delegate32 \"usd\"" );
+   exec( clientb, "wallet_asset_issue 20000 GLD delegate32 \"gld\"" );
+   produce_block( clientb );
+
+   exec( clientb, "bid delegate32 100 XTS 2 USD" );
+   exec( clientb, "bid delegate32 100 XTS 3 GLD" );
+   exec( clientb, "ask delegate30 60 XTS 1.5 USD" );
+   exec( clientb, "ask delegate30 60 XTS 2.5 GLD" );
+   produce_block( clientb );
+
+   const chain_database_ptr chain = clientb->get_chain();
+   BOOST_REQUIRE_EQUAL( chain->get_dirty_markets().size(), 2u );
+
+   const fc::time_point_sec timestamp = chain->now() + BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC;
+   const pending_chain_state_ptr serial = std::make_shared<pending_chain_state>( chain );
+   chain->execute_markets( timestamp, serial, false );
+   const pending_chain_state_ptr parallel = std::make_shared<pending_chain_state>( chain );
+   chain->execute_markets( timestamp, parallel, true );
+
+   BOOST_REQUIRE( !serial->market_statuses.empty() );
+   BOOST_CHECK( pack_market_results( *serial ) == pack_market_results( *parallel ) );
+} FC_LOG_AND_RETHROW() }
+
+/** the running supply and debt totals must agree with a walk over every record */
+static void check_supply_totals( const chain_database_ptr& db )
+{
+   for( const asset_record& record : db->get_assets( "", -1 ) )
+   {
+      BOOST_CHECK_EQUAL( db->calculate_supply( record.id ).amount, db->scan_supply( record.id ).amount );
+      if( record.is_market_issued() )
+         BOOST_CHECK_EQUAL( db->calculate_debt( record.id ).amount, db->scan_debt( record.id ).amount );
+   }
+}
+
+/**
+ *  Checks the supply totals after pushing blocks, then after a fork switch that pops a block of a
+ *  second database and applies two blocks from the first one in its place.
+ */
+BOOST_FIXTURE_TEST_CASE( supply_totals_match_full_scan, chain_fixture )
+{ try {
+   exec( clientb, "wallet_asset_create USD Dollar delegate30 \"paper bucks\" 1000000000 1000" );
+   produce_block( clientb );
+   exec( clientb, "wallet_asset_issue 20000 USD delegate32 \"usd\"" );
+   produce_block( clientb );
+   exec( clientb, "wallet_transfer 1000 XTS delegate30 delegate32" );
+   exec( clientb, "bid delegate32 100 XTS 2 USD" );
+   exec( clientb, "ask delegate30 60 XTS 1.5 USD" );
+   produce_block( clientb );
+   produce_block( clientb );
+
+   const chain_database_ptr chain = clientb->get_chain();
+   check_supply_totals( chain );
+
+   // a second database that has every block but the last two of the first one
+   const uint32_t fork_block_num = chain->get_head_block_num() - 1;
+   fc::temp_directory fork_dir;
+   const chain_database_ptr db = std::make_shared<chain_database>();
+   db->open( fork_dir.path(), clientb_dir.path() / "genesis.json" );
+   for( uint32_t block_num = 1; block_num < fork_block_num; ++block_num )
+      db->push_block( chain->get_block( block_num ) );
+   check_supply_totals( db );
+
+   // it extends that with a block of its own, signed by a delegate that did not sign either of the other two
+   const auto delegates = clienta->get_wallet()->get_my_delegates( enabled_delegate_status | active_delegate_status );
+   const auto timestamp = clienta->get_wallet()->get_next_producible_block_timestamp( delegates );
+   BOOST_REQUIRE( timestamp.valid() );
+   full_block own_block = db->generate_block( *timestamp );
+   clienta->get_wallet()->sign_block( own_block );
+   db->push_block( own_block );
+   BOOST_REQUIRE_EQUAL( db->get_head_block_num(), fork_block_num );
+   check_supply_totals( db );
+
+   // the longer fork of the first database replaces it
+   db->push_block( chain->get_block( fork_block_num ) );
+   db->push_block( chain->get_block( fork_block_num + 1 ) );
+   BOOST_REQUIRE( db->get_head_block_id() == chain->get_head_block_id() );
+   check_supply_totals( db );
+   db->close();
+} FC_LOG_AND_RETHROW() }
+
+/** the records pending transfers write, packed without depending on the order they were inserted in */
+static vector<char> pack_pending_results( const pending_chain_state& state )
+{
+   vector<char> result;
+   const auto append = [&]( const vector<char>& bytes ) { result.insert( result.end(), bytes.begin(), bytes.end() ); };
+   append( fc::raw::pack( std::map<asset_id_type, asset_record>( state.assets.begin(), state.assets.end() ) ) );
+   append( fc::raw::pack( std::map<balance_id_type, balance_record>( state.balances.begin(), state.balances.end() ) ) );
+   append( fc::raw::pack( std::map<account_id_type, account_record>( state.accounts.begin(), state.accounts.end() ) ) );
+   append( fc::raw::pack( std::map<slate_id_type, delegate_slate>( state.slates.begin(), state.slates.end() ) ) );
+   append( fc::raw::pack( std::map<transaction_id_type, transaction_record>( state.transactions.begin(), state.transactions.end() ) ) );
+   append( fc::raw::pack( std::set<digest_type>( state.unique_transactions.begin(), state.unique_transactions.end() ) ) );
+   return result;
+}
+
+/** what evaluating every pending transaction from scratch on top of the head block leaves behind */
+static pending_chain_state_ptr evaluate_pending_from_scratch( const chain_database_ptr& chain )
+{
+   const pending_chain_state_ptr state = std::make_shared<pending_chain_state>( chain );
+   for( const transaction_evaluation_state_ptr& pending : chain->get_pending_transactions() )
+   {
+      const pending_chain_state_ptr changes = std::make_shared<pending_chain_state>( state );
+      transaction_evaluation_state eval_state( changes.get(), chain->chain_id() );
+      eval_state.evaluate( pending->trx, false, false );
+      changes->apply_changes();
+   }
+   return state;
+}
+
+static bool is_pending( const chain_database_ptr& chain, const transaction_evaluation_state_ptr& eval_state )
+{
+   const auto pending = chain->get_pending_transactions();
+   return std::find( pending.begin(), pending.end(), eval_state ) != pending.end();
+}
+
+/**
+ *  Rebuilding the pending state must leave exactly what evaluating the pending transactions again
+ *  would, whether a transaction was rebased or evaluated again, and must drop a transaction whose
+ *  balance was spent by a block.
+ */
+BOOST_FIXTURE_TEST_CASE( rebased_pending_state_matches_fresh_evaluation, chain_fixture )
+{ try {
+   const chain_database_ptr chain = clienta->get_chain();
+   const wallet_ptr wallet = clienta->get_wallet();
+   const address recipient = chain->get_account_record( "delegate32" )->active_address();
+   const share_type shares = wallet->get_account_balances( "delegate31" )[ "delegate31" ][ asset_id_type( 0 ) ];
+   const double most_of_balance = double( shares ) * 0.6 / BTS_BLOCKCHAIN_PRECISION;
+
+   // pending transactions stored straight into client a's chain, so client b never includes them
+   wallet->set_transaction_fee( asset( 5 * BTS_BLOCKCHAIN_PRECISION ) );
+   const signed_transaction spend = wallet->transfer_asset_to_address( most_of_balance, "XTS", "delegate31", recipient,
+                                                                       "spend", vote_none, true ).trx;
+   const signed_transaction other = wallet->transfer_asset_to_address( 10, "XTS", "delegate35", recipient,
+                                                                       "other", vote_none, true ).trx;
+   wallet->set_transaction_fee( asset( BTS_BLOCKCHAIN_PRECISION / 2 ) );
+   const signed_transaction cheap = wallet->transfer_asset_to_address( 10, "XTS", "delegate33", recipient,
+                                                                       "cheap", vote_none, true ).trx;
+
+   chain->set_pending_transaction_limits( 2, 0, 0 );
+   const transaction_evaluation_state_ptr spend_eval = chain->store_pending_transaction( spend );
+   chain->store_pending_transaction( cheap );
+
+   // evicting the cheap transaction rebuilds the pending state at the same head, so spend is rebased
+   const transaction_evaluation_state_ptr other_eval = chain->store_pending_transaction( other );
+   BOOST_REQUIRE_EQUAL( chain->get_pending_transactions().size(), 2u );
+   BOOST_CHECK( is_pending( chain, spend_eval ) );
+   BOOST_CHECK( is_pending( chain, other_eval ) );
+   BOOST_CHECK( pack_pending_results( *chain->get_pending_state() ) == pack_pending_results( *evaluate_pending_from_scratch( chain ) ) );
+
+   // a block touching unrelated balances moves the chain time, so spend is evaluated again
+   exec( clientb, "wallet_transfer 10 XTS delegate30 delegate32" );
+   produce_block( clientb );
+   BOOST_REQUIRE_EQUAL( chain->get_pending_transactions().size(), 2u );
+   BOOST_CHECK( pack_pending_results( *chain->get_pending_state() ) == pack_pending_results( *evaluate_pending_from_scratch( chain ) ) );
+
+   // a block spending the same balance leaves too little for spend, which is dropped
+   const signed_transaction conflict = wallet->transfer_asset_to_address( most_of_balance, "XTS", "delegate31", recipient,
+                                                                          "conflict", vote_none, true ).trx;
+   clientb->get_chain()->store_pending_transaction( conflict );
+   produce_block( clientb );
+   const auto pending = chain->get_pending_transactions();
+   BOOST_REQUIRE_EQUAL( pending.size(), 1u );
+   BOOST_CHECK( pending.front()->trx.id() == other.id() );
+   BOOST_CHECK( pack_pending_results( *chain->get_pending_state() ) == pack_pending_results( *evaluate_pending_from_scratch( chain ) ) );
+} FC_LOG_AND_RETHROW() }
+
+/** a nonce the engine finds by patching the packed message must still meet the target once the message is packed again */
+BOOST_AUTO_TEST_CASE( proof_of_work_nonce_meets_target )
+{ try {
+   bts::mail::signed_email_message email;
+   email.subject = "proof of work";
+   email.body = "a body long enough that the packed message spans several ripemd160 blocks";
+   email.sign( fc::ecc::private_key::regenerate( fc::sha256::hash( string( "sender" ) ) ) );
+
+   bts::mail::message msg( email );
+   msg.recipient = address( fc::ecc::private_key::regenerate( fc::sha256::hash( string( "recipient" ) ) ).get_public_key() );
+   msg.nonce = 0;
+
+   // about one id in 256 is at or below a target whose leading byte is zero
+   bts::mail::message_id_type target;
+   std::memset( target.data(), 0xff, target.data_size() );
+   target.data()[ 0 ] = 0;
+
+   bts::mail::proof_of_work_engine engine( 4 );
+   const bts::mail::proof_of_work_result result = engine.search( msg, target, fc::seconds( 60 ) );
+   BOOST_REQUIRE( result.nonce.valid() );
+
+   msg.nonce = *result.nonce;
+   const bts::mail::message repacked = fc::raw::unpack<bts::mail::message>( fc::raw::pack( msg ) );
+   BOOST_CHECK( repacked.nonce == *result.nonce );
+   BOOST_CHECK( !( repacked.id() > target ) );
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,141 @@
+/**
+ *  Compares bts::vm::engine against bts::vm::typed_engine on the same scripts.
+ *
+ *  vm_benchmarks --iterations 1000000
+ */
+#include <bts/vm/engine.hpp>
+#include <bts/vm/typed_engine.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <iomanip>
+#include <iostream>
+
+using namespace bts::vm;
+
+namespace
+{
+   engine::operation make_op( engine::op_code code, int16_t arg1 = 0, int16_t arg2 = 0, int16_t arg3 = 0,
+                              const fc::variant& arg0 = fc::variant() )
+   {
+      engine::operation op;
+      op.code = code;
+      op.arg1 = arg1;
+      op.arg2 = arg2;
+      op.arg3 = arg3;
+      op.arg0 = arg0;
+      return op;
+   }
+
+   /** integer arithmetic and comparisons only */
+   vector<engine::operation> arithmetic_script()
+   {
+      vector<engine::operation> ops;
+      ops.push_back( make_op( engine::PUSH, 0, 0, 0, fc::variant( int64_t( 7 ) ) ) );
+      for( int i = 0; i < 16; ++i )
+      {
+         ops.push_back( make_op( engine::ADD, 0, 0, 0, fc::variant( int64_t( i ) ) ) );
+         ops.push_back( make_op( engine::MULT, 0, 0, 0, fc::variant( int64_t( 3 ) ) ) );
+         ops.push_back( make_op( engine::SUB, 0, 0, 0, fc::variant( int64_t( 5 ) ) ) );
+         ops.push_back( make_op( engine::DIV, 0, 0, 0, fc::variant( int64_t( 2 ) ) ) );
+      }
+      ops.push_back( make_op( engine::PUSH, 1 ) );
+      ops.push_back( make_op( engine::GT, 0, 0, 0, fc::variant( int64_t( 1000 ) ) ) );
+      ops.push_back( make_op( engine::NOT_OP, 1 ) );
+      return ops;
+   }
+
+   /** reads and writes fields of an object, as a script checking a transaction would */
+   vector<engine::operation> object_script()
+   {
+      const fc::variant object = fc::mutable_variant_object( "balance", int64_t( 5000 ) )( "owner", "alice" )( "fee", int64_t( 10 ) );
+
+      vector<engine::operation> ops;
+      ops.push_back( make_op( engine::PUSH, 0, 0, 0, object ) );
+      ops.push_back( make_op( engine::PUSH_CHILD, 1, 0, 0, fc::variant( "balance" ) ) );
+      ops.push_back( make_op( engine::PUSH_CHILD, 2, 0, 0, fc::variant( "fee" ) ) );
+      ops.push_back( make_op( engine::SUB, 0, 0, 0, fc::variant( int64_t( 1 ) ) ) );
+      ops.push_back( make_op( engine::SET, 2, 1 ) );
+      ops.push_back( make_op( engine::POP ) );
+      ops.push_back( make_op( engine::SET_CHILD, 2, 0, 1, fc::variant( "balance" ) ) );
+      ops.push_back( make_op( engine::PUSH_SIZE, 2 ) );
+      ops.push_back( make_op( engine::GTEQ, 0, 0, 0, fc::variant( int64_t( 3 ) ) ) );
+      return ops;
+   }
+
+   void print_timing( const std::string& name, const fc::microseconds& elapsed, uint64_t count )
+   {
+      const double seconds = double( elapsed.count() ) / 1000000;
+      std::cout << std::left << std::setw( 24 ) << name
+                << std::right << std::setw( 12 ) << std::fixed << std::setprecision( 3 ) << seconds << " s";
+      if( count > 0 && seconds > 0 )
+         std::cout << std::setw( 14 ) << std::setprecision( 1 ) << double( count ) / seconds << " runs/s"
+                   << std::setw( 12 ) << std::setprecision( 3 ) << double( elapsed.count() ) / count << " us/run";
+      std::cout << "\n";
+   }
+
+   void compare( const std::string& name, const vector<engine::operation>& ops, uint32_t iterations )
+   {
+      std::cout << "\n" << name << " (" << ops.size() << " operations)\n";
+
+      fc::variants expected;
+      fc::time_point start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+      {
+         engine interpreter;
+         interpreter.execute( ops );
+         if( i == 0 ) expected = interpreter.get_stack();
+      }
+      print_timing( "engine", fc::time_point::now() - start, iterations );
+
+      start = fc::time_point::now();
+      const typed_engine::program prog = typed_engine::compile( ops );
+      print_timing( "typed_engine compile", fc::time_point::now() - start, 1 );
+
+      typed_engine typed;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+         typed.execute( prog );
+      print_timing( "typed_engine", fc::time_point::now() - start, iterations );
+
+      const fc::variants actual = typed.get_stack();
+      FC_ASSERT( fc::json::to_string( actual ) == fc::json::to_string( expected ),
+                 "engines disagree", ("engine",expected)("typed_engine",actual) );
+   }
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      namespace po = boost::program_options;
+      po::options_description options( "vm_benchmarks options" );
+      options.add_options()
+         ( "help", "display this help message" )
+         ( "iterations", po::value<uint32_t>()->default_value( 100000 ), "times each script is run on each engine" );
+
+      po::variables_map args;
+      po::store( po::parse_command_line( argc, argv, options ), args );
+      po::notify( args );
+      if( args.count( "help" ) )
+      {
+         std::cout << options << "\n";
+         return 0;
+      }
+
+      const uint32_t iterations = args[ "iterations" ].as<uint32_t>();
+      compare( "arithmetic", arithmetic_script(), iterations );
+      compare( "object", object_script(), iterations );
+      return 0;
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+   }
+   return 1;
+}